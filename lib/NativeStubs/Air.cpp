@@ -0,0 +1,144 @@
+#include "Air.h"
+#include "NativeBench.h"
+
+Air air;
+
+/**
+ * The air has its own random numbers, so adding loss or noise to a test
+ * doesn't change the choices the firmware makes.
+ */
+static uint32_t airRandomState = 0x2545F491;
+
+static uint8_t rollPercent() {
+    airRandomState ^= airRandomState << 13;
+    airRandomState ^= airRandomState >> 17;
+    airRandomState ^= airRandomState << 5;
+    return airRandomState % 100;
+}
+
+void Air::reset() {
+    lossPercent = 0;
+    memset(noisePercent, 0, sizeof(noisePercent));
+    memset(history, 0, sizeof(history));
+    historyNext = 0;
+    observer = NULL;
+    transmissions = 0;
+    collisions = 0;
+    noiseHits = 0;
+    delivered = 0;
+    deliveredRetries = 0;
+    airRandomState = 0x2545F491;
+}
+
+unsigned long Air::airtimeUs(uint8_t length, rf24_datarate_e dataRate, rf24_crclength_e crcLength) {
+    // Preamble, 5 byte address, 9 bits of packet control, payload and CRC,
+    // after 130us to settle the PLL.
+    unsigned long bits = 8 * (1 + 5 + length + crcLength) + 9;
+    switch (dataRate) {
+        case RF24_2MBPS:
+            return 130 + bits / 2;
+        case RF24_250KBPS:
+            return 130 + bits * 4;
+        default:
+            return 130 + bits;
+    }
+}
+
+void Air::add(RF24 *radio) {
+    for (uint8_t i = 0; i < AIR_MAX_RADIOS; i++) {
+        if (radios[i] == NULL) {
+            radios[i] = radio;
+            return;
+        }
+    }
+}
+
+void Air::remove(RF24 *radio) {
+    for (uint8_t i = 0; i < AIR_MAX_RADIOS; i++) {
+        if (radios[i] == radio) {
+            radios[i] = NULL;
+        }
+    }
+    for (uint8_t i = 0; i < AIR_HISTORY; i++) {
+        if (history[i].from == radio) {
+            history[i].from = NULL;
+        }
+    }
+}
+
+bool Air::collides(const RF24 &from, uint8_t channel, unsigned long startUs, unsigned long endUs) {
+    for (uint8_t i = 0; i < AIR_HISTORY; i++) {
+        const Transmission &other = history[i];
+        if (other.endUs != 0 && other.from != &from && other.channel == channel
+                && other.startUs < endUs && startUs < other.endUs) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void Air::remember(const RF24 &from, uint8_t channel, unsigned long startUs, unsigned long endUs) {
+    Transmission &transmission = history[historyNext];
+    historyNext = (historyNext + 1) % AIR_HISTORY;
+    transmission.from = &from;
+    transmission.channel = channel;
+    transmission.startUs = startUs;
+    transmission.endUs = endUs;
+}
+
+bool Air::busy(const RF24 &listener, uint8_t channel, unsigned long fromUs, unsigned long toUs) {
+    return collides(listener, channel, fromUs, toUs) || rollPercent() < noisePercent[channel];
+}
+
+bool Air::send(RF24 &from, const uint8_t *frame, uint8_t length, uint8_t &retries) {
+    bool wantsAck = (from.autoAck & 1) != 0;
+    uint8_t attempts = wantsAck ? from.retryCount + 1 : 1;
+    unsigned long airtime = airtimeUs(length, from.dataRate, from.crcLength);
+    unsigned long ackWait = 250UL * (from.retryDelay + 1);
+    unsigned long startUs = max(benchNowMicros(), from.busyUntilUs);
+    bool heard[AIR_MAX_RADIOS] = {false};
+    bool anyHeard = false;
+    bool acked = false;
+
+    uint8_t attempt = 0;
+    for (; attempt < attempts && !acked; attempt++) {
+        unsigned long endUs = startUs + airtime;
+        transmissions++;
+        bool lost = false;
+        if (collides(from, from.channel, startUs, endUs)) {
+            collisions++;
+            lost = true;
+        } else if (rollPercent() < noisePercent[from.channel]) {
+            noiseHits++;
+            lost = true;
+        }
+        remember(from, from.channel, startUs, endUs);
+        if (!lost) {
+            for (uint8_t i = 0; i < AIR_MAX_RADIOS; i++) {
+                RF24 *to = radios[i];
+                if (to == NULL || to == &from || heard[i] || to->channel != from.channel
+                        || to->dataRate != from.dataRate || rollPercent() < lossPercent) {
+                    continue;
+                }
+                bool ackedByThem;
+                if (to->receive(from.writingAddress, frame, length, ackedByThem)) {
+                    heard[i] = true;
+                    anyHeard = true;
+                    acked = acked || ackedByThem;
+                }
+            }
+        }
+        startUs = endUs + (wantsAck ? ackWait : 0);
+    }
+    from.busyUntilUs = startUs;
+    retries = attempt - 1;
+    bool ok = wantsAck ? acked : true;
+    if (anyHeard && ok) {
+        delivered++;
+        deliveredRetries += retries;
+    }
+    if (observer != NULL) {
+        observer(frame, length, attempt, anyHeard);
+    }
+    return ok;
+}
@@ -0,0 +1,101 @@
+#ifndef air_h
+#define air_h
+
+#include <Arduino.h>
+#include "RF24.h"
+
+const uint8_t AIR_CHANNELS = 126;
+const uint8_t AIR_MAX_RADIOS = 64;
+/**
+ * Transmissions remembered, for carrier sense and collisions.  Older ones
+ * have long finished.
+ */
+const uint8_t AIR_HISTORY = 64;
+
+/**
+ * Called for every write() that went on air, with how many times it was sent
+ * and whether anyone heard it.
+ */
+typedef void (*AirObserver)(const uint8_t *frame, uint8_t length, uint8_t attempts, bool delivered);
+
+/**
+ * The band every fake radio (see RF24.h) sends on and listens to.
+ *
+ * A frame reaches every powered radio that is listening on the same channel
+ * and data rate with a reading pipe open on the address it was sent to, less
+ * the ones lossPercent takes.  A frame that starts while another is still on
+ * the channel is lost everywhere (the first one is captured), and so is one
+ * sent into noise.  With auto ACK, it's delivered once anybody with auto ACK
+ * heard it, else it goes again after the auto retransmit delay, up to the
+ * retry count.
+ */
+class Air {
+    public:
+        /**
+         * No traffic or counts, nothing lost and no noise.  Radios stay on.
+         */
+        void reset();
+
+        /**
+         * The chance, in percent, that each receiver misses a frame.
+         */
+        uint8_t lossPercent = 0;
+        /**
+         * The share of the time, in percent, something other than our radios
+         * is on each channel.  Frames sent into it are lost and the received
+         * power detector sees it.
+         */
+        uint8_t noisePercent[AIR_CHANNELS] = {0};
+        void setObserver(AirObserver observer) { this->observer = observer; }
+
+        /**
+         * Every transmission, retries included, and how many were lost to
+         * another frame or to noise.
+         */
+        unsigned long getTransmissions() const { return transmissions; }
+        unsigned long getCollisions() const { return collisions; }
+        unsigned long getNoiseHits() const { return noiseHits; }
+        /**
+         * write()s that got through, and the retries they took between them.
+         */
+        unsigned long getDelivered() const { return delivered; }
+        unsigned long getDeliveredRetries() const { return deliveredRetries; }
+
+        static unsigned long airtimeUs(uint8_t length, rf24_datarate_e dataRate, rf24_crclength_e crcLength);
+
+        void add(RF24 *radio);
+        void remove(RF24 *radio);
+        /**
+         * Sends a frame, returns whether it was delivered and sets how many
+         * retries it took.
+         */
+        bool send(RF24 &from, const uint8_t *frame, uint8_t length, uint8_t &retries);
+        /**
+         * Whether anyone but the listener was on the channel at any point in
+         * the time given.
+         */
+        bool busy(const RF24 &listener, uint8_t channel, unsigned long fromUs, unsigned long toUs);
+    private:
+        RF24 *radios[AIR_MAX_RADIOS] = {NULL};
+        struct Transmission {
+            const RF24 *from;
+            uint8_t channel;
+            unsigned long startUs;
+            unsigned long endUs;
+        };
+        Transmission history[AIR_HISTORY] = {};
+        uint8_t historyNext = 0;
+        AirObserver observer = NULL;
+        unsigned long transmissions = 0;
+        unsigned long collisions = 0;
+        unsigned long noiseHits = 0;
+        unsigned long delivered = 0;
+        unsigned long deliveredRetries = 0;
+
+        bool collides(const RF24 &from, uint8_t channel, unsigned long startUs, unsigned long endUs);
+        void remember(const RF24 &from, uint8_t channel, unsigned long startUs, unsigned long endUs);
+};
+
+extern Air air;
+
+#endif
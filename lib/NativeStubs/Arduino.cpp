@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include "NativeBench.h"
+
+volatile uint8_t PINB, PINC, PIND;
+volatile uint8_t PORTB, PORTC, PORTD;
+volatile uint8_t DDRB, DDRC, DDRD;
+volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+volatile uint8_t EICRA, EIMSK, EIFR;
+volatile uint8_t MCUSR, WDTCSR, SMCR, ADCSRA, ADMUX;
+volatile uint8_t SREG = 0x80;
+
+HardwareSerial Serial;
+
+volatile unsigned long timer0_millis = 0;
+static unsigned long microsFraction = 0;
+
+static AnalogSource analogSource = NULL;
+static int analogLevels[NUM_DIGITAL_PINS];
+static uint8_t digitalInputs[NUM_DIGITAL_PINS];
+static uint8_t digitalOutputs[NUM_DIGITAL_PINS];
+
+const uint8_t EXTERNAL_INTERRUPTS = 2;
+static void (*interruptHandlers[EXTERNAL_INTERRUPTS])(void);
+static int interruptModes[EXTERNAL_INTERRUPTS];
+
+static uint32_t randomState = 1;
+
+void benchAdvanceMicros(unsigned long us) {
+    microsFraction += us;
+    timer0_millis += microsFraction / 1000;
+    microsFraction %= 1000;
+}
+
+unsigned long benchNowMicros() {
+    return timer0_millis * 1000 + microsFraction;
+}
+
+void benchReset() {
+    timer0_millis = 0;
+    microsFraction = 0;
+    analogSource = NULL;
+    for (uint8_t pin = 0; pin < NUM_DIGITAL_PINS; pin++) {
+        analogLevels[pin] = 512;
+        digitalInputs[pin] = HIGH;
+        digitalOutputs[pin] = LOW;
+    }
+    for (uint8_t i = 0; i < EXTERNAL_INTERRUPTS; i++) {
+        interruptHandlers[i] = NULL;
+    }
+    PINB = PINC = PIND = 0xFF;
+    PORTB = PORTC = PORTD = 0;
+    DDRB = DDRC = DDRD = 0;
+    PCICR = PCIFR = PCMSK0 = PCMSK1 = PCMSK2 = 0;
+    EICRA = EIMSK = EIFR = 0;
+    MCUSR = WDTCSR = SMCR = ADCSRA = ADMUX = 0;
+    SREG = 0x80;
+    randomState = 1;
+    Serial.clearOutput();
+}
+
+void benchSetAnalogSource(AnalogSource source) {
+    analogSource = source;
+}
+
+void benchSetAnalogLevel(uint8_t pin, int level) {
+    if (pin < NUM_DIGITAL_PINS) {
+        analogLevels[pin] = level;
+    }
+}
+
+int benchAnalogLevel(uint8_t pin) {
+    return pin < NUM_DIGITAL_PINS ? analogLevels[pin] : 0;
+}
+
+void benchSetDigitalInput(uint8_t pin, uint8_t value) {
+    if (pin < NUM_DIGITAL_PINS) {
+        digitalInputs[pin] = value;
+    }
+}
+
+uint8_t benchDigitalOutput(uint8_t pin) {
+    return pin < NUM_DIGITAL_PINS ? digitalOutputs[pin] : LOW;
+}
+
+void benchFireInterrupt(uint8_t interrupt) {
+    if (interrupt < EXTERNAL_INTERRUPTS && interruptHandlers[interrupt] != NULL) {
+        interruptHandlers[interrupt]();
+    }
+}
+
+bool benchInterruptAttached(uint8_t interrupt, int mode) {
+    return interrupt < EXTERNAL_INTERRUPTS && interruptHandlers[interrupt] != NULL && interruptModes[interrupt] == mode;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+    if (pin < NUM_DIGITAL_PINS) {
+        digitalOutputs[pin] = value;
+    }
+}
+
+int digitalRead(uint8_t pin) {
+    return pin < NUM_DIGITAL_PINS ? digitalInputs[pin] : LOW;
+}
+
+int analogRead(uint8_t pin) {
+    benchAdvanceMicros(ANALOG_READ_US);
+    int reading = analogSource != NULL ? analogSource(pin) : benchAnalogLevel(pin);
+    return constrain(reading, 0, 1023);
+}
+
+unsigned long millis() {
+    return timer0_millis;
+}
+
+unsigned long micros() {
+    unsigned long now = benchNowMicros();
+    benchAdvanceMicros(MICROS_TICK_US);
+    return now;
+}
+
+void delay(unsigned long ms) {
+    timer0_millis += ms;
+}
+
+void delayMicroseconds(unsigned int us) {
+    benchAdvanceMicros(us);
+}
+
+/**
+ * xorshift32.  Same seed, same numbers, on every machine.
+ */
+static uint32_t nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+long random(long howBig) {
+    if (howBig <= 0) {
+        return 0;
+    }
+    return (nextRandom() & 0x7FFFFFFF) % howBig;
+}
+
+long random(long howSmall, long howBig) {
+    if (howSmall >= howBig) {
+        return howSmall;
+    }
+    return random(howBig - howSmall) + howSmall;
+}
+
+void randomSeed(unsigned long seed) {
+    if (seed != 0) {
+        randomState = seed ^ (seed >> 32);
+        if (randomState == 0) {
+            randomState = 1;
+        }
+    }
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+    return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode) {
+    if (interrupt < EXTERNAL_INTERRUPTS) {
+        interruptHandlers[interrupt] = handler;
+        interruptModes[interrupt] = mode;
+    }
+}
+
+void detachInterrupt(uint8_t interrupt) {
+    if (interrupt < EXTERNAL_INTERRUPTS) {
+        interruptHandlers[interrupt] = NULL;
+    }
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size) {
+    size_t written = 0;
+    while (size-- > 0) {
+        written += write(*buffer++);
+    }
+    return written;
+}
+
+size_t Print::print(long n, int base) {
+    if (base == DEC && n < 0) {
+        return print('-') + print((unsigned long) -n, base);
+    }
+    return print((unsigned long) n, base);
+}
+
+size_t Print::print(unsigned long n, int base) {
+    char digits[8 * sizeof(unsigned long) + 1];
+    char *p = &digits[sizeof(digits) - 1];
+    *p = '\0';
+    if (base < 2) {
+        base = DEC;
+    }
+    do {
+        uint8_t digit = n % base;
+        *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+        n /= base;
+    } while (n > 0);
+    return write(p);
+}
+
+size_t Print::print(double n, int digits) {
+    char text[48];
+    snprintf(text, sizeof(text), "%.*f", digits, n);
+    return write(text);
+}
+
+int HardwareSerial::available() {
+    return inputLength;
+}
+
+int HardwareSerial::peek() {
+    return inputLength > 0 ? inputBuffer[inputHead] : -1;
+}
+
+int HardwareSerial::read() {
+    if (inputLength == 0) {
+        return -1;
+    }
+    char c = inputBuffer[inputHead];
+    inputHead = (inputHead + 1) % INPUT_SIZE;
+    inputLength--;
+    return c;
+}
+
+size_t HardwareSerial::write(uint8_t b) {
+    static const bool echo = getenv("SERIAL_ECHO") != NULL;
+    if (echo) {
+        putchar(b);
+    }
+    if (outputLength == OUTPUT_SIZE - 1) {
+        // Keep the most recent half.
+        memmove(outputBuffer, outputBuffer + OUTPUT_SIZE / 2, OUTPUT_SIZE / 2);
+        outputLength -= OUTPUT_SIZE / 2;
+    }
+    outputBuffer[outputLength++] = b;
+    outputBuffer[outputLength] = '\0';
+    return 1;
+}
+
+void HardwareSerial::feed(const char *input) {
+    while (*input != '\0' && inputLength < INPUT_SIZE) {
+        inputBuffer[(inputHead + inputLength) % INPUT_SIZE] = *input++;
+        inputLength++;
+    }
+}
+
+void HardwareSerial::clearOutput() {
+    outputLength = 0;
+    outputBuffer[0] = '\0';
+}
+
+/**
+ * Starts everything at its power on state without the tests having to.
+ */
+static struct PowerOn {
+    PowerOn() { benchReset(); }
+} powerOn;
@@ -0,0 +1,147 @@
+#ifndef Arduino_h
+#define Arduino_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <avr/pgmspace.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+/**
+ * The parts of the Arduino AVR core the firmware uses, for running it on the
+ * build machine (see [env:native] in platformio.ini).  Time only moves when
+ * something waits: delay(), delayMicroseconds(), each analogRead() and a
+ * tick on every micros(), the way busy loops on the device burn time.
+ * NativeBench.h has what the tests use to drive it.
+ */
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define HIGH 0x1
+#define LOW 0x0
+
+#define INPUT 0x0
+#define OUTPUT 0x1
+#define INPUT_PULLUP 0x2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+
+#define DEC 10
+#define HEX 16
+#define OCT 8
+#define BIN 2
+
+#define A0 14
+#define A1 15
+#define A2 16
+#define A3 17
+#define A4 18
+#define A5 19
+#define A6 20
+#define A7 21
+#define NUM_DIGITAL_PINS 22
+
+#define NOT_AN_INTERRUPT -1
+#define digitalPinToInterrupt(p) ((p) == 2 ? 0 : ((p) == 3 ? 1 : NOT_AN_INTERRUPT))
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#define constrain(amt, low, high) ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+#define interrupts() sei()
+#define noInterrupts() cli()
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+long random(long howBig);
+long random(long howSmall, long howBig);
+void randomSeed(unsigned long seed);
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+void attachInterrupt(uint8_t interrupt, void (*handler)(void), int mode);
+void detachInterrupt(uint8_t interrupt);
+
+class __FlashStringHelper;
+#define F(string) (reinterpret_cast<const __FlashStringHelper *>(string))
+
+class Print {
+    public:
+        virtual size_t write(uint8_t b) = 0;
+        virtual size_t write(const uint8_t *buffer, size_t size);
+        size_t write(const char *str) { return str == NULL ? 0 : write((const uint8_t *) str, strlen(str)); }
+
+        size_t print(const __FlashStringHelper *string) { return write((const char *) string); }
+        size_t print(const char *string) { return write(string); }
+        size_t print(char c) { return write((uint8_t) c); }
+        size_t print(unsigned char n, int base = DEC) { return print((unsigned long) n, base); }
+        size_t print(int n, int base = DEC) { return print((long) n, base); }
+        size_t print(unsigned int n, int base = DEC) { return print((unsigned long) n, base); }
+        size_t print(long n, int base = DEC);
+        size_t print(unsigned long n, int base = DEC);
+        size_t print(double n, int digits = 2);
+
+        size_t println() { return write("\r\n"); }
+        template <class T> size_t println(T value) { return print(value) + println(); }
+        template <class T> size_t println(T value, int format) { return print(value, format) + println(); }
+};
+
+/**
+ * What the firmware prints is kept for the tests to look at, and also goes
+ * to stdout when SERIAL_ECHO is set in the environment.  What it reads comes
+ * from feed().
+ */
+class HardwareSerial : public Print {
+    public:
+        void begin(unsigned long baud) {}
+        void end() {}
+        int available();
+        int peek();
+        int read();
+        void flush() {}
+        size_t write(uint8_t b);
+        using Print::write;
+        operator bool() { return true; }
+
+        /**
+         * Queues up characters for read(), as if typed.
+         */
+        void feed(const char *input);
+        /**
+         * Everything printed since the last clearOutput(), up to the last
+         * OUTPUT_SIZE - 1 characters.
+         */
+        const char *output() const { return outputBuffer; }
+        bool printed(const char *text) const { return strstr(outputBuffer, text) != NULL; }
+        void clearOutput();
+
+        static const size_t OUTPUT_SIZE = 16384;
+        static const size_t INPUT_SIZE = 256;
+    private:
+        char outputBuffer[OUTPUT_SIZE] = {0};
+        size_t outputLength = 0;
+        char inputBuffer[INPUT_SIZE] = {0};
+        size_t inputHead = 0;
+        size_t inputLength = 0;
+};
+
+extern HardwareSerial Serial;
+
+#endif
@@ -0,0 +1,15 @@
+#include "EEPROM.h"
+
+EEPROMClass EEPROM;
+
+void EEPROMClass::write(int address, uint8_t value) {
+    if (inRange(address)) {
+        bytes[address] = value;
+        writes++;
+    }
+}
+
+void EEPROMClass::erase() {
+    memset(bytes, 0xFF, sizeof(bytes));
+    writes = 0;
+}
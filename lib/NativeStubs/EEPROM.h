@@ -0,0 +1,54 @@
+#ifndef EEPROM_h
+#define EEPROM_h
+
+#include <Arduino.h>
+
+/**
+ * The ATmega328's 1KB, in memory.  Starts erased (0xFF) and keeps its
+ * contents across benchReset(), the way the device does across a reboot.
+ * Counts the writes that actually changed a byte, for wear tests.
+ */
+class EEPROMClass {
+    public:
+        static const uint16_t SIZE = 1024;
+
+        EEPROMClass() { erase(); }
+
+        uint8_t read(int address) const { return inRange(address) ? bytes[address] : 0xFF; }
+        void write(int address, uint8_t value);
+        void update(int address, uint8_t value) {
+            if (read(address) != value) {
+                write(address, value);
+            }
+        }
+        uint16_t length() const { return SIZE; }
+
+        template <class T> T &get(int address, T &value) const {
+            uint8_t *out = (uint8_t *) &value;
+            for (size_t i = 0; i < sizeof(T); i++) {
+                out[i] = read(address + i);
+            }
+            return value;
+        }
+        template <class T> const T &put(int address, const T &value) {
+            const uint8_t *in = (const uint8_t *) &value;
+            for (size_t i = 0; i < sizeof(T); i++) {
+                update(address + i, in[i]);
+            }
+            return value;
+        }
+
+        /**
+         * Back to a freshly flashed chip.
+         */
+        void erase();
+        unsigned long getWrites() const { return writes; }
+    private:
+        uint8_t bytes[SIZE];
+        unsigned long writes = 0;
+        static bool inRange(int address) { return address >= 0 && address < SIZE; }
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef native_bench_h
+#define native_bench_h
+
+#include <Arduino.h>
+
+/**
+ * What the tests use to drive the stubs: the clock, the pins and the ADC.
+ * The radio's side is in Air.h.
+ */
+
+/**
+ * How long the stubbed calls take.  analogRead() is a 13 cycle conversion
+ * at 125kHz, and micros() ticks like timer 0 does, so loops that wait on it
+ * finish.
+ */
+const unsigned long ANALOG_READ_US = 112;
+const unsigned long MICROS_TICK_US = 4;
+
+/**
+ * Kept by the Arduino core on the device, moved by advanceMillis().
+ */
+extern volatile unsigned long timer0_millis;
+
+void benchAdvanceMicros(unsigned long us);
+/**
+ * micros() without the tick.
+ */
+unsigned long benchNowMicros();
+/**
+ * Puts the clock, pins, ADC, registers, random numbers and serial back to
+ * how they are at power on.  EEPROM keeps what was written, like the device.
+ */
+void benchReset();
+
+/**
+ * Where analogRead() gets its readings.  Without one every pin reads
+ * benchAnalogLevel().
+ */
+typedef int (*AnalogSource)(uint8_t pin);
+void benchSetAnalogSource(AnalogSource source);
+void benchSetAnalogLevel(uint8_t pin, int level);
+int benchAnalogLevel(uint8_t pin);
+
+/**
+ * digitalRead() of an input pin.  Pins read HIGH until set, as if pulled up.
+ */
+void benchSetDigitalInput(uint8_t pin, uint8_t value);
+/**
+ * The last digitalWrite() to a pin.
+ */
+uint8_t benchDigitalOutput(uint8_t pin);
+
+/**
+ * Runs an attachInterrupt() handler, if one is attached for that mode.
+ */
+void benchFireInterrupt(uint8_t interrupt);
+bool benchInterruptAttached(uint8_t interrupt, int mode);
+
+#endif
@@ -0,0 +1,161 @@
+#include "Air.h"
+#include "NativeBench.h"
+
+RF24::RF24(uint16_t cePin, uint16_t csnPin) {
+    air.add(this);
+}
+
+RF24::~RF24() {
+    air.remove(this);
+}
+
+void RF24::resetRegisters() {
+    listening = false;
+    channel = 2;
+    dataRate = RF24_2MBPS;
+    paLevel = RF24_PA_MAX;
+    crcLength = RF24_CRC_8;
+    payloadSize = RF24_MAX_PAYLOAD;
+    retryDelay = 0;
+    retryCount = 3;
+    autoAck = 0x3F;
+    lastRetries = 0;
+    writingAddress = 0;
+    openPipes = 0;
+    rxCount = 0;
+    rpdFromUs = rpdToUs = 0;
+}
+
+bool RF24::begin() {
+    resetRegisters();
+    if (!connected) {
+        return false;
+    }
+    // What the RF24 library sets up in begin().
+    setRetries(5, 15);
+    setDataRate(RF24_1MBPS);
+    setCRCLength(RF24_CRC_16);
+    setChannel(76);
+    powered = true;
+    return true;
+}
+
+void RF24::setConnected(bool connected) {
+    this->connected = connected;
+    if (!connected) {
+        powered = false;
+        listening = false;
+        resetRegisters();
+    }
+}
+
+void RF24::startListening() {
+    if (!powered) {
+        return;
+    }
+    listening = true;
+    listenStartUs = benchNowMicros();
+}
+
+void RF24::stopListening() {
+    if (listening) {
+        rpdFromUs = listenStartUs;
+        rpdToUs = benchNowMicros();
+    }
+    listening = false;
+}
+
+bool RF24::testRPD() {
+    // It takes 170us in RX before the detector reads anything.
+    if (rpdToUs < rpdFromUs + 170) {
+        return false;
+    }
+    return air.busy(*this, channel, rpdFromUs, rpdToUs);
+}
+
+bool RF24::available(uint8_t *pipe) {
+    if (!powered || rxCount == 0) {
+        return false;
+    }
+    if (pipe != NULL) {
+        *pipe = rx[rxHead].pipe;
+    }
+    return true;
+}
+
+void RF24::read(void *buffer, uint8_t length) {
+    if (rxCount == 0) {
+        memset(buffer, 0, length);
+        return;
+    }
+    memcpy(buffer, rx[rxHead].bytes, min(length, RF24_MAX_PAYLOAD));
+    rxHead = (rxHead + 1) % RF24_RX_FIFO_DEPTH;
+    rxCount--;
+}
+
+bool RF24::write(const void *buffer, uint8_t length) {
+    if (!powered || listening) {
+        lastRetries = 0;
+        return false;
+    }
+    return air.send(*this, (const uint8_t *) buffer, min(length, payloadSize), lastRetries);
+}
+
+static uint64_t addressOf(const uint8_t *address) {
+    uint64_t value = 0;
+    for (uint8_t i = 0; i < 5; i++) {
+        value |= (uint64_t) address[i] << (8 * i);
+    }
+    return value;
+}
+
+void RF24::openWritingPipe(const uint8_t *address) {
+    openWritingPipe(addressOf(address));
+}
+
+void RF24::openReadingPipe(uint8_t pipe, uint64_t address) {
+    if (pipe < RF24_PIPES) {
+        readingAddresses[pipe] = address;
+        openPipes |= 1 << pipe;
+    }
+}
+
+void RF24::openReadingPipe(uint8_t pipe, const uint8_t *address) {
+    openReadingPipe(pipe, addressOf(address));
+}
+
+void RF24::closeReadingPipe(uint8_t pipe) {
+    if (pipe < RF24_PIPES) {
+        openPipes &= ~(1 << pipe);
+    }
+}
+
+void RF24::setAutoAck(uint8_t pipe, bool enable) {
+    if (pipe < RF24_PIPES) {
+        autoAck = enable ? autoAck | (1 << pipe) : autoAck & ~(1 << pipe);
+    }
+}
+
+bool RF24::receive(uint64_t address, const uint8_t *bytes, uint8_t length, bool &acked) {
+    acked = false;
+    if (!powered || !listening) {
+        return false;
+    }
+    for (uint8_t pipe = 0; pipe < RF24_PIPES; pipe++) {
+        if ((openPipes & (1 << pipe)) == 0 || readingAddresses[pipe] != address) {
+            continue;
+        }
+        // A full FIFO drops the frame, and doesn't ACK it either.
+        if (rxCount == RF24_RX_FIFO_DEPTH) {
+            return false;
+        }
+        Frame &frame = rx[(rxHead + rxCount) % RF24_RX_FIFO_DEPTH];
+        frame.pipe = pipe;
+        memset(frame.bytes, 0, sizeof(frame.bytes));
+        memcpy(frame.bytes, bytes, length);
+        rxCount++;
+        acked = (autoAck & (1 << pipe)) != 0;
+        return true;
+    }
+    return false;
+}
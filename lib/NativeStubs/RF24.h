@@ -0,0 +1,132 @@
+#ifndef RF24_h
+#define RF24_h
+
+#include <Arduino.h>
+
+typedef enum { RF24_PA_MIN = 0, RF24_PA_LOW, RF24_PA_HIGH, RF24_PA_MAX, RF24_PA_ERROR } rf24_pa_dbm_e;
+typedef enum { RF24_1MBPS = 0, RF24_2MBPS, RF24_250KBPS } rf24_datarate_e;
+typedef enum { RF24_CRC_DISABLED = 0, RF24_CRC_8, RF24_CRC_16 } rf24_crclength_e;
+
+const uint8_t RF24_MAX_PAYLOAD = 32;
+const uint8_t RF24_RX_FIFO_DEPTH = 3;
+const uint8_t RF24_PIPES = 6;
+
+/**
+ * An nRF24L01+ on the shared Air (see Air.h), with the RF24 library's
+ * interface.  Registers start at their power on values and only change when
+ * written, so a register check like RadioController::radioFailed() sees the
+ * same thing it would on the device after a brown out.
+ *
+ * write() is instant: the attempts and the ACK wait are laid out on the air
+ * from now, without moving the clock, so other radios stepped at the same
+ * moment can hear them and collide with them.
+ */
+class RF24 {
+    public:
+        RF24(uint16_t cePin, uint16_t csnPin);
+        ~RF24();
+
+        bool failureDetected = false;
+
+        bool begin();
+        bool isChipConnected() { return connected; }
+        void powerUp() { powered = connected; }
+        void powerDown() { powered = false; listening = false; }
+
+        void startListening();
+        void stopListening();
+        bool available() { return available(NULL); }
+        bool available(uint8_t *pipe);
+        bool rxFifoFull() { return rxCount == RF24_RX_FIFO_DEPTH; }
+        void read(void *buffer, uint8_t length);
+        bool write(const void *buffer, uint8_t length);
+        bool write(const void *buffer, uint8_t length, bool multicast) { return write(buffer, length); }
+        bool txStandBy() { return true; }
+        bool txStandBy(uint32_t timeout, bool startTx = false) { return true; }
+        void flush_tx() {}
+        uint8_t flush_rx() { rxCount = 0; return 0; }
+
+        void openWritingPipe(uint64_t address) { writingAddress = address; }
+        void openWritingPipe(const uint8_t *address);
+        void openReadingPipe(uint8_t pipe, uint64_t address);
+        void openReadingPipe(uint8_t pipe, const uint8_t *address);
+        void closeReadingPipe(uint8_t pipe);
+
+        void setChannel(uint8_t channel) { this->channel = min(channel, (uint8_t) 125); }
+        uint8_t getChannel() { return channel; }
+        bool setDataRate(rf24_datarate_e dataRate) { this->dataRate = dataRate; return true; }
+        rf24_datarate_e getDataRate() { return dataRate; }
+        void setPALevel(uint8_t level, bool lnaEnable = true) { paLevel = min(level, (uint8_t) RF24_PA_MAX); }
+        uint8_t getPALevel() { return paLevel; }
+        void setCRCLength(rf24_crclength_e length) { crcLength = length; }
+        rf24_crclength_e getCRCLength() { return crcLength; }
+        void setPayloadSize(uint8_t size) { payloadSize = constrain(size, 1, RF24_MAX_PAYLOAD); }
+        uint8_t getPayloadSize() { return payloadSize; }
+        uint8_t getDynamicPayloadSize() { return payloadSize; }
+        void setRetries(uint8_t delay, uint8_t count) { retryDelay = min(delay, (uint8_t) 15); retryCount = min(count, (uint8_t) 15); }
+        void setAutoAck(bool enable) { autoAck = enable ? 0x3F : 0; }
+        void setAutoAck(uint8_t pipe, bool enable);
+        void enableAckPayload() {}
+        void enableDynamicPayloads() {}
+        void enableDynamicAck() {}
+        bool writeAckPayload(uint8_t pipe, const void *buffer, uint8_t length) { return true; }
+        void maskIRQ(bool txOk, bool txFail, bool rxReady) {}
+        uint8_t getARC() { return lastRetries; }
+        /**
+         * Whether anything was on our channel during the last 170us or more
+         * of RX.
+         */
+        bool testRPD();
+        bool testCarrier() { return testRPD(); }
+        void printDetails() {}
+        void printPrettyDetails() {}
+
+        /**
+         * For tests: unplugs the module (or plugs it back in).  begin() fails
+         * and nothing is sent or heard until it's back.
+         */
+        void setConnected(bool connected);
+        bool isPowered() const { return powered; }
+        bool isListening() const { return listening; }
+        uint8_t getRetryDelay() const { return retryDelay; }
+        uint8_t getRetryCount() const { return retryCount; }
+
+    private:
+        friend class Air;
+
+        bool connected = true;
+        bool powered = false;
+        bool listening = false;
+        unsigned long listenStartUs = 0;
+        // The last stretch of RX, for testRPD().
+        unsigned long rpdFromUs = 0;
+        unsigned long rpdToUs = 0;
+        // When the last write() is done with the air.
+        unsigned long busyUntilUs = 0;
+        uint8_t channel = 2;
+        rf24_datarate_e dataRate = RF24_2MBPS;
+        uint8_t paLevel = RF24_PA_MAX;
+        rf24_crclength_e crcLength = RF24_CRC_8;
+        uint8_t payloadSize = RF24_MAX_PAYLOAD;
+        uint8_t retryDelay = 0;
+        uint8_t retryCount = 3;
+        uint8_t autoAck = 0x3F;
+        uint8_t lastRetries = 0;
+
+        uint64_t writingAddress = 0;
+        uint64_t readingAddresses[RF24_PIPES] = {0};
+        uint8_t openPipes = 0;
+
+        struct Frame {
+            uint8_t pipe;
+            uint8_t bytes[RF24_MAX_PAYLOAD];
+        };
+        Frame rx[RF24_RX_FIFO_DEPTH];
+        uint8_t rxHead = 0;
+        uint8_t rxCount = 0;
+
+        void resetRegisters();
+        bool receive(uint64_t address, const uint8_t *bytes, uint8_t length, bool &acked);
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef Servo_h
+#define Servo_h
+
+#include <Arduino.h>
+
+/**
+ * Remembers what it was told.  There is no servo to lag behind, so read()
+ * is always the last write.
+ */
+class Servo {
+    public:
+        uint8_t attach(int pin) { return attach(pin, 544, 2400); }
+        uint8_t attach(int pin, int min, int max) {
+            this->pin = pin;
+            attachedNow = true;
+            attaches++;
+            return 0;
+        }
+        void detach() { attachedNow = false; }
+        void write(int value) {
+            angle = constrain(value, 0, 180);
+            writes++;
+        }
+        void writeMicroseconds(int value) { write(map(value, 544, 2400, 0, 180)); }
+        int read() { return angle; }
+        bool attached() { return attachedNow; }
+
+        int getPin() const { return pin; }
+        unsigned long getWrites() const { return writes; }
+        unsigned long getAttaches() const { return attaches; }
+    private:
+        int pin = -1;
+        bool attachedNow = false;
+        int angle = 90;
+        unsigned long writes = 0;
+        unsigned long attaches = 0;
+};
+
+#endif
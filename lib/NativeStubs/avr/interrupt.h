@@ -0,0 +1,15 @@
+#ifndef native_interrupt_h
+#define native_interrupt_h
+
+#include <avr/io.h>
+
+/**
+ * Handlers are ordinary functions, so a test can call one to fake the
+ * interrupt.
+ */
+#define ISR(vector) extern "C" void vector(void); void vector(void)
+
+#define cli() (SREG &= ~0x80)
+#define sei() (SREG |= 0x80)
+
+#endif
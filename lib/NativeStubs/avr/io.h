@@ -0,0 +1,64 @@
+#ifndef native_io_h
+#define native_io_h
+
+#include <stdint.h>
+
+/**
+ * The ATmega328 registers the firmware touches, as plain variables.  Tests
+ * set the PINx inputs (the gate code switches are on port D) and read back
+ * the rest.
+ */
+extern volatile uint8_t PINB, PINC, PIND;
+extern volatile uint8_t PORTB, PORTC, PORTD;
+extern volatile uint8_t DDRB, DDRC, DDRD;
+extern volatile uint8_t PCICR, PCIFR, PCMSK0, PCMSK1, PCMSK2;
+extern volatile uint8_t EICRA, EIMSK, EIFR;
+extern volatile uint8_t MCUSR, WDTCSR, SMCR, ADCSRA, ADMUX;
+extern volatile uint8_t SREG;
+
+#define _BV(bit) (1 << (bit))
+
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+
+#define WDP0 0
+#define WDP1 1
+#define WDP2 2
+#define WDE 3
+#define WDCE 4
+#define WDP3 5
+#define WDIE 6
+#define WDIF 7
+
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+#define PCIF0 0
+#define PCIF1 1
+#define PCIF2 2
+
+#define INT0 0
+#define INT1 1
+#define INTF0 0
+#define INTF1 1
+#define ISC00 0
+#define ISC01 1
+
+#define PCINT16 0
+#define PCINT17 1
+#define PCINT18 2
+#define PCINT19 3
+#define PCINT20 4
+#define PCINT21 5
+#define PCINT22 6
+#define PCINT23 7
+
+#define ADEN 7
+#define ADSC 6
+
+#define RAMSTART 0x100
+#define RAMEND 0x8FF
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef native_pgmspace_h
+#define native_pgmspace_h
+
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * There is only one address space off the device, so flash is just memory.
+ */
+#define PROGMEM
+#define PSTR(s) (s)
+
+#define pgm_read_byte(address) (*(const uint8_t *) (address))
+#define pgm_read_word(address) (*(const uint16_t *) (address))
+#define pgm_read_dword(address) (*(const uint32_t *) (address))
+#define pgm_read_ptr(address) (*(void *const *) (address))
+
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strlen_P strlen
+#define memcpy_P memcpy
+
+#endif
@@ -0,0 +1,17 @@
+#ifndef native_sleep_h
+#define native_sleep_h
+
+#define SLEEP_MODE_IDLE 0
+#define SLEEP_MODE_PWR_DOWN 2
+
+/**
+ * Sleeping returns right away.  The firmware adds the time it thinks it
+ * slept to millis() itself.
+ */
+inline void set_sleep_mode(int mode) {}
+inline void sleep_enable() {}
+inline void sleep_disable() {}
+inline void sleep_bod_disable() {}
+inline void sleep_cpu() {}
+
+#endif
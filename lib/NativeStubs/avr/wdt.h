@@ -0,0 +1,22 @@
+#ifndef native_wdt_h
+#define native_wdt_h
+
+#define WDTO_15MS 0
+#define WDTO_30MS 1
+#define WDTO_60MS 2
+#define WDTO_120MS 3
+#define WDTO_250MS 4
+#define WDTO_500MS 5
+#define WDTO_1S 6
+#define WDTO_2S 7
+#define WDTO_4S 8
+#define WDTO_8S 9
+
+/**
+ * The watchdog never bites off the device.  A hang hangs the test.
+ */
+inline void wdt_enable(unsigned char timeout) {}
+inline void wdt_disable() {}
+inline void wdt_reset() {}
+
+#endif
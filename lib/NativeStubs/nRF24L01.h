@@ -0,0 +1,6 @@
+#ifndef native_nRF24L01_h
+#define native_nRF24L01_h
+
+// Register names.  The firmware only goes through RF24.h.
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef native_atomic_h
+#define native_atomic_h
+
+#define ATOMIC_RESTORESTATE 0
+#define ATOMIC_FORCEON 1
+
+/**
+ * Nothing interrupts us off the device.  Runs the block once.
+ */
+#define ATOMIC_BLOCK(type) for (bool atomicOnce = true; atomicOnce; atomicOnce = false)
+
+#endif
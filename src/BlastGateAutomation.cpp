@@ -9,256 +9,892 @@
 #include <limits.h>
 #include "StatusController.h"
 #include "Ids.h"
+#include "WarmStart.h"
+#include "BootTimer.h"
+#include "LeaseTable.h"
+#include "Profiler.h"
+#include "Telemetry.h"
+#include "CurrentDetector.h"
+#include "SerialConsole.h"
+#include "ChannelManager.h"
+#include "LinkAdapter.h"
+#include "PowerManager.h"
+#include "Clock.h"
+#include "Latency.h"
+#include "Gateway.h"
+#include "Config.h"
+#include "ConfigPush.h"
+#include "SpinDown.h"
+#include "Watchdog.h"
+#include "CollectorGroup.h"
+#include "Faults.h"
+#include "Slot.h"
 
 void checkOtherGates();
+void maintainLease();
 void processCommand(const Payload &payload);
 void turnOnDustCollector();
 void turnOffDustCollector();
-double currentAmps();
+void updateDustCollectorPin();
+bool readyToSleep();
+void saveSnapshot();
+void forwardFrame(const Payload &payload);
+void setActiveMachine(uint8_t address, bool active);
+void onConfigApplied(const ConfigValues &previous);
+void onCollectorAssignment(unsigned long data);
 
-Ids *ids;
-StatusController *statusController;
-RadioController *radioController;
-GateController *gateController;
+void onHelpCommand(uint8_t argc, char **argv);
+void onGatePositionCommand(uint8_t argc, char **argv);
+void onThresholdCommand(uint8_t argc, char **argv);
+void onOverrideCommand(uint8_t argc, char **argv);
+void onStatsCommand(uint8_t argc, char **argv);
+void onDumpCommand(uint8_t argc, char **argv);
+void onLinksCommand(uint8_t argc, char **argv);
+void onPowerCommand(uint8_t argc, char **argv);
+void onTickCommand(uint8_t argc, char **argv);
+void onLatencyCommand(uint8_t argc, char **argv);
+void onReceiveCommand(uint8_t argc, char **argv);
+void onConfigCommand(uint8_t argc, char **argv);
+void onSpinDownCommand(uint8_t argc, char **argv);
+void onFaultCommand(uint8_t argc, char **argv);
+
+const ConsoleCommand CONSOLE_COMMANDS[] PROGMEM = {
+  {"help", "", onHelpCommand},
+  {"o", "<degrees> [gate]  set the open position", onGatePositionCommand},
+  {"c", "<degrees> [gate]  set the closed position", onGatePositionCommand},
+  {"threshold", "[<on> <off>]  amps above idle to count as on/off", onThresholdCommand},
+  {"override", "auto|on|off  hold the gate or dust collector", onOverrideCommand},
+  {"stats", "", onStatsCommand},
+  {"dump", " binary telemetry dump (dust collector)", onDumpCommand},
+  {"links", "", onLinksCommand},
+  {"power", " time awake and estimated current (low power nodes)", onPowerCommand},
+  {"latency", "", onLatencyCommand},
+  {"config", "[push|<name> <value>]  on/off in cA, spin limits in s, delays in ms", onConfigCommand},
+  {"spindown", "[address]  learned gaps between cuts (dust collector)", onSpinDownCommand},
+  {"fault", "[<name> <level>|radio brownout|radio register|clear]  (FAULT_INJECTION)", onFaultCommand},
+  {"tick", "<ms>  move the clock forward (TRAFFIC_REPLAY)", onTickCommand},
+  {"rx", "<payload hex>  pretend we heard a frame (TRAFFIC_REPLAY)", onReceiveCommand},
+};
+
+/**
+ * The whole object graph, built before setup() runs, each subsystem handed
+ * the ones it talks to.  What our role doesn't have is an empty Slot and a
+ * NULL pointer.  Nothing is allocated from the heap.
+ */
+Ids ids;
+StatusController statusController;
+RadioController radioController(statusController, ids);
+WarmStart warmStart;
+
+Slot<GateController, Role::hasGate> gateControllerSlot(statusController, ids);
+Slot<CurrentDetector, Role::sensesCurrent> currentDetectorSlot;
+Slot<ChannelManager, AUTO_CHANNEL_SELECTION> channelManagerSlot(radioController);
+Slot<LinkAdapter, ADAPTIVE_LINK> linkAdapterSlot(radioController, channelManagerSlot.get());
+Slot<PowerManager, LOW_POWER_IDLE> powerManagerSlot;
+Slot<Gateway, mode == GATEWAY> gatewaySlot(radioController);
+Slot<LeaseTable, mode == DUST_COLLECTOR> leaseTableSlot;
+Slot<Telemetry, mode == DUST_COLLECTOR> telemetrySlot;
+Slot<SpinDown, mode == DUST_COLLECTOR && LEARN_SPIN_DOWN> spinDownSlot;
+Slot<CollectorGroup, mode == DUST_COLLECTOR && MULTIPLE_COLLECTORS> collectorGroupSlot(radioController);
+Slot<ConfigPush, Role::transmits> configPushSlot(radioController, leaseTableSlot.get(), channelManagerSlot.get());
+Slot<Latency, Role::transmits> latencySlot;
+Slot<FaultInjector, FAULT_INJECTION> faultsSlot;
+
+GateController *const gateController = gateControllerSlot.get();
+CurrentDetector *const currentDetector = currentDetectorSlot.get();
+ChannelManager *const channelManager = channelManagerSlot.get();
+LinkAdapter *const linkAdapter = linkAdapterSlot.get();
+PowerManager *const powerManager = powerManagerSlot.get();
+Gateway *const gateway = gatewaySlot.get();
+LeaseTable *const leaseTable = leaseTableSlot.get();
+Telemetry *const telemetry = telemetrySlot.get();
+SpinDown *const spinDown = spinDownSlot.get();
+CollectorGroup *const collectorGroup = collectorGroupSlot.get();
+ConfigPush *const configPush = configPushSlot.get();
+Latency *const latency = latencySlot.get();
+FaultInjector *const faults = faultsSlot.get();
+
+BootTimer bootTimer;
+SerialConsole console(CONSOLE_COMMANDS, sizeof(CONSOLE_COMMANDS) / sizeof(CONSOLE_COMMANDS[0]));
 
 bool currentFlowing = false;
 bool dustCollectorOn = false;
+Override dustCollectorOverride = OVERRIDE_AUTO;
 
 unsigned long lastBroadcastTime = VALUE_UNSET;
 unsigned long lastOnBroadcastReceivedTime = VALUE_UNSET;
+unsigned long lastCuttingTime = VALUE_UNSET;
+// Dust collector: machines that have said RUNNING and not stopped.
+uint8_t activeMachines[(MAX_NODES + 7) / 8] = {0};
+LoadState lastSentLoad = LOAD_UNKNOWN;
 unsigned long currentStoppedTime = VALUE_UNSET;
+unsigned long nextLeaseRequestTime = VALUE_UNSET;
+// Aux collector: when we last heard from the dust collector which collectors
+// should run, and last told it about ourselves.
+unsigned long lastAssignTime = VALUE_UNSET;
+unsigned long lastCollectorInfoTime = VALUE_UNSET;
+
+bool helloSent = false;
+
+/**
+ * What each role does every loop and when it hears a RUNNING.  Only the
+ * specialization for the role we were built for is ever instantiated.
+ */
+template <class R> struct RoleLogic;
+
+template <> struct RoleLogic<MachineRole> {
+  static void onLoop() {
+    currentDetector->onLoop();
+    if (currentDetector->isRunning()) {
+      LoadState load = currentDetector->getLoad();
+      if (!currentFlowing || load != lastSentLoad || (lastBroadcastTime + config.get().onBroadcastIntervalMs) < millis()) {
+        Serial.print(F("Current is flowing: "));
+        Serial.print(currentDetector->getAmps());
+        Serial.print(F("   "));
+        // Only the first RUNNING carries the onset, for the latency stats.
+        unsigned long origin = !currentFlowing && latency->isSynced()
+            ? latency->collectorTime(currentDetector->getOnsetTime()) : VALUE_UNSET;
+        lastBroadcastTime = millis();
+        currentFlowing = true;
+        gateController->openGate();
+        statusController.setGateStatus(true);
+        statusController.onSystemActive();
+        lastSentLoad = load;
+        radioController.broadcastCommand(RUNNING, true, origin, load, MACHINE_DEMAND);
+      }
+    } else if (currentFlowing) {
+      Serial.println(F("Current has stopped flowing"));
+      currentFlowing = false;
+      lastSentLoad = LOAD_UNKNOWN;
+      currentStoppedTime = millis();
+      statusController.setGateStatus(false);
+      radioController.broadcastCommand(NO_LONGER_RUNNING, false);
+    } else if (closeGateWhenNotInUse && currentStoppedTime != VALUE_UNSET && (currentStoppedTime + config.get().closeGateDelayMs) < millis()) {
+      gateController->closeGate();
+      currentStoppedTime = VALUE_UNSET;
+    }
+  }
+
+  static void onRunning(const Payload &payload) {
+    if (!currentFlowing) {
+      if (!gateController->isClosed()) {
+        Serial.println(F("Remote is on, and I am not.  Closing my gate."));
+        gateController->closeGate();
+      }
+    } else {
+      Serial.println(F("Current is flowing, so not closing my gate"));
+    }
+  }
+};
+
+template <> struct RoleLogic<DustCollectorRole> {
+  static void onLoop() {
+    unsigned long turnOffDelay = spinDown != NULL ? spinDown->getDelay() : config.get().collectorTurnOffDelayMs;
+    if (lastOnBroadcastReceivedTime != VALUE_UNSET && (lastOnBroadcastReceivedTime + turnOffDelay) < millis()) {
+      lastOnBroadcastReceivedTime = VALUE_UNSET;
+      lastCuttingTime = VALUE_UNSET;
+      // Nobody has said RUNNING for a while, so they have all stopped.
+      memset(activeMachines, 0, sizeof(activeMachines));
+      turnOffDustCollector();
+    } else if (LOAD_CLASSIFICATION && dustCollectorOn && lastCuttingTime != VALUE_UNSET
+        && (lastCuttingTime + (spinDown != NULL ? turnOffDelay : IDLE_SPIN_TURN_OFF_DELAY)) < millis()) {
+      // Machines are still on, but nobody has cut anything for a while.
+      Serial.println(F("Only idle machines.  Stopping the dust collector"));
+      lastCuttingTime = VALUE_UNSET;
+      turnOffDustCollector();
+    }
+    if (collectorGroup != NULL) {
+      collectorGroup->onLoop(dustCollectorOn, activeMachines);
+      updateDustCollectorPin();
+    }
+  }
+
+  static void onRunning(const Payload &payload) {
+    unsigned long receivedTime = millis();
+    bool traced = payload.data != VALUE_UNSET;
+    if (traced) {
+      latency->record(LATENCY_NODE, payload.originAge);
+      long radioMs = receivedTime - (payload.data + payload.originAge);
+      latency->record(LATENCY_RADIO, radioMs > 0 ? radioMs : 0);
+    }
+    bool cutting = !LOAD_CLASSIFICATION || payload.load != LOAD_IDLE;
+    if (cutting) {
+      lastCuttingTime = millis();
+      if (spinDown != NULL) {
+        spinDown->onCutting(payload.id);
+      }
+    }
+    setActiveMachine(payload.id, true);
+    if (collectorGroup != NULL) {
+      collectorGroup->onRunning(payload.id, payload.demand, payload.gateCode);
+    }
+    if (!dustCollectorOn && cutting) {
+      if (payload.gateCode != 0) {
+        Serial.println(F("Delaying turning on dust collector until gates open"));
+        delay(DUST_COLLECTOR_ON_DELAY_BRANCH);
+      }
+      turnOnDustCollector();
+      if (traced) {
+        latency->record(LATENCY_COLLECTOR, millis() - receivedTime);
+        latency->recordSince(LATENCY_TOTAL, payload.data);
+      }
+    }
+    lastOnBroadcastReceivedTime = millis();
+    telemetry->recordMachine(payload.id, true);
+  }
+};
+
+template <> struct RoleLogic<AuxCollectorRole> {
+  static bool isAssigned() {
+    return lastAssignTime != VALUE_UNSET && (lastAssignTime + COLLECTOR_ASSIGN_TIMEOUT_MS) >= millis();
+  }
+
+  static void onLoop() {
+    if (ids.hasAddress() && (lastCollectorInfoTime == VALUE_UNSET || (lastCollectorInfoTime + COLLECTOR_INFO_INTERVAL_MS) < millis())) {
+      lastCollectorInfoTime = millis();
+      radioController.sendTo(DUST_COLLECTOR_ADDRESS, COLLECTOR_INFO, COLLECTOR_CAPACITY);
+    }
+    // Without the dust collector we run on our own, like it would.
+    if (!isAssigned() && dustCollectorOn && (lastOnBroadcastReceivedTime == VALUE_UNSET
+        || (lastOnBroadcastReceivedTime + config.get().collectorTurnOffDelayMs) < millis())) {
+      lastOnBroadcastReceivedTime = VALUE_UNSET;
+      turnOffDustCollector();
+    }
+  }
+
+  static void onRunning(const Payload &payload) {
+    if (isAssigned()) {
+      // The dust collector decides.
+      return;
+    }
+    int myZones = ids.currentGateCode();
+    if (myZones != 0 && (payload.gateCode & myZones) == 0) {
+      return;
+    }
+    lastOnBroadcastReceivedTime = millis();
+    if (!dustCollectorOn && (!LOAD_CLASSIFICATION || payload.load != LOAD_IDLE)) {
+      Serial.println(F("No word from the dust collector.  Running on my own"));
+      turnOnDustCollector();
+    }
+  }
+};
+
+void onCollectorAssignment(unsigned long data) {
+  lastAssignTime = millis();
+  bool mine = false;
+  for (uint8_t i = 0; i < MAX_COLLECTORS; i++) {
+    mine = mine || (ids.hasAddress() && ((data >> (8 * i)) & 0xFF) == ids.getAddress());
+  }
+  if (mine) {
+    // Keeps the standalone timer going in case the dust collector goes quiet.
+    lastOnBroadcastReceivedTime = millis();
+    if (!dustCollectorOn) {
+      turnOnDustCollector();
+    }
+  } else if (dustCollectorOn) {
+    turnOffDustCollector();
+  }
+}
+
+template <> struct RoleLogic<GatewayRole> {
+  static void onLoop() {
+    gateway->onLoop();
+  }
+
+  static void onRunning(const Payload &payload) {
+    // Only listening.
+  }
+};
+
+void forwardFrame(const Payload &payload) {
+  gateway->forward(payload);
+}
+
+template <> struct RoleLogic<BranchGateRole> {
+  static void onLoop() {
+    if (lastOnBroadcastReceivedTime != VALUE_UNSET && (lastOnBroadcastReceivedTime + config.get().closeBranchGateDelayMs) < millis()) {
+      Serial.println(F("Closing branch gate"));
+      lastOnBroadcastReceivedTime = VALUE_UNSET;
+      gateController->closeGate();
+    }
+  }
+
+  static void onRunning(const Payload &payload) {
+    int myCode = ids.currentGateCode();
+    if ((payload.gateCode & myCode) != 0) {
+      if (!gateController->isOpen()) {
+        Serial.println(F("I matched incoming code.  Opening my gate"));
+        gateController->openGate();
+        latency->recordSince(LATENCY_BRANCH_GATE, payload.data);
+      }
+      lastOnBroadcastReceivedTime = millis();
+    } else {
+      Serial.print(F("Got a on command from a branch that was not mine ("));
+      Serial.print(payload.gateCode);
+      Serial.print(F("/"));
+      Serial.print(myCode);
+      Serial.println(F(")"));
+    }
+  }
+};
 
 void setup() {
-  Serial.begin(9600);
-  Serial.println(" ");
-  Serial.println("------------");
-  Serial.println(" ");
-  Serial.println("Starting setup");
+  bootTimer.mark(BOOT_SETUP_START);
+  Serial.begin(SERIAL_BAUD);
+  Serial.println(F(" "));
+  Serial.println(F("------------"));
+  Serial.println(F(" "));
+  Serial.println(F("Starting setup"));
+  watchdog.setup();
   
-  ids = new Ids();
-  statusController = new StatusController();
-  radioController = new RadioController(*statusController, *ids);
-  gateController = new GateController(*statusController, *ids);
+  if (mode == GATEWAY) {
+    radioController.setFrameListener(forwardFrame);
+  }
+  if (telemetry != NULL) {
+    telemetry->setup();
+  }
+  config.load();
+  config.setListener(onConfigApplied);
+  if (spinDown != NULL) {
+    spinDown->setup();
+  }
 
-  if (USE_FAKE_CURRENT) {
-    pinMode(CURRENT_SENSOR_PIN, INPUT_PULLUP);  
+  // After a watchdog reset we have the state from a moment ago in SRAM, so
+  // this is just a warm start that doesn't have to go to EEPROM.
+  const RecoverySnapshot *snapshot = watchdog.getSnapshot();
+  bool isWarmStart;
+  if (snapshot != NULL) {
+    warmStart.restore(snapshot->state);
+    memcpy(activeMachines, snapshot->activeMachines, sizeof(activeMachines));
+    isWarmStart = true;
   } else {
-    pinMode(CURRENT_SENSOR_PIN, INPUT);
+    isWarmStart = WARM_START && warmStart.load();
+  }
+  bootTimer.setWarmStart(isWarmStart);
+
+  if (Role::sensesCurrent) {
+    currentDetector->setup();
+    currentDetector->setThresholds(config.get().activateAboveCentiamps / 100.0, config.get().stayActiveAboveCentiamps / 100.0);
   }
 
 // if (MODE_VIA_PIN) {
 //     pinMode(MODE_PIN, INPUT_PULLUP);
 //     if (digitalRead(MODE_PIN) == HIGH) {
-//       Serial.println("Reassigning to Dust collector");
+//       Serial.println(F("Reassigning to Dust collector"));
 //       mode = DUST_COLLECTOR;
 //     } else {
-//       Serial.println("Reassigning to MACHINE");
+//       Serial.println(F("Reassigning to MACHINE"));
 //       mode = MACHINE;
 //     }
 //   }
   
-  ids->setup();
-  statusController->setup();
-  gateController->setup();
-  radioController->setup();
+  ids.setup();
+  if (snapshot != NULL && ids.hasAddress()) {
+    // We were on the network a moment ago.  The lease is still good.
+    helloSent = true;
+    nextLeaseRequestTime = millis() + LEASE_RENEW_INTERVAL_MS;
+  } else {
+    // Spread out the HELLO_WORLDs when every node powers up at once.
+    nextLeaseRequestTime = millis() + random(HELLO_STAGGER_MS);
+  }
+  statusController.setup();
+  if (Role::hasGate) {
+    gateController->setup(isWarmStart ? &warmStart.getState() : NULL);
+  }
+  bootTimer.mark(BOOT_GATE_READY);
+  // Waiting on the radio is the one place setup can hang, so the watchdog
+  // covers it.  On a warm start, or if we already hung here once, we don't
+  // wait for the radio.  It comes up in the background while we get back to
+  // work.
+  watchdog.start();
+  radioController.setup(!isWarmStart && watchdog.getResetCause() != RESET_WATCHDOG);
+  if (LOW_POWER_IDLE) {
+    powerManager->setup();
+  }
 
-  if (mode == DUST_COLLECTOR) {
+  if (mode == DUST_COLLECTOR || mode == AUX_COLLECTOR) {
     pinMode(DUST_COLLECTOR_PIN, OUTPUT);
     digitalWrite(DUST_COLLECTOR_PIN, LOW);
-    turnOffDustCollector();
+    if (snapshot != NULL && snapshot->state.dustCollectorOn) {
+      // The watchdog reset us a moment ago, so keep it running.  If nobody
+      // is still using it, it turns off after the normal delay.  After a
+      // power cut it stays off until someone says RUNNING again.
+      turnOnDustCollector();
+      lastOnBroadcastReceivedTime = millis();
+      lastCuttingTime = millis();
+    } else {
+      turnOffDustCollector();
+    }
+  } else if (Role::hasGate && isWarmStart && gateController->isOpen()) {
+    // Start the normal close timers in case the machine is no longer on.
+    statusController.setGateStatus(true);
+    currentStoppedTime = millis();
+    lastOnBroadcastReceivedTime = millis();
   }
 
-  Serial.print("Starting blast gate automation in mode: ");
+  Serial.print(F("Starting blast gate automation in mode: "));
   switch (mode) {
     case MACHINE:
-      Serial.println("MACHINE");
+      Serial.println(F("MACHINE"));
       break;
     case DUST_COLLECTOR:
-      Serial.println("DUST_COLLECTOR");
+      Serial.println(F("DUST_COLLECTOR"));
       break;
     case BRANCH_GATE:
-      Serial.println("BRANCH_GATE");
+      Serial.println(F("BRANCH_GATE"));
+      break;
+    case GATEWAY:
+      Serial.println(F("GATEWAY"));
+      break;
+    case AUX_COLLECTOR:
+      Serial.println(F("AUX_COLLECTOR"));
       break;
   }
-
-  radioController->broadcastCommand(HELLO_WORLD);
+  bootTimer.mark(BOOT_SETUP_DONE);
 }
 
 
 void loop() {
-  if (mode == MACHINE) {
-    double current = currentAmps();
-    if (current >= MIN_CURRENT_TO_ACTIVATE) {
-      if (!currentFlowing || (lastBroadcastTime + TIME_BETWEEN_ON_BROADCASTS) < millis()) {
-        Serial.print("Current is flowing: ");
-        Serial.print(current);
-        Serial.print("   ");
-        lastBroadcastTime = millis();
-        currentFlowing = true;
-        gateController->openGate();
-        statusController->setGateStatus(true);
-        statusController->onSystemActive();
-        radioController->broadcastCommand(RUNNING, true);
-      }
-    } else if (currentFlowing) {
-      Serial.println("Current has stopped flowing");
-      currentFlowing = false;
-      currentStoppedTime = millis();
-      statusController->setGateStatus(false);
-      radioController->broadcastCommand(NO_LONGER_RUNNING, false);
-    } else if (closeGateWhenNotInUse && currentStoppedTime != VALUE_UNSET && (currentStoppedTime + CLOSE_GATE_DELAY) < millis()) {
-      gateController->closeGate();
-      currentStoppedTime = VALUE_UNSET;
+  ScopedProbe loopProbe(PROBE_LOOP);
+  unsigned long loopStartTime = millis();
+  bootTimer.mark(BOOT_FIRST_LOOP);
+  if (radioController.isReady()) {
+    bootTimer.mark(BOOT_RADIO_READY);
+    maintainLease();
+    if (AUTO_CHANNEL_SELECTION) {
+      channelManager->onLoop(!dustCollectorOn);
     }
-  } else if (mode == DUST_COLLECTOR) {
-    if (lastOnBroadcastReceivedTime != VALUE_UNSET && (lastOnBroadcastReceivedTime + DUST_COLLECTOR_TURN_OFF_DELAY) < millis()) {
-      lastOnBroadcastReceivedTime = VALUE_UNSET;
-      turnOffDustCollector();
+    if (ADAPTIVE_LINK) {
+      linkAdapter->onLoop(!dustCollectorOn);
     }
-  } else if (mode == BRANCH_GATE) {
-    if (lastOnBroadcastReceivedTime != VALUE_UNSET && (lastOnBroadcastReceivedTime + CLOSE_BRANCH_GATE_DELAY) < millis()) {
-      Serial.println("Closing branch gate");
-      lastOnBroadcastReceivedTime = VALUE_UNSET;
-      gateController->closeGate();
+    if (configPush != NULL) {
+      configPush->onLoop();
     }
   }
+  watchdog.checkIn(CHECK_IN_NETWORK);
+
+  RoleLogic<Role>::onLoop();
+  watchdog.checkIn(CHECK_IN_ROLE);
 
-  radioController->onLoop();
-  gateController->onLoop();
-  statusController->onLoop();
+  radioController.onLoop();
+  watchdog.checkIn(CHECK_IN_RADIO);
+  if (Role::hasGate) {
+    gateController->onLoop();
+  }
+  watchdog.checkIn(CHECK_IN_GATE);
+  statusController.onLoop();
+  profiler.onLoop();
+  console.onLoop();
+  watchdog.checkIn(CHECK_IN_CONSOLE);
+  if (telemetry != NULL) {
+    telemetry->onLoop();
+  }
 
   checkOtherGates();
+  watchdog.checkIn(CHECK_IN_MESSAGES);
+
+  if (WARM_START && Role::hasGate) {
+    warmStart.update(gateController->getOpenGates(), gateController->getOpenReading(),
+        gateController->getClosedReading());
+  }
+
+  if (!bootTimer.isMarked(BOOT_OPERATIONAL) && bootTimer.isMarked(BOOT_RADIO_READY)) {
+    bootTimer.mark(BOOT_OPERATIONAL);
+    bootTimer.report();
+  }
 
   if (SLOW_DOWN_LOOP) {
     delay(300);
   }
+
+  if (WATCHDOG) {
+    saveSnapshot();
+    watchdog.onLoop();
+  }
+
+  if (FAULT_INJECTION) {
+    faults->onLoopDone(millis() - loopStartTime);
+  }
+
+  if (LOW_POWER_IDLE && readyToSleep()) {
+    powerManager->sleep();
+  }
+}
+
+void saveSnapshot() {
+  WarmStartState state;
+  if (Role::hasGate) {
+    state.openGates = gateController->getOpenGates();
+    state.openReading = gateController->getOpenReading();
+    state.closedReading = gateController->getClosedReading();
+  }
+  state.dustCollectorOn = dustCollectorOn;
+  watchdog.save(state, activeMachines);
+}
+
+bool readyToSleep() {
+  return bootTimer.isMarked(BOOT_OPERATIONAL)
+      && radioController.isReady()
+      && radioController.isIdle()
+      && (!Role::hasGate || gateController->isIdle())
+      && (!AUTO_CHANNEL_SELECTION || (!channelManager->isScanning() && !channelManager->isSwitching()))
+      && configPush->isIdle()
+      && !powerManager->consoleActive();
 }
 
 void checkOtherGates() {
   Payload received;
-  if (radioController->getMessage(received)) {
-    processCommand(received);
+  // The gateway drains the radio's whole FIFO each time around so it keeps
+  // up with a busy channel.
+  uint8_t reads = mode == GATEWAY ? 3 : 1;
+  while (reads-- > 0) {
+    if (radioController.getMessage(received)) {
+      processCommand(received);
+    }
+  }
+}
+
+void maintainLease() {
+  if (!Role::transmits) {
+    return;
+  }
+  if (mode == DUST_COLLECTOR) {
+    uint8_t address = leaseTable->nextWelcome();
+    if (address != ADDRESS_UNSET) {
+      radioController.sendTo(address, WELCOME, leaseTable->getId(address));
+    }
+    return;
+  }
+  if (nextLeaseRequestTime > millis()) {
+    return;
+  }
+  // Always say hello after booting, even if we still have our old lease.
+  radioController.broadcastCommand(helloSent && ids.hasAddress() ? HEARTBEAT : HELLO_WORLD);
+  helloSent = true;
+  if (ids.hasAddress()) {
+    nextLeaseRequestTime = millis() + LEASE_RENEW_INTERVAL_MS;
+  } else {
+    nextLeaseRequestTime = millis() + LEASE_REQUEST_RETRY_MS + random(LEASE_REQUEST_RETRY_MS);
   }
 }
 
 void processCommand(const Payload &payload) {
+  ScopedProbe probe(PROBE_PROCESS_COMMAND);
+  if (leaseTable != NULL) {
+    leaseTable->touch(payload.id);
+  }
+
   if (payload.command == RUNNING) {
-    statusController->onSystemActive();
+    statusController.onSystemActive();
+    RoleLogic<Role>::onRunning(payload);
+  } else if (payload.command == NO_LONGER_RUNNING) {
     if (mode == DUST_COLLECTOR) {
-      if (!dustCollectorOn) {
-        if (payload.gateCode != 0) {
-          Serial.println("Delaying turning on dust collector until gates open");
-          delay(DUST_COLLECTOR_ON_DELAY_BRANCH);
-        }
-        turnOnDustCollector();
-      }
-      lastOnBroadcastReceivedTime = millis();
-    } else if (mode == MACHINE) {
-      if (!currentFlowing) {
-        if (!gateController->isClosed()) {
-          Serial.println("Remote is on, and I am not.  Closing my gate.");
-          gateController->closeGate();
-        }
-      } else {
-        Serial.println("Current is flowing, so not closing my gate");
-      }
-    } else if (mode == BRANCH_GATE) {
-      int myCode = ids->currentGateCode();
-      if ((payload.gateCode & myCode) != 0) {
-        if (!gateController->isOpen()) {
-          Serial.println("I matched incoming code.  Opening my gate");
-          gateController->openGate();
-        }
-        lastOnBroadcastReceivedTime = millis();
-      } else {
-        Serial.print("Got a on command from a branch that was not mine (");
-        Serial.print(payload.gateCode);
-        Serial.print("/");
-        Serial.print(myCode);
-        Serial.println(")");
-      }
+      telemetry->recordMachine(payload.id, false);
+      setActiveMachine(payload.id, false);
     }
-  } else if (payload.command == NO_LONGER_RUNNING) {
-    // no action needed
   } else if (payload.command == HELLO_WORLD) {
-    // Lets welcome our new guest.
-    radioController->broadcastCommand(WELCOME);
-    statusController->onSystemActive();
+    // Lets welcome our new guest.  Only the dust collector answers, and the
+    // answer waits a little so repeated hellos get a single reply.
+    if (mode == DUST_COLLECTOR) {
+      uint8_t address = leaseTable->assign(payload.data, payload.id);
+      leaseTable->queueWelcome(address);
+      configPush->onNodeJoined(address);
+    }
+    statusController.onSystemActive();
   } else if (payload.command == WELCOME) {
-    // Do nothing
+    if (payload.id == DUST_COLLECTOR_ADDRESS && payload.data == ids.getID()) {
+      ids.setAddress(payload.toId);
+      // Tell a dust collector that just rebooted about ourselves right away.
+      lastCollectorInfoTime = VALUE_UNSET;
+    }
+  } else if (payload.command == HEARTBEAT) {
+    if (mode == DUST_COLLECTOR && !leaseTable->renew(payload.id, payload.data)) {
+      // We don't know about this lease (we probably rebooted), or someone
+      // else has the address now.  Either way, tell the node what it has.
+      uint8_t address = leaseTable->assign(payload.data, payload.id);
+      leaseTable->queueWelcome(address);
+      configPush->onNodeJoined(address);
+    }
+  } else if (payload.command == BEACON) {
+    if (latency != NULL && payload.id == DUST_COLLECTOR_ADDRESS) {
+      latency->onBeacon(payload.data);
+    }
+  } else if (payload.command == CHANNEL_CHANGE) {
+    if (AUTO_CHANNEL_SELECTION && mode != DUST_COLLECTOR && payload.id == DUST_COLLECTOR_ADDRESS) {
+      channelManager->scheduleSwitch(payload.data & 0xFF, (rf24_datarate_e) ((payload.data >> 8) & 0xFF), payload.data >> 16);
+    }
+  } else if (payload.command == CONFIG_CHUNK) {
+    if (configPush != NULL) {
+      configPush->onChunk(payload);
+    }
+  } else if (payload.command == CONFIG_STATUS) {
+    if (configPush != NULL) {
+      configPush->onStatus(payload);
+    }
+  } else if (payload.command == COLLECTOR_INFO) {
+    if (collectorGroup != NULL) {
+      collectorGroup->onInfo(payload);
+    }
+  } else if (payload.command == COLLECTOR_ASSIGN) {
+    if (mode == AUX_COLLECTOR && payload.id == DUST_COLLECTOR_ADDRESS) {
+      onCollectorAssignment(payload.data);
+    }
   } else if (payload.command == ACK) {
     // Do nothing
   } else {
-    Serial.println("Unknown command");
+    Serial.println(F("Unknown command"));
+  }
+}
+
+void setActiveMachine(uint8_t address, bool active) {
+  if (!LeaseTable::isNodeAddress(address)) {
+    return;
+  }
+  uint8_t index = address - FIRST_NODE_ADDRESS;
+  if (active) {
+    activeMachines[index / 8] |= 1 << (index % 8);
+  } else {
+    activeMachines[index / 8] &= ~(1 << (index % 8));
   }
 }
 
 void turnOnDustCollector() {
   dustCollectorOn = true;
-  Serial.println("Turning on dust collector");
-  digitalWrite(DUST_COLLECTOR_PIN, HIGH);
-  statusController->setGateStatus(true);
+  Serial.println(F("Turning on dust collector"));
+  if (collectorGroup != NULL) {
+    collectorGroup->onLoop(dustCollectorOn, activeMachines);
+  }
+  updateDustCollectorPin();
+  if (telemetry != NULL) {
+    telemetry->recordCollector(true);
+  }
+  statusController.setGateStatus(true);
 }
 
 void turnOffDustCollector() {
   dustCollectorOn = false;
-  Serial.println("Turning off dust collector");
-  statusController->setGateStatus(false);
-  digitalWrite(DUST_COLLECTOR_PIN, LOW);
+  Serial.println(F("Turning off dust collector"));
+  statusController.setGateStatus(false);
+  if (collectorGroup != NULL) {
+    collectorGroup->onLoop(dustCollectorOn, activeMachines);
+  }
+  updateDustCollectorPin();
+  if (telemetry != NULL) {
+    telemetry->recordCollector(false);
+  }
 }
 
-// Derived from: https://arduino.stackexchange.com/questions/19301/acs712-sensor-reading-for-ac-current
-double currentAmps() {
-  if (USE_FAKE_CURRENT) {
-    bool isHigh = analogRead(CURRENT_SENSOR_PIN) > 512;
-    double onCurrent = MIN_CURRENT_TO_ACTIVATE + 5;
-    if (FAKE_CURRENT_DEFAULT_ON) {
-      if (isHigh) {
-        return onCurrent;
-      } else {
-        return 0;
-      }
-    } else {
-      if (isHigh) {
-        return 0;
-      } else {
-        return onCurrent;
+void updateDustCollectorPin() {
+  // With other collectors, wanting airflow doesn't mean it's ours to give.
+  bool wanted = collectorGroup != NULL ? collectorGroup->isSelfRunning() : dustCollectorOn;
+  bool on = dustCollectorOverride == OVERRIDE_AUTO ? wanted : dustCollectorOverride == OVERRIDE_ON;
+  digitalWrite(DUST_COLLECTOR_PIN, on ? HIGH : LOW);
+}
+
+void onHelpCommand(uint8_t argc, char **argv) {
+  console.printHelp();
+}
+
+void onGatePositionCommand(uint8_t argc, char **argv) {
+  GateState state = strcmp_P(argv[0], PSTR("o")) == 0 ? OPEN : CLOSED;
+  uint8_t gate = argc >= 3 ? atoi(argv[2]) : 0;
+  if (!Role::hasGate || argc < 2 || !gateController->setCalibratedPosition(state, atoi(argv[1]), gate)) {
+    Serial.println(F("Needs SERIAL_CALIBRATION, a position from 1 to 180 and a gate below GATE_COUNT"));
+  }
+}
+
+void onThresholdCommand(uint8_t argc, char **argv) {
+  if (!Role::sensesCurrent) {
+    Serial.println(F("Only machines sense current"));
+    return;
+  }
+  if (argc >= 3) {
+    currentDetector->setThresholds(atof(argv[1]), atof(argv[2]));
+  }
+  Serial.print(F("Current thresholds above idle: on="));
+  Serial.print(currentDetector->getActivateAbove());
+  Serial.print(F(" off="));
+  Serial.println(currentDetector->getStayActiveAbove());
+}
+
+void onOverrideCommand(uint8_t argc, char **argv) {
+  Override override;
+  if (argc >= 2 && strcmp_P(argv[1], PSTR("on")) == 0) {
+    override = OVERRIDE_ON;
+  } else if (argc >= 2 && strcmp_P(argv[1], PSTR("off")) == 0) {
+    override = OVERRIDE_OFF;
+  } else if (argc >= 2 && strcmp_P(argv[1], PSTR("auto")) == 0) {
+    override = OVERRIDE_AUTO;
+  } else {
+    Serial.println(F("Override must be auto, on or off"));
+    return;
+  }
+  Serial.print(F("Override set to: "));
+  Serial.println(argv[1]);
+  if (Role::hasGate) {
+    gateController->setOverride(override);
+  } else {
+    dustCollectorOverride = override;
+    updateDustCollectorPin();
+  }
+}
+
+void onStatsCommand(uint8_t argc, char **argv) {
+  Serial.print(F("Address: "));
+  Serial.print(ids.getAddress());
+  Serial.print(F(" id: "));
+  Serial.println(ids.getID());
+  if (mode == MACHINE) {
+    Serial.print(F("Current: "));
+    Serial.print(currentDetector->getAmps());
+    Serial.print(F(" idle: "));
+    Serial.print(currentDetector->getIdleBaseline());
+    Serial.print(F(" running: "));
+    Serial.println(currentDetector->isRunning());
+    currentDetector->getLoadClassifier().report();
+  } else if (mode == DUST_COLLECTOR) {
+    Serial.print(F("Dust collector on: "));
+    Serial.print(dustCollectorOn);
+    uint8_t active = 0;
+    for (uint8_t i = 0; i < MAX_NODES; i++) {
+      if (activeMachines[i / 8] & (1 << (i % 8))) {
+        active++;
       }
     }
+    Serial.print(F(" machines running: "));
+    Serial.println(active);
+    if (collectorGroup != NULL) {
+      collectorGroup->report();
+    }
+  } else if (mode == AUX_COLLECTOR) {
+    Serial.print(F("Collector on: "));
+    Serial.print(dustCollectorOn);
+    Serial.print(F(" zones: "));
+    Serial.print(ids.currentGateCode());
+    Serial.print(F(" assigned by the dust collector: "));
+    Serial.println(RoleLogic<AuxCollectorRole>::isAssigned());
+  }
+  if (Role::hasGate) {
+    Serial.print(F("Servos powered: "));
+    Serial.print(gateController->getAttachedMs() / 1000);
+    Serial.print(F("s of "));
+    Serial.print(millis() / 1000);
+    Serial.println(F("s"));
+  }
+  bootTimer.report();
+  watchdog.report();
+  profiler.report();
+}
+
+void onDumpCommand(uint8_t argc, char **argv) {
+  if (telemetry == NULL) {
+    Serial.println(F("Only the dust collector keeps telemetry"));
+    return;
   }
+  telemetry->dump();
+}
 
-  int rVal = 0;
-  int maxVal = 0;
-  int minVal = 1023;
-  unsigned long sampleDuration = 100; // 100ms
+void onLinksCommand(uint8_t argc, char **argv) {
+  if (linkAdapter == NULL) {
+    radioController.getLinkStats().report();
+    return;
+  }
+  linkAdapter->report();
+}
 
-  unsigned long startTime = millis();
-  // take samples for 100ms
-  while ((millis() - startTime) < sampleDuration)
-  {
-    rVal = analogRead(CURRENT_SENSOR_PIN);
-    if (rVal > maxVal)
-      maxVal = rVal;
+void onPowerCommand(uint8_t argc, char **argv) {
+  if (powerManager == NULL) {
+    Serial.println(F("Only nodes with LOW_POWER_IDLE sleep"));
+    return;
+  }
+  powerManager->report();
+}
 
-    if (rVal < minVal)
-      minVal = rVal;
+void onTickCommand(uint8_t argc, char **argv) {
+  if (!TRAFFIC_REPLAY || argc < 2) {
+    Serial.println(F("Needs TRAFFIC_REPLAY and a number of ms"));
+    return;
   }
+  advanceMillis(strtoul(argv[1], NULL, 10));
+  Serial.print(F("@"));
+  Serial.print(millis());
+  Serial.println(F(" tick"));
+}
 
-  // Subtract min from max to determine the peak to peak range
-  // 1023 = the max value we'll get on the input (1024, zero indexed)
-  // 5.0 = 5v total on adc input
-  double volt = ((maxVal - minVal) * (5.0 / 1023.0));
+void onReceiveCommand(uint8_t argc, char **argv) {
+  if (!TRAFFIC_REPLAY || argc < 2 || strlen(argv[1]) != 2 * sizeof(Payload)) {
+    Serial.println(F("Needs TRAFFIC_REPLAY and a whole payload in hex"));
+    return;
+  }
+  Payload payload;
+  uint8_t *bytes = (uint8_t *) &payload;
+  char digits[3] = {0};
+  for (uint8_t i = 0; i < sizeof(Payload); i++) {
+    digits[0] = argv[1][2 * i];
+    digits[1] = argv[1][2 * i + 1];
+    bytes[i] = strtoul(digits, NULL, 16);
+  }
+  radioController.inject(payload);
+}
 
-  // div by 2 is to calculate RMS from peak to peak
-  // 0.35355 is factor to calculate RMS from peak to peak
-  // see http://www.learningaboutelectronics.com/Articles/Voltage-rms-calculator.php
-  double voltRMS = volt * 0.35355;
+void onFaultCommand(uint8_t argc, char **argv) {
+  if (!FAULT_INJECTION) {
+    Serial.println(F("Needs FAULT_INJECTION"));
+    return;
+  }
+  if (argc == 3 && strcmp_P(argv[1], PSTR("radio")) == 0) {
+    radioController.injectRadioFault(strcmp_P(argv[2], PSTR("brownout")) == 0);
+  } else if (argc == 2 && strcmp_P(argv[1], PSTR("clear")) == 0) {
+    faults->clear();
+  } else if (argc == 3 && !faults->set(argv[1], atoi(argv[2]))) {
+    Serial.println(F("Faults are droprx, corruptrx, delayrx, droptx, adcnoise and servostall"));
+    return;
+  }
+  faults->report();
+}
 
-  // x 1000 to convert volts to millivolts
-  // divide by the number of millivolts per amp to determine amps measured
-  // the 20A module 100 mv/A (so in this case ampsRMS = voltRMS
-  double ampsRMS = (voltRMS * 1000) / 66;
+void onLatencyCommand(uint8_t argc, char **argv) {
+  if (latency == NULL) {
+    Serial.println(F("The gateway keeps no latency stats"));
+    return;
+  }
+  latency->report();
+}
 
-  return ampsRMS;
+void onConfigApplied(const ConfigValues &previous) {
+  if (Role::sensesCurrent) {
+    currentDetector->setThresholds(config.get().activateAboveCentiamps / 100.0, config.get().stayActiveAboveCentiamps / 100.0);
+  }
+  if (mode == DUST_COLLECTOR) {
+    configPush->push(config.get().channel != previous.channel);
+  }
+  if (spinDown != NULL) {
+    spinDown->refresh();
+  }
 }
 
+void onConfigCommand(uint8_t argc, char **argv) {
+  if (argc >= 2 && mode != DUST_COLLECTOR) {
+    Serial.println(F("Only the dust collector changes the config"));
+    return;
+  }
+  if (argc == 2 && strcmp_P(argv[1], PSTR("push")) == 0) {
+    configPush->push(false);
+  } else if (argc >= 3 && !config.set(argv[1], strtoul(argv[2], NULL, 10))) {
+    Serial.println(F("Names are channel, on, off, broadcast, turnoff, close, branch, spinmin and spinmax"));
+    Serial.println(F("off can't be above on, or spinmin above spinmax"));
+    return;
+  }
+  config.report();
+  if (configPush != NULL) {
+    configPush->report();
+  }
+}
+
+void onSpinDownCommand(uint8_t argc, char **argv) {
+  if (spinDown == NULL) {
+    Serial.println(F("Only the dust collector learns spin down delays"));
+    return;
+  }
+  spinDown->report(argc >= 2 ? atoi(argv[1]) : ADDRESS_UNSET);
+}
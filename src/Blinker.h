@@ -2,20 +2,33 @@
 #define blinker_h
 
 #include <Arduino.h>
+#include "FastPin.h"
 
+/**
+ * Blinks an LED while enabled.  The LED is shared with whoever drives it the
+ * rest of the time.
+ */
+template <uint8_t PIN>
 class Blinker {
     public:
-        Blinker(const int pin, const unsigned long blinkDelay) : pin(pin), blinkDelay(blinkDelay) {};
-        void setup();
-        void onLoop();
-        bool isEnabled();
-        void setEnabled(bool enabled);
+        Blinker(Led<PIN> &led, const unsigned long blinkDelay) : led(led), blinkDelay(blinkDelay) {};
+        void onLoop() {
+            if (enabled && (lastBlinkMs + blinkDelay) < millis()) {
+                lastBlinkMs = millis();
+                led.set(!led.isOn());
+            }
+        }
+        bool isEnabled() { return enabled; }
+        void setEnabled(bool enabled) {
+            this->enabled = enabled;
+            lastBlinkMs = millis();
+            led.set(enabled);
+        }
     private:
-        const int pin;
+        Led<PIN> &led;
         const unsigned long blinkDelay;
         unsigned long lastBlinkMs = 0;
-        bool ledOn = false;
         bool enabled = false;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,23 @@
+#include "BootTimer.h"
+
+void BootTimer::mark(BootPhase phase) {
+    if (phaseMs[phase] == 0) {
+        // millis() can still be 0 this early, so never record a 0.
+        phaseMs[phase] = max(millis(), 1UL);
+    }
+}
+
+void BootTimer::report() {
+    unsigned long start = phaseMs[BOOT_SETUP_START];
+    Serial.print(warmStart ? F("Warm") : F("Cold"));
+    Serial.print(F(" boot timing (ms since setup): gate="));
+    Serial.print(phaseMs[BOOT_GATE_READY] - start);
+    Serial.print(F(" setup="));
+    Serial.print(phaseMs[BOOT_SETUP_DONE] - start);
+    Serial.print(F(" radio="));
+    Serial.print(phaseMs[BOOT_RADIO_READY] - start);
+    Serial.print(F(" firstLoop="));
+    Serial.print(phaseMs[BOOT_FIRST_LOOP] - start);
+    Serial.print(F(" operational="));
+    Serial.println(phaseMs[BOOT_OPERATIONAL] - start);
+}
@@ -0,0 +1,31 @@
+#ifndef boot_timer_h
+#define boot_timer_h
+
+#include <Arduino.h>
+
+enum BootPhase {
+    BOOT_SETUP_START,
+    BOOT_GATE_READY,
+    BOOT_SETUP_DONE,
+    BOOT_RADIO_READY,
+    BOOT_FIRST_LOOP,
+    BOOT_OPERATIONAL, // First loop with the radio up and the gate in place
+    BOOT_PHASE_COUNT
+};
+
+/**
+ * Records when each phase of boot finished so we can see how long it takes
+ * each role to get back to normal operation.
+ */
+class BootTimer {
+    public:
+        void mark(BootPhase phase);
+        bool isMarked(BootPhase phase) const { return phaseMs[phase] != 0; }
+        void setWarmStart(bool warmStart) { this->warmStart = warmStart; }
+        void report();
+    private:
+        unsigned long phaseMs[BOOT_PHASE_COUNT] = {0};
+        bool warmStart = false;
+};
+
+#endif
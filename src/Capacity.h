@@ -0,0 +1,55 @@
+#ifndef capacity_h
+#define capacity_h
+
+#include <Arduino.h>
+
+/**
+ * Every table and buffer that takes SRAM is sized here, so there is one place
+ * to look when a role runs short.  Everything is allocated statically (see
+ * Slot), so these and the role decide the whole memory map at build time.
+ * tools/memory_report.py checks each build against the margins below.
+ */
+
+/**
+ * Nodes the dust collector leases addresses to.  Sets the lease table and the
+ * per-machine tables on the dust collector and gateway, and the spin down
+ * histograms in EEPROM (see EepromLayout.h), so changing it moves EEPROM.
+ */
+const uint8_t MAX_NODES = 40;
+
+/**
+ * Collectors sharing the work, counting the dust collector itself.
+ */
+const uint8_t MAX_COLLECTORS = 4;
+
+/**
+ * Frames waiting for a clear channel (see CSMA in RadioController.h).
+ */
+const uint8_t CSMA_QUEUE_SIZE = 4;
+
+/**
+ * Long enough for "rx" and a whole Payload in hex.
+ */
+const uint8_t CONSOLE_LINE_LENGTH = 48;
+const uint8_t CONSOLE_MAX_ARGS = 4;
+
+/**
+ * Telemetry events held in SRAM between EEPROM checkpoints.  Also the size
+ * of the telemetry block in EEPROM.
+ */
+const unsigned int TELEMETRY_BUFFER_SIZE = 192;
+
+/**
+ * What has to be left over.  STACK_RESERVE is an estimate, not a measurement:
+ * a little under a fifth of the 2KB, for the deepest chain we know of (loop,
+ * processCommand, a console command printing) with the radio and pin change
+ * interrupts on top.  Check it on each role against the stackPeak the "stats"
+ * command prints, and raise it if any goes deeper.  MIN_FREE_SRAM is the
+ * margin on top of it that every build must keep.  At run time the stack
+ * probe (see Profiler::neverUsedMemory) warns once less than MIN_FREE_SRAM
+ * has never been touched.
+ */
+const unsigned int STACK_RESERVE = 384;
+const unsigned int MIN_FREE_SRAM = 128;
+
+#endif
@@ -0,0 +1,131 @@
+#include "ChannelManager.h"
+
+void ChannelManager::onLoop(bool idle) {
+    if (switchTime != VALUE_UNSET && switchTime <= millis()) {
+        switchTime = VALUE_UNSET;
+        radioController.setChannel(pendingChannel, pendingDataRate, true);
+    }
+    if (mode == DUST_COLLECTOR) {
+        onCollectorLoop(idle);
+    } else {
+        onNodeLoop();
+    }
+}
+
+void ChannelManager::scheduleSwitch(uint8_t channel, rf24_datarate_e dataRate, unsigned long delayMs) {
+    if (channel > MAX_CHANNEL || dataRate > RF24_250KBPS) {
+        return;
+    }
+    pendingChannel = channel;
+    pendingDataRate = dataRate;
+    switchTime = millis() + delayMs;
+}
+
+void ChannelManager::announceSwitch(uint8_t channel, rf24_datarate_e dataRate) {
+    scheduleSwitch(channel, dataRate, CHANNEL_SWITCH_DELAY_MS);
+    announcementsLeft = CHANNEL_ANNOUNCEMENTS;
+    lastAnnouncementTime = 0;
+}
+
+void ChannelManager::onCollectorLoop(bool idle) {
+    if ((lastBeaconTime + BEACON_INTERVAL_MS) < millis()) {
+        lastBeaconTime = millis();
+        radioController.sendTo(ADDRESS_UNSET, BEACON, millis());
+    }
+
+    if (announcementsLeft > 0 && (lastAnnouncementTime + CHANNEL_ANNOUNCE_SPACING_MS) < millis()) {
+        announcementsLeft--;
+        lastAnnouncementTime = millis();
+        unsigned long remaining = switchTime > millis() ? switchTime - millis() : 0;
+        radioController.sendTo(ADDRESS_UNSET, CHANNEL_CHANGE, (remaining << 16) | ((unsigned long) pendingDataRate << 8) | pendingChannel);
+    }
+    if (isSwitching()) {
+        return;
+    }
+
+    if (surveyIndex >= CANDIDATE_CHANNEL_COUNT) {
+        if ((lastSurveyStartTime + CHANNEL_SURVEY_INTERVAL_MS) < millis()) {
+            lastSurveyStartTime = millis();
+            surveyIndex = 0;
+        }
+        return;
+    }
+    if (!idle || (lastSurveyStepTime + CHANNEL_SURVEY_STEP_MS) > millis()) {
+        return;
+    }
+    lastSurveyStepTime = millis();
+    uint8_t busy = radioController.sampleChannel(candidateChannel(surveyIndex), CHANNEL_SURVEY_SAMPLES);
+    unsigned int busyScore = (unsigned int) busy * 255 / CHANNEL_SURVEY_SAMPLES;
+    // Smooth over several passes so one burst of Wi-Fi doesn't move us.
+    busyScores[surveyIndex] = (busyScores[surveyIndex] * 3 + busyScore) / 4;
+    surveyIndex++;
+    if (surveyIndex >= CANDIDATE_CHANNEL_COUNT) {
+        pickChannel();
+    }
+}
+
+void ChannelManager::pickChannel() {
+    uint8_t best = 0;
+    int currentScore = -1;
+    for (uint8_t i = 0; i < CANDIDATE_CHANNEL_COUNT; i++) {
+        if (busyScores[i] < busyScores[best]) {
+            best = i;
+        }
+        if (candidateChannel(i) == radioController.getChannel()) {
+            currentScore = busyScores[i];
+        }
+    }
+    if (candidateChannel(best) == radioController.getChannel()
+            || (currentScore >= 0 && currentScore < busyScores[best] + CHANNEL_SWITCH_MARGIN)) {
+        return;
+    }
+    Serial.print(F("Moving everyone to channel "));
+    Serial.print(candidateChannel(best));
+    Serial.print(F(" (busy "));
+    Serial.print(busyScores[best]);
+    Serial.print(F(" vs "));
+    Serial.print(currentScore);
+    Serial.println(F(")"));
+    announceSwitch(candidateChannel(best), radioController.getDataRate());
+}
+
+void ChannelManager::onNodeLoop() {
+    unsigned long lastContact = radioController.getLastCollectorContactTime();
+    if (scanning) {
+        if (lastContact > lastScanHopTime) {
+            Serial.print(F("Found the dust collector on channel "));
+            Serial.println(radioController.getChannel());
+            scanning = false;
+            radioController.setChannel(radioController.getChannel(), radioController.getDataRate(), true);
+        } else if ((lastScanHopTime + CHANNEL_SCAN_DWELL_MS) < millis()) {
+            lastScanHopTime = millis();
+            if (++scanHops > CANDIDATE_CHANNEL_COUNT * DATA_RATE_COUNT) {
+                // It's probably just off.  Go home and try again later.
+                Serial.println(F("Could not find the dust collector"));
+                scanning = false;
+                radioController.setChannel(homeChannel, homeDataRate, false);
+                return;
+            }
+            // Every channel at one rate, then the next rate.  The rf24_datarate_e
+            // values are 0 to 2.
+            scanIndex = (scanIndex + 1) % (CANDIDATE_CHANNEL_COUNT * DATA_RATE_COUNT);
+            radioController.setChannel(candidateChannel(scanIndex % CANDIDATE_CHANNEL_COUNT),
+                    (rf24_datarate_e) (scanIndex / CANDIDATE_CHANNEL_COUNT), false);
+            // A late answer from the last channel would look like the
+            // collector is on this one.
+            radioController.discardReceived();
+            if (Role::transmits) {
+                radioController.broadcastCommand(HELLO_WORLD);
+            }
+        }
+    } else if (switchTime == VALUE_UNSET && (max(lastContact, lastScanHopTime) + COLLECTOR_CONTACT_TIMEOUT_MS) < millis()) {
+        Serial.println(F("Lost the dust collector.  Scanning for it"));
+        scanning = true;
+        scanHops = 0;
+        homeChannel = radioController.getChannel();
+        homeDataRate = radioController.getDataRate();
+        // Counts as the first hop, so the contact we lost doesn't look
+        // like finding it again.  We listen at home for a dwell first.
+        lastScanHopTime = millis();
+    }
+}
@@ -0,0 +1,97 @@
+#ifndef channel_manager_h
+#define channel_manager_h
+
+#include <Arduino.h>
+#include "RadioController.h"
+
+/**
+ * Channels we will consider moving to.  Every 5th channel, which still puts
+ * a few of them clear of each Wi-Fi channel.  Includes CHANNEL.
+ */
+const uint8_t FIRST_CANDIDATE_CHANNEL = 2;
+const uint8_t CANDIDATE_CHANNEL_STEP = 5;
+const uint8_t CANDIDATE_CHANNEL_COUNT = 25;
+
+const unsigned long BEACON_INTERVAL_MS = 30000;
+
+/**
+ * The dust collector surveys one channel every CHANNEL_SURVEY_STEP_MS while
+ * it is off, and starts a new pass over all of them every
+ * CHANNEL_SURVEY_INTERVAL_MS.
+ */
+const unsigned long CHANNEL_SURVEY_INTERVAL_MS = 10L * 60L * 1000L;
+const unsigned long CHANNEL_SURVEY_STEP_MS = 1000;
+const uint8_t CHANNEL_SURVEY_SAMPLES = 16;
+
+/**
+ * Only move if the best channel is busy this much less of the time than
+ * ours (out of 255), so we don't hop back and forth between similar ones.
+ */
+const uint8_t CHANNEL_SWITCH_MARGIN = 40;
+
+/**
+ * The switch is announced a few times, then everyone moves together.
+ */
+const unsigned long CHANNEL_SWITCH_DELAY_MS = 2000;
+const uint8_t CHANNEL_ANNOUNCEMENTS = 3;
+const unsigned long CHANNEL_ANNOUNCE_SPACING_MS = 400;
+
+/**
+ * A node that hasn't heard the dust collector for this long goes looking
+ * for it, saying hello on each candidate channel at each data rate in turn.
+ */
+const unsigned long COLLECTOR_CONTACT_TIMEOUT_MS = 3 * BEACON_INTERVAL_MS + 5000;
+const unsigned long CHANNEL_SCAN_DWELL_MS = 300;
+
+const uint8_t DATA_RATE_COUNT = 3;
+
+/**
+ * Keeps the network on a quiet channel.  The dust collector beacons, surveys
+ * the band with the chip's received power detector and moves everyone when
+ * it finds a better channel.  Nodes follow those moves, and scan for the
+ * collector if they lose it.
+ */
+class ChannelManager {
+    public:
+        ChannelManager(RadioController &radioController) : radioController(radioController) {};
+        /**
+         * idle is true when the dust collector is off, which is when it is ok
+         * to step away from our channel for a few ms.
+         */
+        void onLoop(bool idle);
+        void scheduleSwitch(uint8_t channel, rf24_datarate_e dataRate, unsigned long delayMs);
+        /**
+         * From the dust collector: tells everyone to move, then moves.
+         */
+        void announceSwitch(uint8_t channel, rf24_datarate_e dataRate);
+        bool isSwitching() const { return announcementsLeft > 0 || switchTime != VALUE_UNSET; }
+        bool isScanning() const { return scanning; }
+    private:
+        RadioController &radioController;
+
+        uint8_t busyScores[CANDIDATE_CHANNEL_COUNT] = {0};
+        uint8_t surveyIndex = CANDIDATE_CHANNEL_COUNT;
+        unsigned long lastSurveyStartTime = 0;
+        unsigned long lastSurveyStepTime = 0;
+        unsigned long lastBeaconTime = 0;
+        uint8_t announcementsLeft = 0;
+        unsigned long lastAnnouncementTime = 0;
+
+        uint8_t pendingChannel = CHANNEL;
+        rf24_datarate_e pendingDataRate = RADIO_DATA_RATE;
+        unsigned long switchTime = VALUE_UNSET;
+
+        bool scanning = false;
+        uint8_t scanIndex = 0;
+        uint8_t scanHops = 0;
+        uint8_t homeChannel = CHANNEL;
+        rf24_datarate_e homeDataRate = RADIO_DATA_RATE;
+        unsigned long lastScanHopTime = 0;
+
+        static uint8_t candidateChannel(uint8_t index) { return FIRST_CANDIDATE_CHANNEL + index * CANDIDATE_CHANNEL_STEP; }
+        void onCollectorLoop(bool idle);
+        void onNodeLoop();
+        void pickChannel();
+};
+
+#endif
@@ -0,0 +1,13 @@
+#include "Clock.h"
+#include <util/atomic.h>
+
+/**
+ * Kept by the Arduino core (wiring.c).
+ */
+extern volatile unsigned long timer0_millis;
+
+void advanceMillis(unsigned long ms) {
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        timer0_millis += ms;
+    }
+}
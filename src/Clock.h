@@ -0,0 +1,12 @@
+#ifndef clock_h
+#define clock_h
+
+#include <Arduino.h>
+
+/**
+ * Moves millis() forward.  For time the clock didn't see (asleep with timer0
+ * stopped) or, when replaying traffic, time we want to skip.
+ */
+void advanceMillis(unsigned long ms);
+
+#endif
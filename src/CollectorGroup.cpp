@@ -0,0 +1,220 @@
+#include "CollectorGroup.h"
+
+CollectorGroup::CollectorGroup(RadioController &radioController) : radioController(radioController) {
+    collectors[0].address = DUST_COLLECTOR_ADDRESS;
+    collectors[0].capacity = COLLECTOR_CAPACITY;
+    // On the main trunk, so it reaches every branch.
+    collectors[0].zones = 0;
+}
+
+void CollectorGroup::onInfo(const Payload &payload) {
+    if (!LeaseTable::isNodeAddress(payload.id)) {
+        return;
+    }
+    uint8_t free = MAX_COLLECTORS;
+    for (uint8_t i = 1; i < MAX_COLLECTORS; i++) {
+        Collector &collector = collectors[i];
+        bool expired = collector.address != ADDRESS_UNSET && (collector.lastSeenTime + COLLECTOR_EXPIRY_MS) < millis();
+        if (collector.address == payload.id) {
+            free = i;
+            break;
+        }
+        if (free == MAX_COLLECTORS && (collector.address == ADDRESS_UNSET || (expired && !collector.running))) {
+            free = i;
+        }
+    }
+    if (free == MAX_COLLECTORS) {
+        Serial.println(F("No room for another collector"));
+        return;
+    }
+    Collector &collector = collectors[free];
+    if (collector.address != payload.id || collector.capacity != (payload.data & 0xFF) || collector.zones != (payload.gateCode & 0xFF)) {
+        Serial.print(F("Collector "));
+        Serial.print(payload.id);
+        Serial.print(F(" capacity: "));
+        Serial.print(payload.data & 0xFF);
+        Serial.print(F(" zones: "));
+        Serial.println(payload.gateCode & 0xFF);
+        dirty = true;
+    }
+    collector.address = payload.id;
+    collector.capacity = payload.data & 0xFF;
+    collector.zones = payload.gateCode & 0xFF;
+    collector.lastSeenTime = millis();
+}
+
+void CollectorGroup::onRunning(uint8_t address, uint8_t demand, uint8_t zones) {
+    if (!LeaseTable::isNodeAddress(address)) {
+        return;
+    }
+    uint8_t index = address - FIRST_NODE_ADDRESS;
+    if (machineDemand[index] != demand || machineZones[index] != zones) {
+        machineDemand[index] = demand;
+        machineZones[index] = zones;
+        dirty = true;
+    }
+}
+
+uint8_t CollectorGroup::choose(const uint8_t *activeMachines) const {
+    unsigned int demand = 0;
+    uint8_t zones = 0;
+    // A machine with no gate code is on the main trunk, which only a
+    // collector that reaches every branch can serve.
+    bool trunk = false;
+    for (uint8_t i = 0; i < MAX_NODES; i++) {
+        if (activeMachines[i / 8] & (1 << (i % 8))) {
+            demand += machineDemand[i];
+            zones |= machineZones[i];
+            trunk = trunk || machineZones[i] == 0;
+        }
+    }
+
+    uint8_t available = 0;
+    uint8_t reaching = 0;
+    for (uint8_t i = 0; i < MAX_COLLECTORS; i++) {
+        const Collector &collector = collectors[i];
+        if (i == 0 || (collector.address != ADDRESS_UNSET && (collector.lastSeenTime + COLLECTOR_EXPIRY_MS) >= millis())) {
+            available |= 1 << i;
+            if (collector.zones == 0 || (collector.zones & zones) != 0) {
+                reaching |= 1 << i;
+            }
+        }
+    }
+
+    // Few enough collectors to just try every combination.
+    uint8_t best = 0;
+    unsigned int bestCapacity = UINT16_MAX;
+    for (uint8_t set = 1; set < (1 << MAX_COLLECTORS); set++) {
+        if ((set & available) != set) {
+            continue;
+        }
+        unsigned int capacity = 0;
+        uint8_t covered = 0;
+        bool coversTrunk = false;
+        for (uint8_t i = 0; i < MAX_COLLECTORS; i++) {
+            if (set & (1 << i)) {
+                capacity += collectors[i].capacity;
+                covered |= collectors[i].zones == 0 ? 0xFF : collectors[i].zones;
+                coversTrunk = coversTrunk || collectors[i].zones == 0;
+            }
+        }
+        if ((covered & zones) != zones || (trunk && !coversTrunk) || capacity < demand) {
+            continue;
+        }
+        // Less airflow wins, then what is already running, so we don't swap
+        // between two that are just as good.
+        if (capacity < bestCapacity || (capacity == bestCapacity && set == chosen)) {
+            best = set;
+            bestCapacity = capacity;
+        }
+    }
+    if (best == 0) {
+        // Nothing is enough.  Run everything that helps.
+        best = reaching | 1;
+    }
+    return best;
+}
+
+void CollectorGroup::apply(uint8_t set) {
+    unsigned long now = millis();
+    for (uint8_t i = 0; i < MAX_COLLECTORS; i++) {
+        Collector &collector = collectors[i];
+        if (set & (1 << i)) {
+            collector.running = true;
+            collector.stopTime = VALUE_UNSET;
+        } else if (collector.running && collector.stopTime == VALUE_UNSET) {
+            collector.stopTime = set == 0 ? now : now + COLLECTOR_HANDOVER_MS;
+        }
+        if (collector.running && collector.stopTime != VALUE_UNSET && collector.stopTime <= now) {
+            collector.running = false;
+            collector.stopTime = VALUE_UNSET;
+        }
+    }
+}
+
+void CollectorGroup::onLoop(bool on, const uint8_t *activeMachines) {
+    uint8_t previous = 0;
+    for (uint8_t i = 0; i < MAX_COLLECTORS; i++) {
+        if (collectors[i].running) {
+            previous |= 1 << i;
+        }
+    }
+    bool anyActive = false;
+    for (uint8_t i = 0; i < sizeof(lastActiveMachines); i++) {
+        anyActive = anyActive || activeMachines[i] != 0;
+        if (activeMachines[i] != lastActiveMachines[i]) {
+            lastActiveMachines[i] = activeMachines[i];
+            dirty = true;
+        }
+    }
+    // A chosen collector that went quiet is replaced now, not at the next
+    // change in demand.
+    uint8_t lost = 0;
+    for (uint8_t i = 1; i < MAX_COLLECTORS; i++) {
+        if ((chosen & (1 << i)) && (collectors[i].lastSeenTime + COLLECTOR_EXPIRY_MS) < millis()) {
+            lost |= 1 << i;
+        }
+    }
+    if (lost != 0) {
+        dirty = true;
+        chosen &= ~lost;
+    }
+    if (!on) {
+        chosen = 0;
+    } else if (chosen == 0 || (dirty && anyActive)) {
+        // While spinning down nobody is running, so we keep what we had
+        // rather than drop to the smallest.
+        chosen = choose(activeMachines);
+    }
+    dirty = false;
+    apply(chosen);
+
+    uint8_t running = 0;
+    for (uint8_t i = 0; i < MAX_COLLECTORS; i++) {
+        if (collectors[i].running) {
+            running |= 1 << i;
+        }
+    }
+    if (running != previous) {
+        assignsAfterStop = 3;
+        sendAssignment();
+    } else if ((running != 0 || assignsAfterStop > 0) && (lastAssignTime + COLLECTOR_ASSIGN_INTERVAL_MS) < millis()) {
+        if (running == 0) {
+            // Say it a few times when everything stops, then go quiet.
+            assignsAfterStop--;
+        }
+        sendAssignment();
+    }
+}
+
+void CollectorGroup::sendAssignment() {
+    unsigned long data = 0;
+    uint8_t slot = 0;
+    for (uint8_t i = 0; i < MAX_COLLECTORS; i++) {
+        if (collectors[i].running) {
+            data |= (unsigned long) collectors[i].address << (8 * slot++);
+        }
+    }
+    lastAssignTime = millis();
+    radioController.sendTo(ADDRESS_UNSET, COLLECTOR_ASSIGN, data);
+}
+
+void CollectorGroup::report() const {
+    for (uint8_t i = 0; i < MAX_COLLECTORS; i++) {
+        const Collector &collector = collectors[i];
+        if (collector.address == ADDRESS_UNSET) {
+            continue;
+        }
+        Serial.print(F("Collector "));
+        Serial.print(collector.address);
+        Serial.print(F(" capacity: "));
+        Serial.print(collector.capacity * 10);
+        Serial.print(F("CFM zones: "));
+        Serial.print(collector.zones);
+        Serial.print(F(" running: "));
+        Serial.print(collector.running);
+        Serial.print(F(" last seen: "));
+        Serial.print((millis() - collector.lastSeenTime) / 1000);
+        Serial.println(F("s ago"));
+    }
+}
@@ -0,0 +1,89 @@
+#ifndef collector_group_h
+#define collector_group_h
+
+#include <Arduino.h>
+#include "RadioController.h"
+#include "Ids.h"
+#include "LeaseTable.h"
+
+/**
+ * Aux collectors say what they can do this often, and are forgotten after
+ * missing three.
+ */
+const unsigned long COLLECTOR_INFO_INTERVAL_MS = 30000;
+const unsigned long COLLECTOR_EXPIRY_MS = 3 * COLLECTOR_INFO_INTERVAL_MS + 5000;
+
+/**
+ * The assignment goes out whenever it changes, and this often while any
+ * collector is running, so one that missed it catches up.  An aux collector
+ * that hears nothing for COLLECTOR_ASSIGN_TIMEOUT_MS runs on its own (see
+ * RoleLogic<AuxCollectorRole>).
+ */
+const unsigned long COLLECTOR_ASSIGN_INTERVAL_MS = 2000;
+const unsigned long COLLECTOR_ASSIGN_TIMEOUT_MS = 3 * COLLECTOR_ASSIGN_INTERVAL_MS + 500;
+
+/**
+ * A collector that is no longer needed keeps running this long after the
+ * ones replacing it were told to start, so the airflow never drops while
+ * they spin up.
+ */
+const unsigned long COLLECTOR_HANDOVER_MS = 5000;
+
+struct Collector {
+    uint8_t address = ADDRESS_UNSET;
+    uint8_t capacity = 0;      // Airflow, in 10 CFM
+    uint8_t zones = 0;         // Branch gate code bits its ducting reaches.  0 is all of them
+    bool running = false;
+    unsigned long stopTime = VALUE_UNSET;
+    unsigned long lastSeenTime = 0;
+};
+
+/**
+ * Kept by the dust collector.  Picks which collectors run for the machines
+ * that are running now: the smallest total capacity that covers their
+ * demand, with every branch they are on reached by one of them.  When
+ * nothing can, everything that reaches them runs.
+ *
+ * The choice goes out in COLLECTOR_ASSIGN (data is up to four addresses, a
+ * byte each).  Only the dust collector decides, so there is nothing for the
+ * collectors to disagree on.  The dust collector is one of the candidates,
+ * and with no aux collectors it is always the one picked.
+ */
+class CollectorGroup {
+    public:
+        CollectorGroup(RadioController &radioController);
+        void onInfo(const Payload &payload);
+        /**
+         * A machine's demand (10 CFM) and the branches it is on, from its
+         * RUNNING.  Which machines are running comes from onLoop().
+         */
+        void onRunning(uint8_t address, uint8_t demand, uint8_t zones);
+        /**
+         * on is whether the dust collector logic wants airflow at all, which
+         * already includes the spin down delay.
+         */
+        void onLoop(bool on, const uint8_t *activeMachines);
+        /**
+         * Whether the dust collector's own relay should be closed.
+         */
+        bool isSelfRunning() const { return collectors[0].running; }
+        void report() const;
+    private:
+        RadioController &radioController;
+        Collector collectors[MAX_COLLECTORS];
+        uint8_t machineDemand[MAX_NODES] = {0};
+        uint8_t machineZones[MAX_NODES] = {0};
+        uint8_t lastActiveMachines[(MAX_NODES + 7) / 8] = {0};
+        bool dirty = false;
+        uint8_t chosen = 0;  // Bit per collector
+        unsigned long lastAssignTime = 0;
+        uint8_t assignsAfterStop = 0;
+
+        uint8_t choose(const uint8_t *activeMachines) const;
+        void apply(uint8_t set);
+        void sendAssignment();
+};
+
+extern CollectorGroup *const collectorGroup;
+
+#endif
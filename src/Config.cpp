@@ -0,0 +1,105 @@
+#include "Config.h"
+#include <EEPROM.h>
+#include <util/crc16.h>
+#include "EepromLayout.h"
+
+Config config;
+
+uint16_t Config::crcOf(const ConfigValues &values) {
+    const uint8_t *bytes = (const uint8_t *) &values;
+    // Seeded with the layout so a block from other firmware never checks out.
+    // Up to the crc field rather than the size, which has padding after it
+    // anywhere but avr-gcc.
+    uint16_t crc = 0xFFFF ^ CONFIG_LAYOUT;
+    for (uint8_t i = 0; i < offsetof(ConfigValues, crc); i++) {
+        crc = _crc_ccitt_update(crc, bytes[i]);
+    }
+    return crc;
+}
+
+void Config::load() {
+    ConfigValues saved;
+    EEPROM.get(EEPROM_CONFIG_ADDRESS, saved);
+    if (saved.crc != crcOf(saved)) {
+        Serial.println(F("No saved config.  Using the defaults"));
+        values.crc = crcOf(values);
+        return;
+    }
+    values = saved;
+    Serial.print(F("Loaded config version: "));
+    Serial.println(values.version);
+}
+
+bool Config::apply(const ConfigValues &newValues) {
+    if (newValues.crc != crcOf(newValues)) {
+        return false;
+    }
+    ConfigValues previous = values;
+    values = newValues;
+    EEPROM.put(EEPROM_CONFIG_ADDRESS, values);
+    Serial.print(F("Applied config version: "));
+    Serial.println(values.version);
+    if (listener != NULL) {
+        listener(previous);
+    }
+    return true;
+}
+
+bool Config::set(const char *name, unsigned long value) {
+    ConfigValues changed = values;
+    // The 16 bit fields would silently wrap.
+    bool fits16 = value <= UINT16_MAX;
+    if (strcmp_P(name, PSTR("channel")) == 0 && value <= MAX_CHANNEL) {
+        changed.channel = value;
+    } else if (strcmp_P(name, PSTR("on")) == 0 && fits16) {
+        changed.activateAboveCentiamps = value;
+    } else if (strcmp_P(name, PSTR("off")) == 0 && fits16) {
+        changed.stayActiveAboveCentiamps = value;
+    } else if (strcmp_P(name, PSTR("broadcast")) == 0 && fits16) {
+        changed.onBroadcastIntervalMs = value;
+    } else if (strcmp_P(name, PSTR("turnoff")) == 0) {
+        changed.collectorTurnOffDelayMs = value;
+    } else if (strcmp_P(name, PSTR("close")) == 0) {
+        changed.closeGateDelayMs = value;
+    } else if (strcmp_P(name, PSTR("branch")) == 0) {
+        changed.closeBranchGateDelayMs = value;
+    } else if (strcmp_P(name, PSTR("spinmin")) == 0 && fits16) {
+        changed.spinDownMinS = value;
+    } else if (strcmp_P(name, PSTR("spinmax")) == 0 && fits16) {
+        changed.spinDownMaxS = value;
+    } else {
+        return false;
+    }
+    // Checked before a new version goes out, so a bad block never reaches a node.
+    if (changed.stayActiveAboveCentiamps > changed.activateAboveCentiamps
+            || changed.spinDownMinS > changed.spinDownMaxS) {
+        return false;
+    }
+    changed.version++;
+    changed.crc = crcOf(changed);
+    return apply(changed);
+}
+
+void Config::report() const {
+    Serial.print(F("Config version: "));
+    Serial.print(values.version);
+    Serial.print(F(" channel="));
+    Serial.print(values.channel);
+    Serial.print(F(" on="));
+    Serial.print(values.activateAboveCentiamps);
+    Serial.print(F("cA off="));
+    Serial.print(values.stayActiveAboveCentiamps);
+    Serial.print(F("cA broadcast="));
+    Serial.print(values.onBroadcastIntervalMs);
+    Serial.print(F("ms turnoff="));
+    Serial.print(values.collectorTurnOffDelayMs);
+    Serial.print(F("ms close="));
+    Serial.print(values.closeGateDelayMs);
+    Serial.print(F("ms branch="));
+    Serial.print(values.closeBranchGateDelayMs);
+    Serial.print(F("ms spinmin="));
+    Serial.print(values.spinDownMinS);
+    Serial.print(F("s spinmax="));
+    Serial.print(values.spinDownMaxS);
+    Serial.println(F("s"));
+}
@@ -0,0 +1,68 @@
+#ifndef config_h
+#define config_h
+
+#include <Arduino.h>
+#include "Constants.h"
+#include "RadioController.h"
+
+/**
+ * The tunables the dust collector can change on every node over the radio
+ * (see ConfigPush).  The consts in Constants.h and RadioController.h are
+ * only the defaults, used until a node has been sent something else.
+ *
+ * Laid out with no padding on avr-gcc.  Changing it changes what goes over
+ * the air, so bump CONFIG_LAYOUT and every node has to be reflashed.
+ */
+struct ConfigValues {
+    uint8_t version = 0;                   // Set by the dust collector, compared for equality only
+    uint8_t channel = CHANNEL;             // Where the network lives when nothing else has been saved
+    uint16_t activateAboveCentiamps = MIN_CURRENT_TO_ACTIVATE * 100;
+    uint16_t stayActiveAboveCentiamps = MIN_CURRENT_TO_STAY_ACTIVE * 100;
+    uint16_t onBroadcastIntervalMs = TIME_BETWEEN_ON_BROADCASTS;
+    uint32_t collectorTurnOffDelayMs = DUST_COLLECTOR_TURN_OFF_DELAY;
+    uint32_t closeGateDelayMs = CLOSE_GATE_DELAY;
+    uint32_t closeBranchGateDelayMs = CLOSE_BRANCH_GATE_DELAY;
+    uint16_t spinDownMinS = SPIN_DOWN_MIN_DELAY_S;  // Limits on the learned turn off delay (see SpinDown)
+    uint16_t spinDownMaxS = SPIN_DOWN_MAX_DELAY_S;
+    uint16_t crc = 0;                      // Over everything above, so a half sent block is never applied
+};
+
+const uint8_t CONFIG_LAYOUT = 2;
+const uint8_t CONFIG_SIZE = sizeof(ConfigValues);
+
+/**
+ * Called after a new block is applied, with the one it replaced.
+ */
+typedef void (*ConfigListener)(const ConfigValues &previous);
+
+/**
+ * The live configuration.  Loaded from EEPROM at boot and replaced whole, so
+ * nothing ever runs with half an old block and half a new one.
+ */
+class Config {
+    public:
+        void load();
+        const ConfigValues &get() const { return values; }
+        /**
+         * Replaces the live block if its CRC checks out, and saves it.
+         */
+        bool apply(const ConfigValues &values);
+        /**
+         * Changes one value by name, under a new version.  For the console on
+         * the dust collector.  False, and nothing changes, for an unknown
+         * name, a value that doesn't fit, off above on or spinmin above
+         * spinmax.
+         */
+        bool set(const char *name, unsigned long value);
+        void setListener(ConfigListener listener) { this->listener = listener; }
+        void report() const;
+
+        static uint16_t crcOf(const ConfigValues &values);
+    private:
+        ConfigValues values;
+        ConfigListener listener = NULL;
+};
+
+extern Config config;
+
+#endif
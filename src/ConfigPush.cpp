@@ -0,0 +1,184 @@
+#include "ConfigPush.h"
+
+void ConfigPush::push(bool moveChannel) {
+    for (uint8_t address = FIRST_NODE_ADDRESS; address < FIRST_NODE_ADDRESS + MAX_NODES; address++) {
+        if (leaseTable->isLeased(address)) {
+            uint8_t index = address - FIRST_NODE_ADDRESS;
+            unconfirmed[index / 8] |= 1 << (index % 8);
+        }
+    }
+    this->moveChannel = this->moveChannel || moveChannel;
+    chunksNeeded = CONFIG_ALL_CHUNKS;
+    startRounds();
+}
+
+void ConfigPush::onNodeJoined(uint8_t address) {
+    if (!LeaseTable::isNodeAddress(address)) {
+        return;
+    }
+    uint8_t index = address - FIRST_NODE_ADDRESS;
+    unconfirmed[index / 8] |= 1 << (index % 8);
+    // Just ask.  Chunks only go out if it says it is missing some.
+    startRounds();
+}
+
+void ConfigPush::startRounds() {
+    // Already going, the rounds in progress pick up the new work.
+    if (roundsLeft == 0) {
+        roundEndTime = VALUE_UNSET;
+        nextChunk = 0;
+    }
+    roundsLeft = CONFIG_MAX_ROUNDS;
+}
+
+void ConfigPush::onLoop() {
+    if (mode != DUST_COLLECTOR) {
+        if (replyTime != VALUE_UNSET && replyTime <= millis()) {
+            replyTime = VALUE_UNSET;
+            radioController.sendTo(DUST_COLLECTOR_ADDRESS, CONFIG_STATUS, ((unsigned long) replyVersion << 16) | chunksOf(replyVersion));
+        }
+        return;
+    }
+    if (roundsLeft == 0) {
+        return;
+    }
+    if (roundEndTime != VALUE_UNSET) {
+        if (roundEndTime > millis()) {
+            // Waiting on the answers.
+            return;
+        }
+        roundsLeft--;
+        if (roundsLeft == 0 || countUnconfirmed() == 0) {
+            finishPush();
+            return;
+        }
+        roundEndTime = VALUE_UNSET;
+        nextChunk = 0;
+    }
+    // One frame at a time, so we never overrun the CSMA queue.
+    if (!radioController.isSendQueueEmpty()) {
+        return;
+    }
+    while (nextChunk < CONFIG_CHUNK_COUNT && (chunksNeeded & (1 << nextChunk)) == 0) {
+        nextChunk++;
+    }
+    if (nextChunk < CONFIG_CHUNK_COUNT) {
+        sendChunk(nextChunk++);
+        return;
+    }
+    sendChunk(CONFIG_END_OF_ROUND);
+    chunksNeeded = 0;
+    nextChunk = 0;
+    roundEndTime = millis() + CONFIG_ROUND_MS;
+}
+
+void ConfigPush::sendChunk(uint8_t index) {
+    const uint8_t *bytes = (const uint8_t *) &config.get();
+    unsigned long data = ((unsigned long) config.get().version << 24) | ((unsigned long) index << 16);
+    if (index != CONFIG_END_OF_ROUND) {
+        for (uint8_t i = 0; i < CONFIG_CHUNK_BYTES && index * CONFIG_CHUNK_BYTES + i < CONFIG_SIZE; i++) {
+            data |= (unsigned long) bytes[index * CONFIG_CHUNK_BYTES + i] << (8 * i);
+        }
+    }
+    radioController.sendTo(ADDRESS_UNSET, CONFIG_CHUNK, data);
+}
+
+uint8_t ConfigPush::countUnconfirmed() const {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < MAX_NODES; i++) {
+        if (unconfirmed[i / 8] & (1 << (i % 8))) {
+            count++;
+        }
+    }
+    return count;
+}
+
+void ConfigPush::finishPush() {
+    roundsLeft = 0;
+    uint8_t missing = countUnconfirmed();
+    Serial.print(F("Config version "));
+    Serial.print(config.get().version);
+    if (missing == 0) {
+        Serial.println(F(" is on every node"));
+    } else {
+        Serial.print(F(" did not reach "));
+        Serial.print(missing);
+        Serial.println(F(" nodes.  They get it when they next say hello"));
+        // Don't keep asking nodes that are gone.
+        memset(unconfirmed, 0, sizeof(unconfirmed));
+    }
+    if (moveChannel && channelManager != NULL && config.get().channel != radioController.getChannel()) {
+        channelManager->announceSwitch(config.get().channel, radioController.getDataRate());
+    }
+    moveChannel = false;
+}
+
+void ConfigPush::onStatus(const Payload &payload) {
+    uint8_t version = payload.data >> 16;
+    uint16_t have = payload.data & 0xFFFF;
+    if (mode != DUST_COLLECTOR || version != config.get().version || !LeaseTable::isNodeAddress(payload.id)) {
+        return;
+    }
+    uint8_t index = payload.id - FIRST_NODE_ADDRESS;
+    if (have == CONFIG_ALL_CHUNKS) {
+        unconfirmed[index / 8] &= ~(1 << (index % 8));
+    } else {
+        chunksNeeded |= ~have & CONFIG_ALL_CHUNKS;
+    }
+}
+
+uint16_t ConfigPush::chunksOf(uint8_t version) const {
+    if (version == config.get().version) {
+        return CONFIG_ALL_CHUNKS;
+    }
+    return version == stagedVersion ? stagedChunks : 0;
+}
+
+void ConfigPush::onChunk(const Payload &payload) {
+    if (mode == DUST_COLLECTOR || payload.id != DUST_COLLECTOR_ADDRESS) {
+        return;
+    }
+    uint8_t version = payload.data >> 24;
+    uint8_t index = (payload.data >> 16) & 0xFF;
+    if (index == CONFIG_END_OF_ROUND) {
+        replyVersion = version;
+        replyTime = millis() + random(CONFIG_REPLY_SPREAD_MS);
+        return;
+    }
+    if (version == config.get().version || index >= CONFIG_CHUNK_COUNT) {
+        return;
+    }
+    if (version != stagedVersion) {
+        stagedVersion = version;
+        stagedChunks = 0;
+    }
+    uint8_t *bytes = (uint8_t *) &staged;
+    for (uint8_t i = 0; i < CONFIG_CHUNK_BYTES && index * CONFIG_CHUNK_BYTES + i < CONFIG_SIZE; i++) {
+        bytes[index * CONFIG_CHUNK_BYTES + i] = payload.data >> (8 * i);
+    }
+    stagedChunks |= 1 << index;
+    if (stagedChunks == CONFIG_ALL_CHUNKS) {
+        // Either it's whole and goes live all at once, or it was mixed up
+        // somehow and we start over.
+        if (staged.version != version || !config.apply(staged)) {
+            Serial.println(F("Config failed its CRC.  Waiting for it again"));
+        }
+        stagedChunks = 0;
+    }
+}
+
+void ConfigPush::report() const {
+    if (mode == DUST_COLLECTOR) {
+        Serial.print(F("Pushing: "));
+        Serial.print(roundsLeft > 0);
+        Serial.print(F(" rounds left: "));
+        Serial.print(roundsLeft);
+        Serial.print(F(" nodes to confirm: "));
+        Serial.println(countUnconfirmed());
+    } else {
+        Serial.print(F("Staged version: "));
+        Serial.print(stagedVersion);
+        Serial.print(F(" chunks: "));
+        Serial.println(stagedChunks, BIN);
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef config_push_h
+#define config_push_h
+
+#include <Arduino.h>
+#include "Config.h"
+#include "RadioController.h"
+#include "LeaseTable.h"
+#include "ChannelManager.h"
+
+/**
+ * Each CONFIG_CHUNK carries this many bytes of the block.
+ */
+const uint8_t CONFIG_CHUNK_BYTES = 2;
+const uint8_t CONFIG_CHUNK_COUNT = (CONFIG_SIZE + CONFIG_CHUNK_BYTES - 1) / CONFIG_CHUNK_BYTES;
+const uint16_t CONFIG_ALL_CHUNKS = (1UL << CONFIG_CHUNK_COUNT) - 1;
+static_assert(CONFIG_CHUNK_COUNT <= 15, "Config chunk masks are 16 bits, less the end of round marker");
+
+/**
+ * The chunk index that ends a round and asks every node what it is missing.
+ */
+const uint8_t CONFIG_END_OF_ROUND = 0xFF;
+
+/**
+ * Nodes answer the end of a round after a random wait up to this long, so a
+ * shop's worth of answers don't all go out at once.  The collector waits a
+ * little longer than that before starting the next round.
+ */
+const unsigned long CONFIG_REPLY_SPREAD_MS = 400;
+const unsigned long CONFIG_ROUND_MS = CONFIG_REPLY_SPREAD_MS + 200;
+const uint8_t CONFIG_MAX_ROUNDS = 10;
+
+/**
+ * Hands out the dust collector's config to every node.
+ *
+ * The collector broadcasts the block in CONFIG_CHUNKs (data is version << 24
+ * | index << 16 | two bytes), then an end of round marker.  Each node answers
+ * that with a CONFIG_STATUS (data is version << 16 | chunks it has).  The
+ * next round only sends the chunks somebody is still missing, until every
+ * leased node has the block or we run out of rounds.  A node applies the
+ * block once it has every chunk of one version and the CRC checks out.
+ *
+ * Nodes that join later (or the whole shop after the collector reboots) get
+ * asked in a round of their own, which costs nothing if they are up to date.
+ */
+class ConfigPush {
+    public:
+        ConfigPush(RadioController &radioController, LeaseTable *leaseTable, ChannelManager *channelManager)
+                : radioController(radioController), leaseTable(leaseTable), channelManager(channelManager) {};
+        void onLoop();
+        /**
+         * From the dust collector: sends the current config to everyone.  With
+         * moveChannel, moves the network to its channel once they all have it.
+         */
+        void push(bool moveChannel);
+        /**
+         * From the dust collector: makes sure this node has the current config.
+         */
+        void onNodeJoined(uint8_t address);
+        void onChunk(const Payload &payload);
+        void onStatus(const Payload &payload);
+        /**
+         * Nothing to send, so it's ok to sleep.
+         */
+        bool isIdle() const { return roundsLeft == 0 && replyTime == VALUE_UNSET; }
+        void report() const;
+    private:
+        RadioController &radioController;
+        LeaseTable *leaseTable;
+        ChannelManager *channelManager;
+
+        // Dust collector
+        uint8_t unconfirmed[(MAX_NODES + 7) / 8] = {0};
+        uint16_t chunksNeeded = 0;
+        uint8_t roundsLeft = 0;
+        uint8_t nextChunk = 0;
+        unsigned long roundEndTime = VALUE_UNSET;
+        bool moveChannel = false;
+        void startRounds();
+        void sendChunk(uint8_t index);
+        uint8_t countUnconfirmed() const;
+        void finishPush();
+
+        // Nodes
+        ConfigValues staged;
+        uint8_t stagedVersion = 0;
+        uint16_t stagedChunks = 0;
+        uint8_t replyVersion = 0;
+        unsigned long replyTime = VALUE_UNSET;
+        uint16_t chunksOf(uint8_t version) const;
+};
+
+#endif
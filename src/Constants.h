@@ -2,32 +2,208 @@
 #define Constants_h
 #include <Arduino.h>
 #include <RF24.h>
+#include "Capacity.h"
 
 enum Mode {
   MACHINE,
   DUST_COLLECTOR,
-  BRANCH_GATE
+  BRANCH_GATE,
+  GATEWAY,
+  AUX_COLLECTOR
 };
 
-// const Mode mode = MACHINE;
-// const Mode mode = BRANCH_GATE;
-const Mode mode = DUST_COLLECTOR;
+/**
+ * Each role is a policy type so that a build only compiles in the code its
+ * role needs (the dust collector doesn't carry the servo, machines don't
+ * carry the lease table).  The per-role environments in platformio.ini pick
+ * one with -DROLE_MACHINE, -DROLE_BRANCH_GATE, -DROLE_DUST_COLLECTOR,
+ * -DROLE_AUX_COLLECTOR or -DROLE_GATEWAY.  Otherwise the default below is
+ * used.
+ */
+struct MachineRole {
+  static const Mode mode = MACHINE;
+  static const bool hasGate = true;
+  static const bool sensesCurrent = true;
+  static const bool transmits = true;
+};
+
+struct BranchGateRole {
+  static const Mode mode = BRANCH_GATE;
+  static const bool hasGate = true;
+  static const bool sensesCurrent = false;
+  static const bool transmits = true;
+};
+
+struct DustCollectorRole {
+  static const Mode mode = DUST_COLLECTOR;
+  static const bool hasGate = false;
+  static const bool sensesCurrent = false;
+  static const bool transmits = true;
+};
+
+/**
+ * Listens to everything and passes it up the USB serial to a host (see
+ * Gateway.h and tools/gateway_daemon.py).  Never transmits or ACKs, so the
+ * network works the same with or without it.
+ */
+struct GatewayRole {
+  static const Mode mode = GATEWAY;
+  static const bool hasGate = false;
+  static const bool sensesCurrent = false;
+  static const bool transmits = false;
+};
+
+/**
+ * Another dust collector.  Leases an address like any node and runs when the
+ * dust collector assigns it (see CollectorGroup).  The branches its ducting
+ * reaches are its gate code switches, all off for every branch.
+ */
+struct AuxCollectorRole {
+  static const Mode mode = AUX_COLLECTOR;
+  static const bool hasGate = false;
+  static const bool sensesCurrent = false;
+  static const bool transmits = true;
+};
+
+#if defined(ROLE_MACHINE)
+typedef MachineRole Role;
+#elif defined(ROLE_BRANCH_GATE)
+typedef BranchGateRole Role;
+#elif defined(ROLE_DUST_COLLECTOR)
+typedef DustCollectorRole Role;
+#elif defined(ROLE_GATEWAY)
+typedef GatewayRole Role;
+#elif defined(ROLE_AUX_COLLECTOR)
+typedef AuxCollectorRole Role;
+#else
+// typedef MachineRole Role;
+// typedef BranchGateRole Role;
+typedef DustCollectorRole Role;
+#endif
+
+const Mode mode = Role::mode;
+
+/**
+ * Sleep between events (see PowerManager).  Branch gates are the ones that
+ * end up far from power.  Needs the radio IRQ wired to WIRELESS_IRQ_PIN.
+ */
+const bool LOW_POWER_IDLE = mode == BRANCH_GATE;
+
+/**
+ * The gateway's serial carries frames, so it runs fast and doesn't print a
+ * line for every frame.
+ */
+const unsigned long SERIAL_BAUD = mode == GATEWAY ? 500000 : 9600;
+const bool LOG_FRAMES = mode != GATEWAY;
 
 // const bool MODE_VIA_PIN = true; // NON-DEBUG = false
 
 const bool closeGateWhenNotInUse = true;
 
+/**
+ * Set from the serial console to hold a gate open/closed or the dust
+ * collector on/off no matter what the machines are doing.
+ */
+enum Override {
+  OVERRIDE_AUTO,
+  OVERRIDE_ON,
+  OVERRIDE_OFF
+};
+
 const bool SERIAL_CALIBRATION = false;
 
+/**
+ * How many gates this node drives.  They all open and close together, for
+ * machines with more than one dust port.  There is only one pair of pots, so
+ * more than one gate needs SERIAL_CALIBRATION.
+ */
+const uint8_t GATE_COUNT = 1;
+static_assert(GATE_COUNT == 1 || SERIAL_CALIBRATION, "Multiple gates are calibrated over serial");
+
+/**
+ * A switch on the current sensor pin instead of a real sensor, for the
+ * bench.  The native tests (-DNATIVE_BUILD, see platformio.ini) feed the
+ * real sensor path recorded traces, so it's always off there.
+ */
+#if defined(NATIVE_BUILD)
+const bool USE_FAKE_CURRENT = false;
+#else
 const bool USE_FAKE_CURRENT = true; // NON-DEBUG = false
+#endif
 const bool FAKE_CURRENT_DEFAULT_ON = true;
 
 const bool SLOW_DOWN_LOOP = false; // NON-DEBUG = false
 
+/**
+ * Time the hot paths and print a report over serial every minute.
+ */
+const bool PROFILE_HOT_PATHS = false;
+
+/**
+ * Print every frame heard or sent as "@<millis> R|T <payload hex>" so a shop
+ * log can be replayed later (tools/replay_traffic.py).
+ */
+const bool RECORD_TRAFFIC = false;
+/**
+ * Replay bench.  Frames come only from the console's "rx" command (or
+ * RadioController::inject) and nothing goes on air.  "tick" moves millis()
+ * forward so a week of traffic doesn't take a week, and servo moves don't
+ * wait.  On in the native_replay environments, for test/test_replay.
+ */
+#if defined(TRAFFIC_REPLAY_BUILD)
+const bool TRAFFIC_REPLAY = true;
+#else
+const bool TRAFFIC_REPLAY = false; // NON-DEBUG = false
+#endif
+/**
+ * Lets the console's "fault" command drop, corrupt and delay frames, knock
+ * the radio over, add ADC noise and stall the servos (see FaultInjector).
+ * Always on in the native build, for the soak test.
+ */
+#if defined(NATIVE_BUILD)
+const bool FAULT_INJECTION = true;
+#else
+const bool FAULT_INJECTION = false; // NON-DEBUG = false
+#endif
+
+/**
+ * Save the gate state, calibration and dust collector state to EEPROM, and
+ * restore them on boot instead of re-sampling everything and waiting for the
+ * radio.  Gets us back to work quickly after a short power dip.
+ */
+const bool WARM_START = true;
+
 // const unsigned long DELAY_BETWEEN_SERVO_STEPS_MS = 10; // DO NOT PUSH
 const unsigned long DELAY_BETWEEN_SERVO_STEPS_MS = 5;
 
-const double MIN_CURRENT_TO_ACTIVATE = 2.0;
+/**
+ * Servos are detached this long after they get where they are going, so they
+ * stop buzzing and drawing current from the rail the radio shares.  0 holds
+ * them forever.  Every SERVO_RESEAT_INTERVAL_MS they get SERVO_RESEAT_PULSE_MS
+ * of pulses to push a gate that has crept back into place (0 turns it off).
+ */
+const unsigned long SERVO_HOLD_MS = 1000;
+const unsigned long SERVO_RESEAT_INTERVAL_MS = 10L * 60L * 1000L;
+const unsigned long SERVO_RESEAT_PULSE_MS = 300;
+/**
+ * Also switch the servo supply on SERVO_POWER_PIN, for boards wired with a
+ * transistor there.  Some servos hold their last position when detached but
+ * still draw current.
+ */
+const bool SERVO_POWER_SWITCH = false;
+const unsigned long SERVO_POWER_UP_MS = 20;
+
+const unsigned long MAINS_HZ = 60;
+
+/**
+ * Current above the idle baseline (see CurrentDetector) needed to count the
+ * machine as on, and the current it has to drop below to count as off again.
+ *
+ * These and the delays below are only defaults.  The dust collector can push
+ * new values to every node (see Config).
+ */
+const double MIN_CURRENT_TO_ACTIVATE = 1.0;
+const double MIN_CURRENT_TO_STAY_ACTIVE = 0.5;
 
 const unsigned long TIME_BETWEEN_ON_BROADCASTS = 1000;
 
@@ -37,6 +213,41 @@ const unsigned long TIME_BETWEEN_ON_BROADCASTS = 1000;
  */
 const unsigned long DUST_COLLECTOR_TURN_OFF_DELAY = 10000;
 
+/**
+ * The dust collector learns how long to run on after the last cut (see
+ * SpinDown), somewhere between these.  Until it has learned anything it uses
+ * DUST_COLLECTOR_TURN_OFF_DELAY.
+ */
+const bool LEARN_SPIN_DOWN = true;
+const unsigned int SPIN_DOWN_MIN_DELAY_S = 5;
+const unsigned int SPIN_DOWN_MAX_DELAY_S = 300;
+
+/**
+ * Machines tell idle spinning from cutting (see LoadClassifier) and say which
+ * in every RUNNING.  The dust collector only starts for cutting, and stops
+ * once every machine has only been spinning for IDLE_SPIN_TURN_OFF_DELAY
+ * (or the learned delay, with LEARN_SPIN_DOWN).
+ * Nodes that can't tell send LOAD_UNKNOWN, which counts as cutting.
+ */
+const bool LOAD_CLASSIFICATION = true;
+const unsigned long IDLE_SPIN_TURN_OFF_DELAY = 30000;
+
+/**
+ * Share the work between the dust collector and any aux collectors by
+ * airflow, in units of 10 CFM.  Each collector says what it moves, each
+ * machine what it needs while running, and the dust collector runs the
+ * smallest set that covers it (see CollectorGroup).
+ */
+const bool MULTIPLE_COLLECTORS = true;
+const uint8_t COLLECTOR_CAPACITY = 120;
+const uint8_t MACHINE_DEMAND = 40;
+
+enum LoadState : uint8_t {
+    LOAD_UNKNOWN,
+    LOAD_IDLE,
+    LOAD_CUTTING,
+};
+
 const unsigned long DUST_COLLECTOR_ON_DELAY_BRANCH = 500;
 /**
  * If we are closing the gate when not in use, this is the 
@@ -54,6 +265,19 @@ const unsigned long TIME_TO_CALIBRATE_MS = 7000;
 
 const unsigned long DUST_COLLECTOR_ID = 123321;
 
+/**
+ * Nodes renew their short address lease with a HEARTBEAT this often.  Until
+ * they have a lease, they keep asking with HELLO_WORLD.
+ */
+const unsigned long LEASE_RENEW_INTERVAL_MS = 5L * 60L * 1000L;
+const unsigned long LEASE_REQUEST_RETRY_MS = 5000;
+
+/**
+ * Nodes wait a random time up to this long before their first HELLO_WORLD so
+ * that a whole shop powering up at once doesn't all talk at the same time.
+ */
+const unsigned long HELLO_STAGGER_MS = 2000;
+
 const unsigned long VALUE_UNSET = 0;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,126 @@
+#include "CurrentDetector.h"
+#include "GatePins.h"
+#include "Profiler.h"
+#include "Faults.h"
+
+void CurrentDetector::setup() {
+    if (USE_FAKE_CURRENT) {
+        pinMode(CURRENT_SENSOR_PIN, INPUT_PULLUP);  
+    } else {
+        pinMode(CURRENT_SENSOR_PIN, INPUT);
+    }
+}
+
+void CurrentDetector::onLoop() {
+    amps = readAmps();
+    if (!baselineSet) {
+        idleBaseline = min(amps, MAX_IDLE_BASELINE);
+        baselineSet = true;
+    }
+
+    if (!running) {
+        double above = amps - idleBaseline;
+        if (above >= INRUSH_CURRENT_ABOVE_IDLE) {
+            running = true;
+            // It started somewhere in the reading we just took.
+            onsetTime = (crossedTime == VALUE_UNSET ? millis() : crossedTime) - CURRENT_WINDOW_MS;
+            crossedTime = VALUE_UNSET;
+        } else if (above >= activateAbove) {
+            if (crossedTime == VALUE_UNSET) {
+                crossedTime = millis();
+            } else if ((crossedTime + CURRENT_ON_HOLD_MS) <= millis()) {
+                running = true;
+                onsetTime = crossedTime - CURRENT_WINDOW_MS;
+                crossedTime = VALUE_UNSET;
+            }
+        } else {
+            crossedTime = VALUE_UNSET;
+            idleBaseline += (amps - idleBaseline) * IDLE_BASELINE_SMOOTHING;
+            idleBaseline = min(idleBaseline, MAX_IDLE_BASELINE);
+        }
+    } else {
+        if ((amps - idleBaseline) < stayActiveAbove) {
+            if (crossedTime == VALUE_UNSET) {
+                crossedTime = millis();
+            } else if ((crossedTime + CURRENT_OFF_HOLD_MS) <= millis()) {
+                running = false;
+                crossedTime = VALUE_UNSET;
+            }
+        } else {
+            crossedTime = VALUE_UNSET;
+        }
+    }
+    if (LOAD_CLASSIFICATION && !USE_FAKE_CURRENT) {
+        loadClassifier.endCycle(running);
+    }
+}
+
+void CurrentDetector::setThresholds(double activateAbove, double stayActiveAbove) {
+    this->activateAbove = activateAbove;
+    this->stayActiveAbove = min(stayActiveAbove, activateAbove);
+}
+
+// Derived from: https://arduino.stackexchange.com/questions/19301/acs712-sensor-reading-for-ac-current
+double CurrentDetector::readAmps() {
+  ScopedProbe probe(PROBE_CURRENT);
+  if (USE_FAKE_CURRENT) {
+    bool isHigh = analogRead(CURRENT_SENSOR_PIN) > 512;
+    double onCurrent = activateAbove + 5;
+    if (FAKE_CURRENT_DEFAULT_ON) {
+      if (isHigh) {
+        return onCurrent;
+      } else {
+        return 0;
+      }
+    } else {
+      if (isHigh) {
+        return 0;
+      } else {
+        return onCurrent;
+      }
+    }
+  }
+
+  int rVal = 0;
+  int maxVal = 0;
+  int minVal = 1023;
+
+  // take evenly spaced samples for one mains cycle
+  loadClassifier.startCycle();
+  unsigned long nextSample = micros();
+  for (uint8_t i = 0; i < LOAD_SAMPLES_PER_CYCLE; i++)
+  {
+    while ((long) (micros() - nextSample) < 0) {
+    }
+    nextSample += LOAD_SAMPLE_INTERVAL_US;
+    rVal = analogRead(CURRENT_SENSOR_PIN);
+    if (FAULT_INJECTION) {
+      rVal = faults->adc(rVal);
+    }
+    if (rVal > maxVal)
+      maxVal = rVal;
+
+    if (rVal < minVal)
+      minVal = rVal;
+    if (LOAD_CLASSIFICATION) {
+      loadClassifier.addSample(rVal);
+    }
+  }
+
+  // Subtract min from max to determine the peak to peak range
+  // 1023 = the max value we'll get on the input (1024, zero indexed)
+  // 5.0 = 5v total on adc input
+  double volt = ((maxVal - minVal) * (5.0 / 1023.0));
+
+  // div by 2 is to calculate RMS from peak to peak
+  // 0.35355 is factor to calculate RMS from peak to peak
+  // see http://www.learningaboutelectronics.com/Articles/Voltage-rms-calculator.php
+  double voltRMS = volt * 0.35355;
+
+  // x 1000 to convert volts to millivolts
+  // divide by the number of millivolts per amp to determine amps measured
+  // the 20A module 100 mv/A (so in this case ampsRMS = voltRMS
+  double ampsRMS = (voltRMS * 1000) / 66;
+
+  return ampsRMS;
+}
@@ -0,0 +1,78 @@
+#ifndef current_detector_h
+#define current_detector_h
+
+#include <Arduino.h>
+#include "Constants.h"
+#include "LoadClassifier.h"
+
+/**
+ * Each reading covers one mains cycle, so a start is seen within a cycle or
+ * two instead of after a 100ms window.  The samples are evenly spaced across
+ * it for the LoadClassifier.
+ */
+const unsigned long CURRENT_WINDOW_MS = 1000 / MAINS_HZ + 1;
+
+/**
+ * A single cycle this far above idle is a motor inrush.  We trust it right
+ * away instead of waiting out CURRENT_ON_HOLD_MS.
+ */
+const double INRUSH_CURRENT_ABOVE_IDLE = 4.0;
+
+/**
+ * How long the current has to stay past the on/off thresholds before we
+ * believe it.  Keeps us from flapping near the edge.
+ */
+const unsigned long CURRENT_ON_HOLD_MS = 50;
+const unsigned long CURRENT_OFF_HOLD_MS = 500;
+
+/**
+ * The idle baseline follows the sensor's resting reading (offset, noise,
+ * a wall wart left plugged in) but never past this.
+ */
+const double MAX_IDLE_BASELINE = 1.5;
+const double IDLE_BASELINE_SMOOTHING = 1.0 / 32;
+
+/**
+ * Decides whether the machine is running from the current sensor.  Thresholds
+ * are relative to a self-calibrating idle baseline, with separate on and off
+ * levels and hold times.
+ */
+class CurrentDetector {
+    public:
+        void setup();
+        /**
+         * Takes one reading.  Blocks for one mains cycle.
+         */
+        void onLoop();
+        bool isRunning() const { return running; }
+        /**
+         * When the current that made us decide it is running started.
+         */
+        unsigned long getOnsetTime() const { return onsetTime; }
+        double getAmps() const { return amps; }
+        double getIdleBaseline() const { return idleBaseline; }
+        /**
+         * Whether it is cutting or just spinning.  LOAD_UNKNOWN when not
+         * running, while it spins up, and with fake current.
+         */
+        LoadState getLoad() const { return loadClassifier.getState(); }
+        const LoadClassifier &getLoadClassifier() const { return loadClassifier; }
+        void setThresholds(double activateAbove, double stayActiveAbove);
+        double getActivateAbove() const { return activateAbove; }
+        double getStayActiveAbove() const { return stayActiveAbove; }
+    private:
+        double activateAbove = MIN_CURRENT_TO_ACTIVATE;
+        double stayActiveAbove = MIN_CURRENT_TO_STAY_ACTIVE;
+        bool running = false;
+        double amps = 0;
+        double idleBaseline = 0;
+        bool baselineSet = false;
+        // When the reading first crossed the threshold we are waiting on.
+        unsigned long crossedTime = VALUE_UNSET;
+        unsigned long onsetTime = VALUE_UNSET;
+        LoadClassifier loadClassifier;
+
+        double readAmps();
+};
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef eeprom_layout_h
+#define eeprom_layout_h
+
+#include "Telemetry.h"
+
+/**
+ * Fixed EEPROM addresses for everything we persist.  The ATmega328 only has
+ * 1KB of EEPROM, so keep these non-overlapping and leave a little room for
+ * each block to grow.
+ */
+const int EEPROM_GATE_POSITIONS_ADDRESS = 0; // One GatePositions per gate
+const int EEPROM_WARM_START_ADDRESS = 16;
+const int EEPROM_LEASE_ADDRESS = 32;
+const int EEPROM_TELEMETRY_ADDRESS = 64; // Through 265
+const int EEPROM_CHANNEL_ADDRESS = 272;
+const int EEPROM_CONFIG_ADDRESS = 280; // Through 305
+const int EEPROM_SPIN_DOWN_ADDRESS = 306; // Through 626: one histogram per node address
+const int EEPROM_RESETS_ADDRESS = 627; // Through 636
+
+static_assert(EEPROM_TELEMETRY_ADDRESS + sizeof(TelemetryCheckpoint) + TELEMETRY_BUFFER_SIZE <= EEPROM_CHANNEL_ADDRESS,
+    "The telemetry checkpoint and ring run into the channel");
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef fast_pin_h
+#define fast_pin_h
+
+#include <Arduino.h>
+
+/**
+ * A pin from GatePins.h, resolved to its port and bit at compile time, so a
+ * read or write is a single instruction instead of digitalRead()/digitalWrite()
+ * looking the pin up in flash tables every call.  ATmega328 numbering: 0-7 are
+ * port D, 8-13 port B and A0-A5 (14-19) port C.
+ */
+template <uint8_t PIN>
+struct FastPin {
+    static_assert(PIN < 20, "Not an ATmega328 pin");
+
+    static const uint8_t bit = PIN < 8 ? PIN : PIN < 14 ? PIN - 8 : PIN - 14;
+    static const uint8_t mask = 1 << bit;
+
+    static volatile uint8_t &port() { return PIN < 8 ? PORTD : PIN < 14 ? PORTB : PORTC; }
+    static volatile uint8_t &input() { return PIN < 8 ? PIND : PIN < 14 ? PINB : PINC; }
+    static volatile uint8_t &direction() { return PIN < 8 ? DDRD : PIN < 14 ? DDRB : DDRC; }
+
+    static void setOutput() { direction() |= mask; }
+    static void setInputPullup() {
+        direction() &= ~mask;
+        port() |= mask;
+    }
+    static void write(bool high) {
+        if (high) {
+            port() |= mask;
+        } else {
+            port() &= ~mask;
+        }
+    }
+    static bool read() { return input() & mask; }
+};
+
+/**
+ * An LED that remembers what it last showed and only touches the port when
+ * that changes.
+ */
+template <uint8_t PIN>
+class Led {
+    public:
+        void setup(bool on) {
+            FastPin<PIN>::setOutput();
+            this->on = on;
+            FastPin<PIN>::write(on);
+        }
+        void set(bool on) {
+            if (on != this->on) {
+                this->on = on;
+                FastPin<PIN>::write(on);
+            }
+        }
+        bool isOn() const { return on; }
+    private:
+        bool on = false;
+};
+
+#endif
@@ -0,0 +1,73 @@
+#include "Faults.h"
+
+const char FAULT_NAMES[FAULT_COUNT][11] PROGMEM = {
+    "droprx",
+    "corruptrx",
+    "delayrx",
+    "droptx",
+    "adcnoise",
+    "servostall",
+};
+
+bool FaultInjector::set(const char *name, unsigned int level) {
+    for (uint8_t i = 0; i < FAULT_COUNT; i++) {
+        if (strcmp_P(name, FAULT_NAMES[i]) == 0) {
+            levels[i] = level;
+            return true;
+        }
+    }
+    return false;
+}
+
+void FaultInjector::clear() {
+    memset(levels, 0, sizeof(levels));
+}
+
+void FaultInjector::flipBit(void *bytes, uint8_t size) const {
+    uint8_t bit = random(size * 8);
+    ((uint8_t *) bytes)[bit / 8] ^= 1 << (bit % 8);
+}
+
+void FaultInjector::onRadioHealthy() {
+    if (radioFaultTime == VALUE_UNSET) {
+        return;
+    }
+    lastRecoveryMs = millis() - radioFaultTime;
+    worstRecoveryMs = max(worstRecoveryMs, lastRecoveryMs);
+    recoveries++;
+    radioFaultTime = VALUE_UNSET;
+    Serial.print(F("Radio recovered after "));
+    Serial.print(lastRecoveryMs);
+    Serial.println(F("ms"));
+}
+
+void FaultInjector::onLoopDone(unsigned long ms) {
+    worstLoopMs = max(worstLoopMs, ms);
+    if (ms > LOOP_BUDGET_MS) {
+        loopsOverBudget++;
+        Serial.print(F("Loop took "));
+        Serial.print(ms);
+        Serial.println(F("ms"));
+    }
+}
+
+void FaultInjector::report() const {
+    for (uint8_t i = 0; i < FAULT_COUNT; i++) {
+        Serial.print(F("Fault "));
+        Serial.print((const __FlashStringHelper *) FAULT_NAMES[i]);
+        Serial.print(F(": "));
+        Serial.println(levels[i]);
+    }
+    Serial.print(F("Radio recoveries: "));
+    Serial.print(recoveries);
+    Serial.print(F(" last: "));
+    Serial.print(lastRecoveryMs);
+    Serial.print(F("ms worst: "));
+    Serial.print(worstRecoveryMs);
+    Serial.print(F("ms pending: "));
+    Serial.println(radioFaultTime != VALUE_UNSET);
+    Serial.print(F("Loop worst: "));
+    Serial.print(worstLoopMs);
+    Serial.print(F("ms over budget: "));
+    Serial.println(loopsOverBudget);
+}
@@ -0,0 +1,85 @@
+#ifndef faults_h
+#define faults_h
+
+#include <Arduino.h>
+#include "Constants.h"
+
+/**
+ * The longest a loop should ever take.  A full servo sweep is 180 steps of
+ * DELAY_BETWEEN_SERVO_STEPS_MS, and the watchdog bites at 4s.
+ */
+const unsigned long LOOP_BUDGET_MS = 1500;
+
+/**
+ * Faults that stay on until cleared.  Each is a level set from the console.
+ */
+enum Fault {
+    FAULT_DROP_RX,      // % of frames heard that are thrown away
+    FAULT_CORRUPT_RX,   // % of frames heard with one bit flipped
+    FAULT_DELAY_RX,     // ms a frame heard is held back.  The radio's FIFO waits behind it
+    FAULT_DROP_TX,      // % of frames sent that never go on air, as if nobody ACKed
+    FAULT_ADC_NOISE,    // Up to this many counts added to or taken from every pot and current reading
+    FAULT_SERVO_STALL,  // Not 0 and the servos don't follow what we write
+    FAULT_COUNT
+};
+
+/**
+ * Breaks things on purpose, on the device, so the failure paths can be
+ * exercised on the bench: radioFailed() and re-init, ACK timeouts, blank
+ * frames, pot noise in calibrate() and a stuck servo.  Driven from the
+ * console's "fault" command, so a script can run a soak
+ * (tools/fault_soak.py, or test/test_fault_soak on the host).  It also keeps what a soak checks: how long the
+ * radio took to come back after each radio fault, and the slowest loop
+ * against LOOP_BUDGET_MS.
+ *
+ * Only built with FAULT_INJECTION, so it takes no SRAM otherwise.
+ */
+class FaultInjector {
+    public:
+        /**
+         * Returns false for a name that isn't one of the faults.
+         */
+        bool set(const char *name, unsigned int level);
+        void clear();
+        unsigned int get(Fault fault) const { return FAULT_INJECTION ? levels[fault] : 0; }
+        /**
+         * Whether to apply a percentage fault this time.
+         */
+        bool roll(Fault fault) const { return get(fault) > 0 && (unsigned int) random(100) < get(fault); }
+        void flipBit(void *bytes, uint8_t size) const;
+        int adc(int reading) const {
+            int noise = get(FAULT_ADC_NOISE);
+            return noise == 0 ? reading : constrain(reading + (int) random(-noise, noise + 1), 0, 1023);
+        }
+        /**
+         * The radio was just knocked over, and is fine again.
+         */
+        void onRadioFault() { radioFaultTime = millis(); }
+        void onRadioHealthy();
+        void onLoopDone(unsigned long ms);
+        void report() const;
+        /**
+         * What a soak checks at the end.  Pending means the radio never came
+         * back from the last fault.
+         */
+        unsigned int getRecoveries() const { return recoveries; }
+        unsigned long getWorstRecoveryMs() const { return worstRecoveryMs; }
+        bool isRecoveryPending() const { return radioFaultTime != VALUE_UNSET; }
+        unsigned long getWorstLoopMs() const { return worstLoopMs; }
+        unsigned int getLoopsOverBudget() const { return loopsOverBudget; }
+    private:
+        unsigned int levels[FAULT_COUNT] = {0};
+        unsigned long radioFaultTime = VALUE_UNSET;
+        unsigned int recoveries = 0;
+        unsigned long lastRecoveryMs = 0;
+        unsigned long worstRecoveryMs = 0;
+        unsigned long worstLoopMs = 0;
+        unsigned int loopsOverBudget = 0;
+};
+
+/**
+ * Only built with FAULT_INJECTION.  Check it before using this.
+ */
+extern FaultInjector *const faults;
+
+#endif
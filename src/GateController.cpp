@@ -1,6 +1,10 @@
 #include "GateController.h"
 #include "Constants.h"
 #include "GatePins.h"
+#include "EepromLayout.h"
+#include "Profiler.h"
+#include "Faults.h"
+#include "Clock.h"
 #include <EEPROM.h>
 
 
@@ -17,40 +21,117 @@ const int IN_CALIBRATION_ANALOG_FLOAT_AMOUNT = map(1, 0, MAX_ROTATION, 0, ANLOG_
 // const bool USE_POWER_PIN = false;
 const unsigned long ANALOG_READ_SAMPLE_DURATION_MS = 100;
 
+/**
+ * Gives the servos time to move.  When replaying traffic the clock just
+ * jumps, so a replay isn't held up by gates that aren't there.
+ */
+void waitForServos(unsigned long ms) {
+    if (TRAFFIC_REPLAY) {
+        advanceMillis(ms);
+    } else {
+        delay(ms);
+    }
+}
+
 int averageAnalogRead(int pin) {
     unsigned long numReads = 0;
     unsigned long total = 0;
     unsigned long endReadTime = millis() + ANALOG_READ_SAMPLE_DURATION_MS;
     while (millis() < endReadTime) {
         numReads++;
-        total += analogRead(pin);
+        int reading = analogRead(pin);
+        total += FAULT_INJECTION ? faults->adc(reading) : reading;
     }
     return total / numReads;
 }
 
-void GateController::setup() {
-    if (mode == DUST_COLLECTOR) {
-        return;
+void GateController::setup(const WarmStartState *warmState) {
+    for (uint8_t i = 0; i < GATE_COUNT; i++) {
+        gates[i].state = warmState != NULL && (warmState->openGates & (1 << i)) ? OPEN : CLOSED;
     }
-    
-    currentGateState = CLOSED;
     if (SERIAL_CALIBRATION) {
-        EEPROM.get(0, gatePositions);
-        Serial.print("Loaded gate positions from memory: open=");
-        Serial.print(gatePositions.openPosition);
-        Serial.print(" closed=");
-        Serial.println(gatePositions.closedPosition);
+        for (uint8_t i = 0; i < GATE_COUNT; i++) {
+            EEPROM.get(EEPROM_GATE_POSITIONS_ADDRESS + i * sizeof(GatePositions), gates[i].positions);
+            Serial.print(F("Loaded gate "));
+            Serial.print(i);
+            Serial.print(F(" positions from memory: open="));
+            Serial.print(gates[i].positions.openPosition);
+            Serial.print(F(" closed="));
+            Serial.println(gates[i].positions.closedPosition);
+        }
     } else {
         pinMode(OPEN_POT_PIN, INPUT);
         pinMode(CLOSED_POT_PIN, INPUT);
 
-        lastOpenPinAnalogReading = averageAnalogRead(OPEN_POT_PIN);
-        lastClosedPinAnalogReading = averageAnalogRead(CLOSED_POT_PIN);
+        if (warmState != NULL) {
+            // The pots are still checked every loop, so if they moved while we
+            // were off we will pick that up as a normal calibration.
+            lastOpenPinAnalogReading = warmState->openReading;
+            lastClosedPinAnalogReading = warmState->closedReading;
+        } else {
+            lastOpenPinAnalogReading = averageAnalogRead(OPEN_POT_PIN);
+            lastClosedPinAnalogReading = averageAnalogRead(CLOSED_POT_PIN);
+        }
+    }
+    if (SERVO_POWER_SWITCH) {
+        pinMode(SERVO_POWER_PIN, OUTPUT);
+    }
+    for (uint8_t i = 0; i < GATE_COUNT; i++) {
+        gates[i].currentServoPosition = targetPosition(i);
+    }
+    attachServos();
+    detachTime = millis() + SERVO_HOLD_MS;
+    lastReseatTime = millis();
+}
+
+void GateController::attachServos() {
+    if (servosAttached) {
+        return;
+    }
+    if (SERVO_POWER_SWITCH) {
+        digitalWrite(SERVO_POWER_PIN, HIGH);
+        waitForServos(SERVO_POWER_UP_MS);
+    }
+    for (uint8_t i = 0; i < GATE_COUNT; i++) {
+        // Written first so the very first pulse holds it where it is.
+        gates[i].servo.write(gates[i].currentServoPosition);
+        gates[i].servo.attach(SERVO_PINS[i], 500, 2500);
+    }
+    servosAttached = true;
+    attachedTime = millis();
+    profiler.count(COUNTER_SERVO_ATTACHES);
+}
+
+void GateController::detachServos() {
+    if (!servosAttached) {
+        return;
+    }
+    for (uint8_t i = 0; i < GATE_COUNT; i++) {
+        gates[i].servo.detach();
+    }
+    if (SERVO_POWER_SWITCH) {
+        digitalWrite(SERVO_POWER_PIN, LOW);
+    }
+    servosAttached = false;
+    totalAttachedMs += millis() - attachedTime;
+    profiler.count(COUNTER_SERVO_ATTACHED_MS, millis() - attachedTime);
+}
+
+unsigned long GateController::getAttachedMs() const {
+    return totalAttachedMs + (servosAttached ? millis() - attachedTime : 0);
+}
 
-        currentServoPosition = lastClosedPinAnalogReading;
-        servo.write(analogToServoPosition(currentServoPosition));
+void GateController::updateServoPower() {
+    if (servosAttached) {
+        if (SERVO_HOLD_MS > 0 && !inCalibration() && detachTime <= millis()) {
+            detachServos();
+        }
+    } else if (SERVO_RESEAT_INTERVAL_MS > 0 && (lastReseatTime + SERVO_RESEAT_INTERVAL_MS) < millis()) {
+        lastReseatTime = millis();
+        attachServos();
+        detachTime = millis() + SERVO_RESEAT_PULSE_MS;
+        profiler.count(COUNTER_SERVO_RESEATS);
     }
-    servo.attach(SERVO_PIN, 500, 2500);
 }
 
 CalibrateStatus GateController::calibrate(int pin, int& lastReadValue, bool& inCalibration) {
@@ -59,11 +140,11 @@ CalibrateStatus GateController::calibrate(int pin, int& lastReadValue, bool& inC
     if ((!inCalibration && diff >= BEGIN_CALIBRATION_CHANGE_AMOUNT)
             || (inCalibration && diff >= IN_CALIBRATION_ANALOG_FLOAT_AMOUNT)) {
         if (!inCalibration) {
-            Serial.print("Entering calibration for: ");
+            Serial.print(F("Entering calibration for: "));
             if (pin == OPEN_POT_PIN) {
-                Serial.println("open position");
+                Serial.println(F("open position"));
             } else {
-                Serial.println("close position");
+                Serial.println(F("close position"));
             }
             inCalibration = true;
         }
@@ -71,10 +152,10 @@ CalibrateStatus GateController::calibrate(int pin, int& lastReadValue, bool& inC
         lastReadValue = newReading;
         
         int newServoPosition = analogToServoPosition(newReading);
-        Serial.print("IN CALIBRATION - going to position: ");
+        Serial.print(F("IN CALIBRATION - going to position: "));
         Serial.println(newServoPosition);
         
-        goToPosition(newServoPosition);
+        goToPosition(0, newServoPosition);
         return IN_CALIBRATION;
     } else if (inCalibration && (calibrationUpdateTime + TIME_TO_CALIBRATE_MS) <= millis()) {
         inCalibration = false;
@@ -84,73 +165,41 @@ CalibrateStatus GateController::calibrate(int pin, int& lastReadValue, bool& inC
 }
 
 void GateController::onLoop() {
-    if (mode == DUST_COLLECTOR) {
-        return;
-    }
+    updateServoPower();
     if (SERIAL_CALIBRATION) {
-        calibrationUpdateTime = 0;
-        inOpenCalibration = false;
-        inCloseCalibration = false;
-        bool positionsUpdated = false;
-        while (Serial.available() || (inCalibration() && (calibrationUpdateTime + TIME_TO_CALIBRATE_MS) > millis())) {
-
-            String input = Serial.readStringUntil(' ');
-            int newPosition = Serial.parseInt();
-            if (newPosition > 0 && newPosition <= 180) {
-                calibrationUpdateTime = millis();
-
-                if (input.startsWith("o")) {
-                    Serial.print("Updating open position to: ");
-                    Serial.println(newPosition);
-                    inOpenCalibration = true;
-                    positionsUpdated = positionsUpdated || gatePositions.openPosition != newPosition;
-                    gatePositions.openPosition = newPosition;
-                    calibrationUpdateTime = millis();
-                    goToPosition(newPosition);
-                
-                } else if (input.startsWith("c")) {
-                    Serial.print("Updating closed position to: ");
-                    Serial.println(newPosition);
-                    inCloseCalibration = true;
-                    positionsUpdated = positionsUpdated || gatePositions.openPosition != newPosition;
-                    gatePositions.closedPosition = newPosition;
-                    calibrationUpdateTime = millis();
-                    goToPosition(newPosition);
-                }
-            }   
-        }
-        
-        if (inCalibration()) {
-            Serial.println("Serial calibration complete");
+        // New positions come in through setCalibratedPosition() from the
+        // serial console.  All we do here is wait for them to stop.
+        if (inCalibration() && (calibrationUpdateTime + TIME_TO_CALIBRATE_MS) <= millis()) {
+            Serial.println(F("Serial calibration complete"));
             inOpenCalibration = false;
             inCloseCalibration = false;
             if (positionsUpdated) {
-                Serial.print("Saving new gate positions: open=");
-                Serial.print(gatePositions.openPosition);
-                Serial.print(" closed=");
-                Serial.println(gatePositions.closedPosition);
-                EEPROM.put(0, gatePositions);
-            }
-            if (currentGateState == OPEN) {
-                goToPosition(gatePositions.openPosition);
-            } else if (currentGateState == CLOSED) {
-                goToPosition(gatePositions.closedPosition);
+                for (uint8_t i = 0; i < GATE_COUNT; i++) {
+                    Serial.print(F("Saving gate "));
+                    Serial.print(i);
+                    Serial.print(F(" positions: open="));
+                    Serial.print(gates[i].positions.openPosition);
+                    Serial.print(F(" closed="));
+                    Serial.println(gates[i].positions.closedPosition);
+                    EEPROM.put(EEPROM_GATE_POSITIONS_ADDRESS + i * sizeof(GatePositions), gates[i].positions);
+                }
+                positionsUpdated = false;
             }
+            goToTargets();
         }
-        
     } else {
         CalibrateStatus status;
         bool calibrationDone = false;
         if (inOpenCalibration) {
             status = calibrate(OPEN_POT_PIN, lastOpenPinAnalogReading, inOpenCalibration);
             if (status == LEAVING_CALIBRATION) {
-                Serial.println("Finished open calibration");
+                Serial.println(F("Finished open calibration"));
                 calibrationDone = true;
             }
         } else if (inCloseCalibration) {
             status = calibrate(CLOSED_POT_PIN, lastClosedPinAnalogReading, inCloseCalibration);
             if (status == LEAVING_CALIBRATION) {
-                Serial.println("Finished closed calibration");
+                Serial.println(F("Finished closed calibration"));
                 calibrationDone = true;
             }
         } else {
@@ -162,45 +211,126 @@ void GateController::onLoop() {
         }
 
         if (calibrationDone) {
-            if (currentGateState == OPEN) {
-                goToAnalogPosition(lastOpenPinAnalogReading);
-            } else {
-                goToAnalogPosition(lastClosedPinAnalogReading);
-            }
+            goToTargets();
         }
     }
 }
 
 bool GateController::isOpen() {
-    return currentGateState == OPEN;
+    return getOpenGates() != 0;
 }
 
-void GateController::openGate() {
-    if (currentGateState != OPEN) {
-        currentGateState = OPEN;
-        if (!inCalibration()) {
-            Serial.println("Opening the gate");
-            goToAnalogPosition(lastOpenPinAnalogReading);
-        } else {
-            Serial.println("Open gate requested, but currently in calibration mode.  Ignoring");
+bool GateController::isOpen(uint8_t gate) {
+    return gate < GATE_COUNT && gates[gate].state == OPEN;
+}
+
+bool GateController::isClosed() {
+    return getOpenGates() == 0;
+}
+
+bool GateController::isClosed(uint8_t gate) {
+    return gate < GATE_COUNT && gates[gate].state == CLOSED;
+}
+
+uint8_t GateController::getOpenGates() {
+    uint8_t open = 0;
+    for (uint8_t i = 0; i < GATE_COUNT; i++) {
+        if (gates[i].state == OPEN) {
+            open |= 1 << i;
         }
     }
+    return open;
 }
 
-bool GateController::isClosed() {
-    return currentGateState == CLOSED;
+bool GateController::setCalibratedPosition(GateState state, int position, uint8_t gate) {
+    if (!SERIAL_CALIBRATION || position <= 0 || position > MAX_ROTATION || gate >= GATE_COUNT) {
+        return false;
+    }
+    calibrationUpdateTime = millis();
+    GatePositions &positions = gates[gate].positions;
+    Serial.print(F("Updating gate "));
+    Serial.print(gate);
+    if (state == OPEN) {
+        Serial.print(F(" open position to: "));
+        inOpenCalibration = true;
+        positionsUpdated = positionsUpdated || positions.openPosition != position;
+        positions.openPosition = position;
+    } else {
+        Serial.print(F(" closed position to: "));
+        inCloseCalibration = true;
+        positionsUpdated = positionsUpdated || positions.closedPosition != position;
+        positions.closedPosition = position;
+    }
+    Serial.println(position);
+    goToPosition(gate, position);
+    return true;
+}
+
+void GateController::setOverride(Override override) {
+    this->override = override;
+    if (!inCalibration()) {
+        goToTargets();
+    }
+}
+
+int GateController::targetPosition(uint8_t gate) {
+    GateState state = gates[gate].state;
+    if (override == OVERRIDE_ON) {
+        state = OPEN;
+    } else if (override == OVERRIDE_OFF) {
+        state = CLOSED;
+    }
+    if (SERIAL_CALIBRATION) {
+        return state == OPEN ? gates[gate].positions.openPosition : gates[gate].positions.closedPosition;
+    }
+    return analogToServoPosition(state == OPEN ? lastOpenPinAnalogReading : lastClosedPinAnalogReading);
+}
+
+void GateController::openGate() {
+    setGates(ALL_GATES, OPEN);
+}
+
+void GateController::openGate(uint8_t gate) {
+    if (gate < GATE_COUNT) {
+        setGates(1 << gate, OPEN);
+    }
 }
 
 void GateController::closeGate() {
-    if (currentGateState != CLOSED) {
-        currentGateState = CLOSED;
-        if (!inCalibration()) {
-            Serial.println("Closing the gate");
-            goToAnalogPosition(lastClosedPinAnalogReading);
+    setGates(ALL_GATES, CLOSED);
+}
+
+void GateController::closeGate(uint8_t gate) {
+    if (gate < GATE_COUNT) {
+        setGates(1 << gate, CLOSED);
+    }
+}
+
+void GateController::setGates(uint8_t mask, GateState state) {
+    bool changed = false;
+    for (uint8_t i = 0; i < GATE_COUNT; i++) {
+        if ((mask & (1 << i)) && gates[i].state != state) {
+            gates[i].state = state;
+            changed = true;
+        }
+    }
+    if (!changed) {
+        return;
+    }
+    if (inCalibration()) {
+        if (state == OPEN) {
+            Serial.println(F("Open gate requested, but currently in calibration mode.  Ignoring"));
         } else {
-            Serial.println("Close gate requested, but currently in calibration mode.  Ignoring");
+            Serial.println(F("Close gate requested, but currently in calibration mode.  Ignoring"));
         }
+        return;
     }
+    if (state == OPEN) {
+        Serial.println(F("Opening the gate"));
+    } else {
+        Serial.println(F("Closing the gate"));
+    }
+    goToTargets();
 }
 
 int GateController::analogToServoPosition(int analogValue) {
@@ -208,29 +338,45 @@ int GateController::analogToServoPosition(int analogValue) {
     return map(analogValue, 0, 1023, 0, MAX_ROTATION);
 }
 
-void GateController::goToAnalogPosition(int analogValue) {
-    goToPosition(analogToServoPosition(analogValue));
-}
-
-void GateController::goToPosition(const int position) {
-    if (position == currentServoPosition) {
-        // Serial.println("Already at requested position.  Not moving");
-        return;
+void GateController::goToTargets() {
+    int positions[GATE_COUNT];
+    for (uint8_t i = 0; i < GATE_COUNT; i++) {
+        positions[i] = targetPosition(i);
     }
+    moveGates(positions);
+}
 
-    // Serial.print("Target position: ");
-    // Serial.println(position);
-
-    int inc;
-    if (currentServoPosition > position) {
-        inc = -1;
-    } else {
-        inc = 1;
+void GateController::goToPosition(uint8_t gate, int position) {
+    int positions[GATE_COUNT];
+    for (uint8_t i = 0; i < GATE_COUNT; i++) {
+        positions[i] = gates[i].currentServoPosition;
     }
+    positions[gate] = position;
+    moveGates(positions);
+}
 
+void GateController::moveGates(const int *positions) {
+    // Every gate takes a step each time around, so opening them all takes
+    // as long as the longest move rather than the sum of them.
+    attachServos();
+    bool moving;
     do {
-        currentServoPosition += inc;
-        servo.write(currentServoPosition);
-        delay(DELAY_BETWEEN_SERVO_STEPS_MS);
-    } while (position != currentServoPosition);
-}
\ No newline at end of file
+        moving = false;
+        for (uint8_t i = 0; i < GATE_COUNT; i++) {
+            Gate &gate = gates[i];
+            if (gate.currentServoPosition == positions[i]) {
+                continue;
+            }
+            gate.currentServoPosition += gate.currentServoPosition > positions[i] ? -1 : 1;
+            if (!FAULT_INJECTION || faults->get(FAULT_SERVO_STALL) == 0) {
+                gate.servo.write(gate.currentServoPosition);
+            }
+            moving = true;
+        }
+        if (moving) {
+            waitForServos(DELAY_BETWEEN_SERVO_STEPS_MS);
+        }
+    } while (moving);
+    detachTime = millis() + SERVO_HOLD_MS;
+    lastReseatTime = millis();
+}
@@ -5,6 +5,11 @@
 #include <Servo.h>
 #include "StatusController.h"
 #include "Ids.h"
+#include "WarmStart.h"
+#include "Constants.h"
+#include "GatePins.h"
+
+static_assert(GATE_COUNT >= 1 && GATE_COUNT <= MAX_GATES, "Not enough servo pins for GATE_COUNT");
 
 enum GateState {
   OPEN,
@@ -23,38 +28,106 @@ struct GatePositions {
     int openPosition = 180;
 };
 
+/**
+ * A bit for each gate, for the calls that take more than one.
+ */
+const uint8_t ALL_GATES = (1 << GATE_COUNT) - 1;
+
+struct Gate {
+    Servo servo;
+    GatePositions positions;
+    GateState state = CLOSED;
+    int currentServoPosition = 0;
+};
+
 class GateController {
     public:
         GateController(StatusController &sc, Ids &ids)  : statusController(sc), ids(ids) {};
-        void setup();
+        /**
+         * Pass the saved state to warm start from it.  This skips sampling the
+         * calibration pots and puts the servo straight back where it was.
+         */
+        void setup(const WarmStartState *warmState);
         void onLoop();
+        /**
+         * Every gate.  They all move at once.
+         */
         void openGate();
         void closeGate();
+        void openGate(uint8_t gate);
+        void closeGate(uint8_t gate);
+        /**
+         * Whether every gate is closed, or any is open.
+         */
         bool isClosed();
         bool isOpen();
+        bool isClosed(uint8_t gate);
+        bool isOpen(uint8_t gate);
+        /**
+         * A bit for each gate that is open, for WarmStart.
+         */
+        uint8_t getOpenGates();
+        /**
+         * Sets a new open/closed position for one gate from the serial
+         * console.  Only works with SERIAL_CALIBRATION.  Saved once no more
+         * updates come in for TIME_TO_CALIBRATE_MS.
+         */
+        bool setCalibratedPosition(GateState state, int position, uint8_t gate);
+        /**
+         * Holds the gate open (OVERRIDE_ON) or closed (OVERRIDE_OFF) no matter
+         * what openGate()/closeGate() ask for.
+         */
+        void setOverride(Override override);
+        int getOpenReading() const { return lastOpenPinAnalogReading; }
+        int getClosedReading() const { return lastClosedPinAnalogReading; }
+        /**
+         * How long the servos have been powered since boot.
+         */
+        unsigned long getAttachedMs() const;
+        /**
+         * Not moving, holding or calibrating, so it's ok to sleep.
+         */
+        bool isIdle() { return !servosAttached && !inCalibration(); }
     private:
         StatusController &statusController;
         Ids &ids;
         
-        GateState currentGateState;
-        GatePositions gatePositions;
+        Gate gates[GATE_COUNT];
 
         bool inOpenCalibration = false;
         bool inCloseCalibration = false;
+        bool positionsUpdated = false;
         unsigned long calibrationUpdateTime = 0;
+        Override override = OVERRIDE_AUTO;
+
+        bool servosAttached = false;
+        unsigned long attachedTime = 0;
+        unsigned long totalAttachedMs = 0;
+        unsigned long detachTime = VALUE_UNSET;
+        unsigned long lastReseatTime = 0;
         
 
         // int lastOpenPositionReading;
         // int lastClosedPositionReading;
-        int lastOpenPinAnalogReading;
-        int lastClosedPinAnalogReading;
-
-        int currentServoPosition;
-        Servo servo;
+        int lastOpenPinAnalogReading = 0;
+        int lastClosedPinAnalogReading = 0;
 
         int analogToServoPosition(int analogValue);
-        void goToAnalogPosition(int analogValue);
-        void goToPosition(int position);
+        int targetPosition(uint8_t gate);
+        /**
+         * Sets the state of the gates in the mask and moves any that changed.
+         */
+        void setGates(uint8_t mask, GateState state);
+        /**
+         * Moves every gate to where it should be, a step at a time, all at
+         * once.
+         */
+        void goToTargets();
+        void goToPosition(uint8_t gate, int position);
+        void moveGates(const int *positions);
+        void attachServos();
+        void detachServos();
+        void updateServoPower();
         CalibrateStatus calibrate(int pin, int& lastReadValue, bool& inCalibration);
         
         bool inCalibration() { return inOpenCalibration || inCloseCalibration; }
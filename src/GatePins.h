@@ -7,19 +7,32 @@ const int CURRENT_SENSOR_PIN = A5;
 
 const int DUST_COLLECTOR_PIN = A1;
 
-// const int WIRELESS_IRQ_PIN = 2;
+const int WIRELESS_IRQ_PIN = 2;
 
 const int CE_PIN = 9;
 const int CSN_PIN = 10;
+/**
+ * MOSI, MISO and SCK, for the radio.
+ */
+constexpr int SPI_PINS[] = {11, 12, 13};
 
-const int BRANCH_PINS[] = {3, 4, 5, 6};
+constexpr int BRANCH_PINS[] = {3, 4, 5, 6};
 const int BRANCH_PINS_LENGTH = 4;
+/**
+ * The branch pins as bits of port D, for the pin change interrupt.
+ */
+const uint8_t GATE_CODE_PORT_D_MASK = 0x78;
+
+const int SERIAL_RX_PIN = 0;
 
 const int SERVO_PIN = 7;
-//  const int SERVO_POWER_PIN = 8;
+/**
+ * Only used with SERVO_POWER_SWITCH.  Shares MODE_PIN, which nothing reads.
+ */
+const int SERVO_POWER_PIN = 8;
 
 const int CLOSED_POT_PIN = A4;
-const int OPEN_POT_PIN = A3; 
+const int OPEN_POT_PIN = A3;
 
 const int MODE_PIN = 8;
 
@@ -27,4 +40,22 @@ const int RED_LED = A0;
 const int GREEN_LED = A1;
 const int BLUE_LED = A2;
 
+/**
+ * One servo per gate.  Every other pin is taken, so the second gate borrows
+ * the open pot's pin.  Nodes with more than one gate are calibrated over
+ * serial and never read that pot, and Ids leaves it out of the id seed.
+ */
+constexpr int SERVO_PINS[] = {SERVO_PIN, OPEN_POT_PIN};
+const uint8_t MAX_GATES = 2;
+
+constexpr bool isFixedPin(int pin) {
+    return pin == SERIAL_RX_PIN || pin == WIRELESS_IRQ_PIN || pin == CE_PIN || pin == CSN_PIN
+        || pin == SPI_PINS[0] || pin == SPI_PINS[1] || pin == SPI_PINS[2]
+        || pin == BRANCH_PINS[0] || pin == BRANCH_PINS[1] || pin == BRANCH_PINS[2] || pin == BRANCH_PINS[3]
+        || pin == MODE_PIN || pin == SERVO_POWER_PIN || pin == CURRENT_SENSOR_PIN || pin == DUST_COLLECTOR_PIN
+        || pin == CLOSED_POT_PIN || pin == RED_LED || pin == GREEN_LED || pin == BLUE_LED;
+}
+static_assert(!isFixedPin(SERVO_PINS[0]) && SERVO_PINS[0] != OPEN_POT_PIN, "The first servo pin is used by something else");
+static_assert(!isFixedPin(SERVO_PINS[1]) && SERVO_PINS[1] != SERVO_PINS[0], "The second servo pin is used by something else");
+
 #endif
\ No newline at end of file
@@ -0,0 +1,46 @@
+#include "Gateway.h"
+#include <util/crc16.h>
+
+void Gateway::forward(const Payload &payload) {
+    uint8_t body[5 + sizeof(Payload)];
+    uint8_t *out = putLong(body, millis());
+    *out++ = radioController.getChannel();
+    memcpy(out, &payload, sizeof(Payload));
+    writeFrame(GATEWAY_RADIO_FRAME, body, sizeof(body));
+    forwarded++;
+}
+
+void Gateway::onLoop() {
+    if ((lastStatusTime + GATEWAY_STATUS_INTERVAL_MS) > millis()) {
+        return;
+    }
+    lastStatusTime = millis();
+    uint8_t body[14];
+    uint8_t *out = putLong(body, millis());
+    out = putLong(out, forwarded);
+    out = putLong(out, radioController.getRxOverflows());
+    *out++ = radioController.getChannel();
+    *out++ = radioController.getDataRate();
+    writeFrame(GATEWAY_STATUS, body, sizeof(body));
+}
+
+void Gateway::writeFrame(GatewayFrameType type, const uint8_t *body, uint8_t length) {
+    uint8_t crc = _crc8_ccitt_update(0, length + 1);
+    crc = _crc8_ccitt_update(crc, type);
+    for (uint8_t i = 0; i < length; i++) {
+        crc = _crc8_ccitt_update(crc, body[i]);
+    }
+    Serial.write(GATEWAY_SYNC_1);
+    Serial.write(GATEWAY_SYNC_2);
+    Serial.write(length + 1);
+    Serial.write(type);
+    Serial.write(body, length);
+    Serial.write(crc);
+}
+
+uint8_t *Gateway::putLong(uint8_t *out, unsigned long value) {
+    for (uint8_t i = 0; i < 4; i++) {
+        *out++ = value >> (8 * i);
+    }
+    return out;
+}
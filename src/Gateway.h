@@ -0,0 +1,54 @@
+#ifndef gateway_h
+#define gateway_h
+
+#include <Arduino.h>
+#include "RadioController.h"
+
+/**
+ * Frames on the serial line to the host.  Log text can still show up between
+ * them, so each starts with two sync bytes and ends with a CRC-8 (CCITT, like
+ * everything else) over the length, type and body:
+ *
+ *   0xA5 0x5A length type body... crc
+ *
+ * length counts the type and body.
+ */
+const uint8_t GATEWAY_SYNC_1 = 0xA5;
+const uint8_t GATEWAY_SYNC_2 = 0x5A;
+
+enum GatewayFrameType {
+    /**
+     * Something we heard: millis (4 bytes, little endian), channel, then the
+     * Payload exactly as it came off the air.
+     */
+    GATEWAY_RADIO_FRAME = 1,
+    /**
+     * Every GATEWAY_STATUS_INTERVAL_MS: millis, frames forwarded and times we
+     * found the radio's RX FIFO full (so frames may have been lost), all 4
+     * bytes, then channel and data rate.
+     */
+    GATEWAY_STATUS = 2,
+};
+
+const unsigned long GATEWAY_STATUS_INTERVAL_MS = 1000;
+
+/**
+ * The gateway role.  Passes every frame the radio hears up to the host.
+ */
+class Gateway {
+    public:
+        Gateway(RadioController &radioController) : radioController(radioController) {};
+        void onLoop();
+        void forward(const Payload &payload);
+    private:
+        RadioController &radioController;
+        unsigned long forwarded = 0;
+        unsigned long lastStatusTime = 0;
+
+        void writeFrame(GatewayFrameType type, const uint8_t *body, uint8_t length);
+        static uint8_t *putLong(uint8_t *out, unsigned long value);
+};
+
+extern Gateway *const gateway;
+
+#endif
@@ -1,40 +1,106 @@
 #include "Ids.h"
 #include "Constants.h"
 #include "GatePins.h"
+#include "EepromLayout.h"
+#include "Profiler.h"
+#include <EEPROM.h>
+#include <util/crc16.h>
+#include "FastPin.h"
+#include "PinChange.h"
+
+uint8_t leaseChecksum(const SavedLease &lease) {
+    const uint8_t *bytes = (const uint8_t *) &lease;
+    uint8_t crc = 0;
+    // Up to the checksum rather than the size, which has padding after it
+    // anywhere but avr-gcc.
+    for (unsigned int i = 0; i < offsetof(SavedLease, checksum); i++) {
+        crc = _crc8_ccitt_update(crc, bytes[i]);
+    }
+    return crc;
+}
 
 void Ids::setup() {
     if (mode == DUST_COLLECTOR) {
         id = DUST_COLLECTOR_ID;
+        address = DUST_COLLECTOR_ADDRESS;
     } else {
         // randomSeed(analogRead(A0));
 
-        for (int i = 0; i < BRANCH_PINS_LENGTH; i++) {
-            pinMode(BRANCH_PINS[i], INPUT_PULLUP);
-        }
+        FastPin<BRANCH_PINS[0]>::setInputPullup();
+        FastPin<BRANCH_PINS[1]>::setInputPullup();
+        FastPin<BRANCH_PINS[2]>::setInputPullup();
+        FastPin<BRANCH_PINS[3]>::setInputPullup();
+        gateCode = readGateCode();
+        enablePinChange(GATE_CODE_PORT_D_MASK);
+        loadLease();
+        populateId();
+        // Our id is unique, so seeding with it keeps nodes from making the
+        // same "random" choices after powering up together.
+        randomSeed(id ^ micros());
     }
 }
 
 unsigned int Ids::currentGateCode() {
+    ScopedProbe probe(PROBE_GATE_CODE);
     if (mode == DUST_COLLECTOR) {
         return 0;
     }
-    unsigned int value = 0;
-    for (int i = 0; i < BRANCH_PINS_LENGTH; i++) {
-        value *= 2;
-        if (digitalRead(BRANCH_PINS[i]) == LOW) {
-        value++;
-        }
+    if (gateCodePinChanged) {
+        gateCodePinChanged = false;
+        gateCode = readGateCode();
+        Serial.print(F("Gate code changed to: "));
+        Serial.println(gateCode);
     }
-    return value;
+    return gateCode;
+}
+
+unsigned int Ids::readGateCode() {
+    // A switch that is on pulls its pin low.  The first pin is the high bit.
+    return (FastPin<BRANCH_PINS[0]>::read() ? 0 : 8)
+        | (FastPin<BRANCH_PINS[1]>::read() ? 0 : 4)
+        | (FastPin<BRANCH_PINS[2]>::read() ? 0 : 2)
+        | (FastPin<BRANCH_PINS[3]>::read() ? 0 : 1);
 }
 
 void Ids::populateId() {
     if (id == VALUE_UNSET) {
-        // If the first run is not from when we just started, we can use the
-        // millis() as a good random seed.
-        if (millis() > 10000) {
-            randomSeed(millis());
+        // Every node powers up at the same time after a breaker trip, so
+        // millis() is no good as a seed here.  The low bits of the analog
+        // pins are noisy enough to tell nodes apart.  With a second gate the
+        // open pot's pin drives its servo, so read the closed pot instead.
+        const int potPin = GATE_COUNT > 1 ? CLOSED_POT_PIN : OPEN_POT_PIN;
+        unsigned long seed = micros();
+        for (int i = 0; i < 16; i++) {
+            seed = (seed << 2) ^ analogRead(CURRENT_SENSOR_PIN) ^ analogRead(potPin);
         }
+        randomSeed(seed);
         id = abs(random(2147483600));
+        saveLease();
     }
 }
+
+void Ids::setAddress(uint8_t address) {
+    if (this->address != address) {
+        Serial.print(F("Leased address: "));
+        Serial.println(address);
+        this->address = address;
+        saveLease();
+    }
+}
+
+void Ids::loadLease() {
+    SavedLease lease;
+    EEPROM.get(EEPROM_LEASE_ADDRESS, lease);
+    if (lease.version == LEASE_VERSION && lease.checksum == leaseChecksum(lease)) {
+        id = lease.id;
+        address = lease.address;
+    }
+}
+
+void Ids::saveLease() {
+    SavedLease lease;
+    lease.id = id;
+    lease.address = address;
+    lease.checksum = leaseChecksum(lease);
+    EEPROM.put(EEPROM_LEASE_ADDRESS, lease);
+}
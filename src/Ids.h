@@ -3,14 +3,49 @@
 
 #include "Constants.h"
 
+/**
+ * Short addresses are handed out by the dust collector (see LeaseTable) and
+ * are what we put in every frame.  0 means we don't have one yet.
+ */
+const uint8_t ADDRESS_UNSET = 0;
+const uint8_t DUST_COLLECTOR_ADDRESS = 1;
+const uint8_t FIRST_NODE_ADDRESS = 2;
+
+const uint8_t LEASE_VERSION = 1;
+
+struct SavedLease {
+    uint8_t version = LEASE_VERSION;
+    unsigned long id = VALUE_UNSET;
+    uint8_t address = ADDRESS_UNSET;
+    uint8_t checksum = 0;
+};
+
 class Ids {
     public:
         void setup();
+        /**
+         * Read from the switches at setup and again only after one of them
+         * changes (pin change interrupt).
+         */
         unsigned int currentGateCode();
         unsigned long getID() const { return id; }
         void populateId();
+
+        uint8_t getAddress() const { return address; }
+        bool hasAddress() const { return address != ADDRESS_UNSET; }
+        /**
+         * Called when the dust collector hands us a lease.  Saved to EEPROM so
+         * we ask for the same address after a reboot.
+         */
+        void setAddress(uint8_t address);
     private:
+        unsigned int gateCode = 0;
+        unsigned int readGateCode();
         unsigned long id = VALUE_UNSET;
+        uint8_t address = ADDRESS_UNSET;
+
+        void loadLease();
+        void saveLease();
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,87 @@
+#include "Latency.h"
+
+const char LATENCY_STAGE_NAMES[LATENCY_STAGE_COUNT][11] PROGMEM = {
+    "node",
+    "radio",
+    "collector",
+    "total",
+    "branchGate",
+};
+
+/**
+ * Ignore skew estimates past this.  They come from a missed beacon or a
+ * collector reboot, not the crystal.
+ */
+const long MAX_SKEW_PPM = 20000;
+
+void Latency::onBeacon(unsigned long collectorMillis) {
+    unsigned long now = millis();
+    if (synced) {
+        long localElapsed = now - lastBeaconLocal;
+        long collectorElapsed = collectorMillis - lastBeaconCollector;
+        if (localElapsed >= 1000) {
+            long measured = (collectorElapsed - localElapsed) * 1000L / (localElapsed / 1000);
+            if (abs(measured) < MAX_SKEW_PPM) {
+                skewPpm += (measured - skewPpm) / 4;
+            }
+        }
+    }
+    lastBeaconLocal = now;
+    lastBeaconCollector = collectorMillis;
+    synced = true;
+}
+
+unsigned long Latency::collectorTime(unsigned long localMillis) const {
+    if (mode == DUST_COLLECTOR || !synced) {
+        return localMillis;
+    }
+    long elapsed = localMillis - lastBeaconLocal;
+    return lastBeaconCollector + elapsed + elapsed / 1000 * skewPpm / 1000;
+}
+
+void Latency::record(LatencyStage stage, unsigned long ms) {
+    if (histograms == NULL || stage < LATENCY_FIRST_STAGE || stage >= LATENCY_FIRST_STAGE + LATENCY_STAGES) {
+        return;
+    }
+    uint8_t index = stage - LATENCY_FIRST_STAGE;
+    uint8_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS - 1 && (ms >> (bucket + 1)) > 0) {
+        bucket++;
+    }
+    if (histograms->counts[index][bucket] < UINT16_MAX) {
+        histograms->counts[index][bucket]++;
+    }
+    histograms->maxMs[index] = max(histograms->maxMs[index], ms);
+}
+
+void Latency::recordSince(LatencyStage stage, unsigned long origin) {
+    if (origin == VALUE_UNSET || !isSynced()) {
+        return;
+    }
+    long elapsed = collectorNow() - origin;
+    // Clock error can make a fast stage look like it went backwards.
+    record(stage, elapsed > 0 ? elapsed : 0);
+}
+
+void Latency::report() {
+    Serial.print(F("Latency (ms buckets 0,2,4,8..): synced="));
+    Serial.print(isSynced());
+    Serial.print(F(" skewPpm="));
+    Serial.println(skewPpm);
+    if (histograms == NULL) {
+        return;
+    }
+    for (uint8_t i = 0; i < LATENCY_STAGES; i++) {
+        if (histograms->maxMs[i] == 0 && histograms->counts[i][0] == 0) {
+            continue;
+        }
+        Serial.print(F("  "));
+        Serial.print((const __FlashStringHelper *) LATENCY_STAGE_NAMES[LATENCY_FIRST_STAGE + i]);
+        for (uint8_t b = 0; b < LATENCY_BUCKETS; b++) {
+            Serial.print(F(" "));
+            Serial.print(histograms->counts[i][b]);
+        }
+        Serial.print(F(" max="));
+        Serial.println(histograms->maxMs[i]);
+    }
+}
@@ -0,0 +1,82 @@
+#ifndef latency_h
+#define latency_h
+
+#include <Arduino.h>
+#include "Constants.h"
+#include "Slot.h"
+
+/**
+ * Histogram buckets are powers of two: bucket 0 is under 2ms, bucket n is
+ * 2^n to 2^(n+1) - 1 ms, and the last one is everything from 16s up.
+ */
+const uint8_t LATENCY_BUCKETS = 15;
+
+/**
+ * The stages between a motor starting and the dust moving.  Measured on the
+ * dust collector except LATENCY_BRANCH_GATE, which each branch gate keeps.
+ */
+enum LatencyStage {
+    LATENCY_NODE,         // Current onset to RUNNING going out (includes opening the gate)
+    LATENCY_RADIO,        // RUNNING going out to the collector reading it
+    LATENCY_COLLECTOR,    // Reading it to the relay closing
+    LATENCY_TOTAL,        // Current onset to the relay closing
+    LATENCY_BRANCH_GATE,  // Current onset to a branch gate finishing opening
+    LATENCY_STAGE_COUNT
+};
+
+/**
+ * The stages this role keeps histograms for: the dust collector's first
+ * four, or the branch gate's own.  Machines only share the clock.
+ */
+const uint8_t LATENCY_FIRST_STAGE = mode == BRANCH_GATE ? LATENCY_BRANCH_GATE : LATENCY_NODE;
+const uint8_t LATENCY_STAGES = mode == DUST_COLLECTOR ? LATENCY_BRANCH_GATE : mode == BRANCH_GATE ? 1 : 0;
+
+template <uint8_t STAGES>
+struct LatencyHistograms {
+    unsigned int counts[STAGES][LATENCY_BUCKETS] = {{0}};
+    unsigned long maxMs[STAGES] = {0};
+};
+
+/**
+ * Shares the dust collector's clock with every node, and keeps latency
+ * histograms in that clock.
+ *
+ * The collector's BEACON carries its millis().  Nodes keep the offset from
+ * the last one and the rate their clock runs at against it, since cheap
+ * resonators can be off by 0.5%, which is 150ms between beacons.
+ */
+class Latency {
+    public:
+        void onBeacon(unsigned long collectorMillis);
+        bool isSynced() const { return mode == DUST_COLLECTOR || synced; }
+        /**
+         * Our millis() in the dust collector's clock.
+         */
+        unsigned long collectorTime(unsigned long localMillis) const;
+        unsigned long collectorNow() const { return collectorTime(millis()); }
+        /**
+         * Stages other than this role's are ignored.
+         */
+        void record(LatencyStage stage, unsigned long ms);
+        /**
+         * Since an origin time in the collector's clock.  Does nothing for an
+         * origin of VALUE_UNSET.
+         */
+        void recordSince(LatencyStage stage, unsigned long origin);
+        void report();
+    private:
+        bool synced = false;
+        unsigned long lastBeaconLocal = 0;
+        unsigned long lastBeaconCollector = 0;
+        // How much faster the collector's clock runs than ours, in ppm.
+        long skewPpm = 0;
+        Slot<LatencyHistograms<LATENCY_STAGES>, (LATENCY_STAGES > 0)> histogramsSlot;
+        LatencyHistograms<LATENCY_STAGES> *const histograms = histogramsSlot.get();
+};
+
+/**
+ * Only on roles that transmit.  The gateway never syncs or records.
+ */
+extern Latency *const latency;
+
+#endif
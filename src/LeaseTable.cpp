@@ -0,0 +1,85 @@
+#include "LeaseTable.h"
+
+uint8_t LeaseTable::assign(unsigned long id, uint8_t requested) {
+    if (isNodeAddress(requested)) {
+        uint8_t index = requested - FIRST_NODE_ADDRESS;
+        if (ids[index] == VALUE_UNSET || ids[index] == id) {
+            ids[index] = id;
+            lastSeenMinutes[index] = nowMinutes();
+            return requested;
+        }
+    }
+
+    uint8_t freeIndex = MAX_NODES;
+    uint8_t oldestIndex = 0;
+    for (uint8_t i = 0; i < MAX_NODES; i++) {
+        if (ids[i] == id) {
+            lastSeenMinutes[i] = nowMinutes();
+            return i + FIRST_NODE_ADDRESS;
+        }
+        if (ids[i] == VALUE_UNSET && freeIndex == MAX_NODES) {
+            freeIndex = i;
+        }
+        if ((unsigned int) (nowMinutes() - lastSeenMinutes[i]) > (unsigned int) (nowMinutes() - lastSeenMinutes[oldestIndex])) {
+            oldestIndex = i;
+        }
+    }
+
+    uint8_t index = freeIndex;
+    if (index == MAX_NODES) {
+        Serial.println(F("Out of addresses.  Taking back the oldest lease"));
+        index = oldestIndex;
+    }
+    ids[index] = id;
+    lastSeenMinutes[index] = nowMinutes();
+    return index + FIRST_NODE_ADDRESS;
+}
+
+bool LeaseTable::renew(uint8_t address, unsigned long id) {
+    if (!isNodeAddress(address) || ids[address - FIRST_NODE_ADDRESS] != id) {
+        return false;
+    }
+    lastSeenMinutes[address - FIRST_NODE_ADDRESS] = nowMinutes();
+    return true;
+}
+
+void LeaseTable::touch(uint8_t address) {
+    if (isLeased(address)) {
+        lastSeenMinutes[address - FIRST_NODE_ADDRESS] = nowMinutes();
+    }
+}
+
+bool LeaseTable::isLeased(uint8_t address) const {
+    return isNodeAddress(address) && ids[address - FIRST_NODE_ADDRESS] != VALUE_UNSET;
+}
+
+unsigned long LeaseTable::getId(uint8_t address) const {
+    return isLeased(address) ? ids[address - FIRST_NODE_ADDRESS] : VALUE_UNSET;
+}
+
+void LeaseTable::queueWelcome(uint8_t address) {
+    if (!isLeased(address)) {
+        return;
+    }
+    if (!welcomesPending) {
+        welcomesPending = true;
+        nextWelcomeTime = millis() + WELCOME_COALESCE_MS + random(WELCOME_JITTER_MS);
+    }
+    uint8_t index = address - FIRST_NODE_ADDRESS;
+    pendingWelcomes[index / 8] |= 1 << (index % 8);
+}
+
+uint8_t LeaseTable::nextWelcome() {
+    if (!welcomesPending || nextWelcomeTime > millis()) {
+        return ADDRESS_UNSET;
+    }
+    for (uint8_t index = 0; index < MAX_NODES; index++) {
+        if (pendingWelcomes[index / 8] & (1 << (index % 8))) {
+            pendingWelcomes[index / 8] &= ~(1 << (index % 8));
+            nextWelcomeTime = millis() + WELCOME_SPACING_MS + random(WELCOME_JITTER_MS);
+            return index + FIRST_NODE_ADDRESS;
+        }
+    }
+    welcomesPending = false;
+    return ADDRESS_UNSET;
+}
@@ -0,0 +1,57 @@
+#ifndef lease_table_h
+#define lease_table_h
+
+#include <Arduino.h>
+#include "Ids.h"
+
+/**
+ * WELCOMEs are held for a short window so that repeated HELLO_WORLDs from a
+ * node only get one reply, then sent one at a time with a little jitter.
+ */
+const unsigned long WELCOME_COALESCE_MS = 50;
+const unsigned long WELCOME_SPACING_MS = 10;
+const unsigned long WELCOME_JITTER_MS = 20;
+
+/**
+ * Kept by the dust collector.  Maps short addresses to the long random ids
+ * nodes pick for themselves.  Everything is indexed directly by short address,
+ * so the only scan is when a node we've never seen says hello.
+ */
+class LeaseTable {
+    public:
+        /**
+         * Returns the address for the node, preferring the one it asked for
+         * (usually the one it had before a reboot).
+         */
+        uint8_t assign(unsigned long id, uint8_t requested);
+        /**
+         * Returns true if the address is already leased to this id.
+         */
+        bool renew(uint8_t address, unsigned long id);
+        void touch(uint8_t address);
+        bool isLeased(uint8_t address) const;
+        unsigned long getId(uint8_t address) const;
+
+        void queueWelcome(uint8_t address);
+        /**
+         * Returns the next address that is due a WELCOME, or ADDRESS_UNSET if
+         * none are due yet.
+         */
+        uint8_t nextWelcome();
+
+        static bool isNodeAddress(uint8_t address) {
+            return address >= FIRST_NODE_ADDRESS && address < FIRST_NODE_ADDRESS + MAX_NODES;
+        }
+    private:
+        unsigned long ids[MAX_NODES] = {VALUE_UNSET};
+        // Only used to pick a lease to take back when we run out.
+        unsigned int lastSeenMinutes[MAX_NODES] = {0};
+
+        uint8_t pendingWelcomes[(MAX_NODES + 7) / 8] = {0};
+        bool welcomesPending = false;
+        unsigned long nextWelcomeTime = 0;
+
+        static unsigned int nowMinutes() { return millis() / 60000; }
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "LinkAdapter.h"
+
+/**
+ * Slowest (longest range) first.
+ */
+const rf24_datarate_e DATA_RATES_BY_SPEED[DATA_RATE_COUNT] = {RF24_250KBPS, RF24_1MBPS, RF24_2MBPS};
+
+void LinkAdapter::onLoop(bool idle) {
+    if ((lastAdaptTime + LINK_ADAPT_INTERVAL_MS) > millis()) {
+        return;
+    }
+    lastAdaptTime = millis();
+    LinkStats &stats = radioController.getLinkStats();
+    PeerLink link = stats.totals();
+    adaptPALevel(link);
+    if (mode == DUST_COLLECTOR && channelManager != NULL) {
+        adaptDataRate(link, idle);
+    }
+    stats.halve();
+}
+
+void LinkAdapter::adaptPALevel(const PeerLink &link) {
+    if (link.sent < LINK_ADAPT_MIN_SAMPLES) {
+        return;
+    }
+    uint8_t paLevel = radioController.getPALevel();
+    uint8_t loss = percent(link.sent - link.delivered, link.sent);
+    if (loss >= LINK_LOSS_STEP_UP_PERCENT || link.worstFailureStreak >= LINK_FAILURE_STREAK_STEP_UP) {
+        cleanPAWindows = 0;
+        if (paLevel < RF24_PA_MAX) {
+            radioController.setPALevel(paLevel + 1);
+        }
+    } else if (link.delivered == link.sent && link.retries <= link.sent / 4) {
+        // Only back off after a good while, so we don't bounce between levels.
+        if (++cleanPAWindows >= LINK_CLEAN_WINDOWS_TO_RELAX && paLevel > MIN_PA_LEVEL) {
+            cleanPAWindows = 0;
+            radioController.setPALevel(paLevel - 1);
+        }
+    } else {
+        cleanPAWindows = 0;
+    }
+}
+
+void LinkAdapter::adaptDataRate(const PeerLink &link, bool idle) {
+    if (link.heard < LINK_ADAPT_MIN_SAMPLES || !idle || channelManager->isSwitching()) {
+        return;
+    }
+    uint8_t current = rank(radioController.getDataRate());
+    uint8_t loss = percent(link.missed, min(255, link.heard + link.missed));
+    uint8_t next = current;
+    if (loss >= DATA_RATE_LOSS_STEP_DOWN_PERCENT) {
+        cleanRateWindows = 0;
+        if (current > 0) {
+            next = current - 1;
+        }
+    } else if (link.missed == 0) {
+        if (++cleanRateWindows >= LINK_CLEAN_WINDOWS_TO_RELAX && current + 1 < DATA_RATE_COUNT) {
+            cleanRateWindows = 0;
+            next = current + 1;
+        }
+    } else {
+        cleanRateWindows = 0;
+    }
+    if (next != current) {
+        Serial.print(F("Moving everyone to data rate "));
+        Serial.print(DATA_RATES_BY_SPEED[next]);
+        Serial.print(F(" (missed "));
+        Serial.print(loss);
+        Serial.println(F("%)"));
+        channelManager->announceSwitch(radioController.getChannel(), DATA_RATES_BY_SPEED[next]);
+    }
+}
+
+uint8_t LinkAdapter::rank(rf24_datarate_e dataRate) {
+    for (uint8_t i = 0; i < DATA_RATE_COUNT; i++) {
+        if (DATA_RATES_BY_SPEED[i] == dataRate) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+void LinkAdapter::report() {
+    Serial.print(F("Channel: "));
+    Serial.print(radioController.getChannel());
+    Serial.print(F(" data rate: "));
+    Serial.print(radioController.getDataRate());
+    Serial.print(F(" PA level: "));
+    Serial.println(radioController.getPALevel());
+    radioController.getLinkStats().report();
+}
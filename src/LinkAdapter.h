@@ -0,0 +1,65 @@
+#ifndef link_adapter_h
+#define link_adapter_h
+
+#include <Arduino.h>
+#include "RadioController.h"
+#include "ChannelManager.h"
+
+const bool ADAPTIVE_LINK = true;
+
+/**
+ * How often we look at the link stats and maybe change something.  The stats
+ * are halved after each look so the next decision is mostly on new frames.
+ */
+const unsigned long LINK_ADAPT_INTERVAL_MS = 60000;
+
+/**
+ * Need at least this many frames before deciding anything.
+ */
+const uint8_t LINK_ADAPT_MIN_SAMPLES = 8;
+
+/**
+ * Percent of frames lost before we turn the power up or, on the dust
+ * collector, slow the network down.
+ */
+const uint8_t LINK_LOSS_STEP_UP_PERCENT = 10;
+const uint8_t LINK_FAILURE_STREAK_STEP_UP = 3;
+const uint8_t DATA_RATE_LOSS_STEP_DOWN_PERCENT = 20;
+
+/**
+ * Clean windows in a row before we turn the power down or speed back up.
+ */
+const uint8_t LINK_CLEAN_WINDOWS_TO_RELAX = 5;
+const rf24_pa_dbm_e MIN_PA_LEVEL = RF24_PA_LOW;
+
+/**
+ * Keeps the radio link working with as little power, and as much speed, as
+ * it can.  Every node moves its own PA level on how many of its frames get
+ * an ACK.  The dust collector also picks one data rate for everyone from how
+ * many frames it is missing, and moves the network with ChannelManager,
+ * since nodes on different rates can't hear each other.
+ */
+class LinkAdapter {
+    public:
+        LinkAdapter(RadioController &radioController, ChannelManager *channelManager)
+                : radioController(radioController), channelManager(channelManager) {};
+        /**
+         * idle is true when the dust collector is off, which is the only time
+         * we move everyone to another data rate.
+         */
+        void onLoop(bool idle);
+        void report();
+    private:
+        RadioController &radioController;
+        ChannelManager *channelManager;
+        unsigned long lastAdaptTime = 0;
+        uint8_t cleanPAWindows = 0;
+        uint8_t cleanRateWindows = 0;
+
+        void adaptPALevel(const PeerLink &link);
+        void adaptDataRate(const PeerLink &link, bool idle);
+        static uint8_t rank(rf24_datarate_e dataRate);
+        static uint8_t percent(uint8_t part, uint8_t whole) { return (unsigned int) part * 100 / whole; }
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "LinkStats.h"
+
+void LinkStats::recordSent(uint8_t peer, bool delivered, uint8_t retries) {
+    if (peer >= LINK_STATS_PEERS) {
+        return;
+    }
+    PeerLink &link = peers[peer];
+    if (link.sent >= LINK_STATS_WINDOW) {
+        halve(link);
+    }
+    link.sent++;
+    link.retries = min(255, link.retries + retries);
+    if (delivered) {
+        link.delivered++;
+        link.failureStreak = 0;
+    } else {
+        link.failureStreak = min(255, link.failureStreak + 1);
+        link.worstFailureStreak = max(link.worstFailureStreak, link.failureStreak);
+    }
+}
+
+void LinkStats::recordReceived(uint8_t peer, unsigned long messageId) {
+    if (peer >= LINK_STATS_PEERS || peer == ADDRESS_UNSET) {
+        return;
+    }
+    PeerLink &link = peers[peer];
+    if (link.heard >= LINK_STATS_WINDOW) {
+        halve(link);
+    }
+    uint8_t gap = (uint8_t) messageId - link.lastMessageId - 1;
+    if (link.heard > 0 && gap <= MAX_MISSED_MESSAGE_GAP) {
+        link.missed = min(255, link.missed + gap);
+    }
+    link.heard++;
+    link.lastMessageId = messageId;
+}
+
+PeerLink LinkStats::totals() const {
+    PeerLink total;
+    for (uint8_t i = 0; i < LINK_STATS_PEERS; i++) {
+        total.sent = min(255, total.sent + peers[i].sent);
+        total.delivered = min(total.sent, total.delivered + peers[i].delivered);
+        total.retries = min(255, total.retries + peers[i].retries);
+        total.failureStreak = max(total.failureStreak, peers[i].failureStreak);
+        total.worstFailureStreak = max(total.worstFailureStreak, peers[i].worstFailureStreak);
+        total.heard = min(255, total.heard + peers[i].heard);
+        total.missed = min(255, total.missed + peers[i].missed);
+    }
+    return total;
+}
+
+void LinkStats::halve() {
+    for (uint8_t i = 0; i < LINK_STATS_PEERS; i++) {
+        halve(peers[i]);
+    }
+}
+
+void LinkStats::halve(PeerLink &link) {
+    link.sent /= 2;
+    link.delivered /= 2;
+    link.retries /= 2;
+    link.worstFailureStreak = link.failureStreak;
+    link.heard /= 2;
+    link.missed /= 2;
+}
+
+void LinkStats::report() const {
+    Serial.println(F("Links: peer sent delivered retries streak/worst heard missed"));
+    for (uint8_t i = 0; i < LINK_STATS_PEERS; i++) {
+        const PeerLink &link = peers[i];
+        if (link.sent == 0 && link.heard == 0) {
+            continue;
+        }
+        Serial.print(F("  "));
+        Serial.print(i);
+        Serial.print(F(" "));
+        Serial.print(link.sent);
+        Serial.print(F(" "));
+        Serial.print(link.delivered);
+        Serial.print(F(" "));
+        Serial.print(link.retries);
+        Serial.print(F(" "));
+        Serial.print(link.failureStreak);
+        Serial.print(F("/"));
+        Serial.print(link.worstFailureStreak);
+        Serial.print(F(" "));
+        Serial.print(link.heard);
+        Serial.print(F(" "));
+        Serial.println(link.missed);
+    }
+}
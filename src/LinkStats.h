@@ -0,0 +1,56 @@
+#ifndef link_stats_h
+#define link_stats_h
+
+#include <Arduino.h>
+#include "Constants.h"
+#include "Ids.h"
+
+/**
+ * Counts are halved once sent or heard reaches this, so the numbers always
+ * describe the last few hundred frames rather than all time.
+ */
+const uint8_t LINK_STATS_WINDOW = 128;
+
+/**
+ * A gap in a peer's message ids bigger than this is a reboot, not loss.
+ */
+const uint8_t MAX_MISSED_MESSAGE_GAP = 32;
+
+struct PeerLink {
+    uint8_t sent = 0;        // Frames we sent to this peer
+    uint8_t delivered = 0;   // ...that the chip got an ACK for
+    uint8_t retries = 0;     // Auto retransmits the chip needed (OBSERVE_TX)
+    uint8_t failureStreak = 0;
+    uint8_t worstFailureStreak = 0;
+    uint8_t heard = 0;       // Frames we received from this peer
+    uint8_t missed = 0;      // Gaps in its message ids
+    uint8_t lastMessageId = 0;
+};
+
+/**
+ * The dust collector and the gateway keep an entry for every possible node;
+ * other nodes only keep broadcasts and the dust collector.
+ */
+const uint8_t LINK_STATS_PEERS = mode == DUST_COLLECTOR || mode == GATEWAY ? FIRST_NODE_ADDRESS + MAX_NODES : DUST_COLLECTOR_ADDRESS + 1;
+
+/**
+ * Link quality for each peer, indexed directly by short address.  Broadcasts
+ * count against ADDRESS_UNSET.
+ */
+class LinkStats {
+    public:
+        void recordSent(uint8_t peer, bool delivered, uint8_t retries);
+        void recordReceived(uint8_t peer, unsigned long messageId);
+        /**
+         * All peers added together.
+         */
+        PeerLink totals() const;
+        void halve();
+        void report() const;
+    private:
+        PeerLink peers[LINK_STATS_PEERS];
+
+        static void halve(PeerLink &link);
+};
+
+#endif
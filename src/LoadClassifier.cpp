@@ -0,0 +1,112 @@
+#include "LoadClassifier.h"
+
+void LoadClassifier::startCycle() {
+    sum = 0;
+    sumSquares = 0;
+    h1[0] = h1[1] = 0;
+    h3[0] = h3[1] = 0;
+}
+
+void LoadClassifier::goertzel(long *s, int16_t coeff, int x) {
+    long next = x + ((coeff * s[0]) >> GOERTZEL_SHIFT) - s[1];
+    s[1] = s[0];
+    s[0] = next;
+}
+
+unsigned long LoadClassifier::goertzelPower(const long *s, int16_t coeff) {
+    // Scaled down first so the products fit in a long.
+    long a = s[0] >> 4;
+    long b = s[1] >> 4;
+    long power = a * a + b * b - ((coeff * a) >> GOERTZEL_SHIFT) * b;
+    return power > 0 ? power : 0;
+}
+
+void LoadClassifier::addSample(int reading) {
+    int x = reading - dcOffset;
+    sum += reading;
+    sumSquares += (long) x * x;
+    goertzel(h1, GOERTZEL_COEFF_H1, x);
+    goertzel(h3, GOERTZEL_COEFF_H3, x);
+}
+
+void LoadClassifier::endCycle(bool running) {
+    // The sensor sits at half supply, give or take.  Follow it from cycle to cycle.
+    dcOffset = sum / LOAD_SAMPLES_PER_CYCLE;
+    unsigned long cyclePower = sumSquares / LOAD_SAMPLES_PER_CYCLE;
+    unsigned long fundamental = goertzelPower(h1, GOERTZEL_COEFF_H1);
+    unsigned long third = goertzelPower(h3, GOERTZEL_COEFF_H3);
+    unsigned int cycleDistortion = fundamental > 0 ? min(third * 256 / fundamental, 65535UL) : 0;
+    // An eighth of the way each cycle, so one odd cycle doesn't decide anything.
+    power += ((long) cyclePower - (long) power) / 8;
+    distortion += ((long) cycleDistortion - (long) distortion) / 8;
+
+    if (!running) {
+        state = LOAD_UNKNOWN;
+        startTime = VALUE_UNSET;
+        return;
+    }
+    if (startTime == VALUE_UNSET) {
+        startTime = millis();
+        changeTime = VALUE_UNSET;
+    }
+    if ((startTime + LOAD_SETTLE_MS) > millis()) {
+        return;
+    }
+    if (state == LOAD_UNKNOWN) {
+        spinPower = power;
+        spinDistortion = distortion;
+        state = LOAD_IDLE;
+        return;
+    }
+    if (state == LOAD_IDLE) {
+        // Follow the spin level down at once and up slowly, as the motor
+        // and belts warm up.
+        if (power < spinPower) {
+            spinPower = power;
+        } else {
+            spinPower += (power - spinPower) / 256;
+        }
+        spinDistortion += ((long) distortion - (long) spinDistortion) / 256;
+    }
+
+    bool cutting = looksLikeCutting();
+    if (cutting == (state == LOAD_CUTTING)) {
+        changeTime = VALUE_UNSET;
+        return;
+    }
+    if (changeTime == VALUE_UNSET) {
+        changeTime = millis();
+    } else if ((changeTime + (cutting ? LOAD_CUTTING_HOLD_MS : LOAD_IDLE_HOLD_MS)) <= millis()) {
+        state = cutting ? LOAD_CUTTING : LOAD_IDLE;
+        changeTime = VALUE_UNSET;
+    }
+}
+
+bool LoadClassifier::looksLikeCutting() const {
+    if (power > spinPower + spinPower / 100 * LOAD_POWER_ABOVE_SPIN_PERCENT) {
+        return true;
+    }
+    return spinDistortion > 0 && distortion < (unsigned long) spinDistortion * LOAD_DISTORTION_BELOW_SPIN_PERCENT / 100;
+}
+
+void LoadClassifier::report() const {
+    Serial.print(F("Load: "));
+    switch (state) {
+        case LOAD_IDLE:
+            Serial.print(F("idle"));
+            break;
+        case LOAD_CUTTING:
+            Serial.print(F("cutting"));
+            break;
+        default:
+            Serial.print(F("unknown"));
+    }
+    Serial.print(F(" power: "));
+    Serial.print(power);
+    Serial.print(F(" spin: "));
+    Serial.print(spinPower);
+    Serial.print(F(" distortion: "));
+    Serial.print(distortion);
+    Serial.print(F(" spin: "));
+    Serial.println(spinDistortion);
+}
@@ -0,0 +1,83 @@
+#ifndef load_classifier_h
+#define load_classifier_h
+
+#include <Arduino.h>
+#include "Constants.h"
+
+/**
+ * Samples per mains cycle, evenly spaced so the Goertzel bins land exactly on
+ * the fundamental and its harmonics.  analogRead() takes about 112us, so this
+ * leaves time for the filters between samples.
+ */
+const uint8_t LOAD_SAMPLES_PER_CYCLE = 32;
+const unsigned long LOAD_SAMPLE_INTERVAL_US = 1000000UL / (MAINS_HZ * LOAD_SAMPLES_PER_CYCLE);
+
+/**
+ * 2cos(2 pi k / N) in Q12 for the fundamental and the third harmonic.
+ */
+const int16_t GOERTZEL_COEFF_H1 = 8035;
+const int16_t GOERTZEL_COEFF_H3 = 6811;
+const uint8_t GOERTZEL_SHIFT = 12;
+
+/**
+ * Ignore everything for this long after the motor starts.  That's the inrush
+ * and spin up, and then the spin level we measure next is the idle one.
+ */
+const unsigned long LOAD_SETTLE_MS = 2000;
+
+/**
+ * Cutting draws this much more power (mean square current) than spinning
+ * free, or pulls the waveform this much closer to a pure sine: an idle
+ * induction motor's current is mostly magnetizing current, heavy in third
+ * harmonic, and load adds fundamental.
+ */
+const uint8_t LOAD_POWER_ABOVE_SPIN_PERCENT = 50;
+const uint8_t LOAD_DISTORTION_BELOW_SPIN_PERCENT = 70;
+
+/**
+ * How long a change has to last before we believe it.  Short to start cutting
+ * so the collector is up before the chips are, long to stop so a pause
+ * between passes doesn't count.
+ */
+const unsigned long LOAD_CUTTING_HOLD_MS = 100;
+const unsigned long LOAD_IDLE_HOLD_MS = 1500;
+
+/**
+ * Tells a machine spinning free from one that is cutting, from the shape of
+ * its current.  Each reading is one mains cycle of samples, run through an
+ * RMS sum and Goertzel filters at the fundamental and third harmonic, all in
+ * integers.  The spin level is learned each time the machine starts, so
+ * every machine works out its own.
+ */
+class LoadClassifier {
+    public:
+        void startCycle();
+        void addSample(int reading);
+        void endCycle(bool running);
+        LoadState getState() const { return state; }
+        void report() const;
+    private:
+        LoadState state = LOAD_UNKNOWN;
+        unsigned long startTime = VALUE_UNSET;
+        unsigned long changeTime = VALUE_UNSET;
+
+        // This cycle
+        int dcOffset = 512;
+        long sum = 0;
+        unsigned long sumSquares = 0;
+        long h1[2] = {0, 0};
+        long h3[2] = {0, 0};
+
+        // Smoothed over cycles
+        unsigned long power = 0;
+        // Third harmonic power relative to the fundamental, in 1/256ths.
+        unsigned int distortion = 0;
+        unsigned long spinPower = 0;
+        unsigned int spinDistortion = 0;
+
+        static void goertzel(long *s, int16_t coeff, int x);
+        static unsigned long goertzelPower(const long *s, int16_t coeff);
+        bool looksLikeCutting() const;
+};
+
+#endif
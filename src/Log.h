@@ -2,60 +2,109 @@
 #define log_h
 
 
-const void printId(unsigned long id) {
-  if (id == VALUE_UNSET) {
-    Serial.print("UNSET");
+const void printId(uint8_t id) {
+  if (id == ADDRESS_UNSET) {
+    Serial.print(F("UNSET"));
   } else {
     Serial.print(id);
   }
 }
 
 const void print(const Payload &payload) {
-  Serial.print("Payload {");
-  Serial.print(" messageId=");
+  Serial.print(F("Payload {"));
+  Serial.print(F(" messageId="));
   Serial.print(payload.messageId);
-  Serial.print(" id=");
+  Serial.print(F(" id="));
   printId(payload.id);
-  Serial.print(" toId=");
+  Serial.print(F(" toId="));
   printId(payload.toId);
-  Serial.print(" gateCode=");
+  Serial.print(F(" gateCode="));
   Serial.print(payload.gateCode);
-  Serial.print(" retryCount=");
+  Serial.print(F(" retryCount="));
   Serial.print(payload.retryCount);
-  Serial.print(" requestACK=");
+  Serial.print(F(" requestACK="));
   Serial.print(payload.requestACK);
-  Serial.print(" command=");
+  Serial.print(F(" data="));
+  Serial.print(payload.data);
+  Serial.print(F(" originAge="));
+  Serial.print(payload.originAge);
+  Serial.print(F(" load="));
+  Serial.print(payload.load);
+  Serial.print(F(" demand="));
+  Serial.print(payload.demand);
+  Serial.print(F(" command="));
   switch (payload.command) {
     case RUNNING:
-      Serial.print("RUNNING");
+      Serial.print(F("RUNNING"));
       break;
     case NO_LONGER_RUNNING:
-      Serial.print("NO_LONGER_RUNNING");
+      Serial.print(F("NO_LONGER_RUNNING"));
       break;
     case HELLO_WORLD:
-      Serial.print("HELLO_WORLD");
+      Serial.print(F("HELLO_WORLD"));
       break;
     case WELCOME:
-      Serial.print("WELCOME");
+      Serial.print(F("WELCOME"));
       break;
     case ACK:
-        Serial.print("ACK");
+        Serial.print(F("ACK"));
+        break;
+    case HEARTBEAT:
+        Serial.print(F("HEARTBEAT"));
+        break;
+    case BEACON:
+        Serial.print(F("BEACON"));
+        break;
+    case CHANNEL_CHANGE:
+        Serial.print(F("CHANNEL_CHANGE"));
+        break;
+    case CONFIG_CHUNK:
+        Serial.print(F("CONFIG_CHUNK"));
+        break;
+    case CONFIG_STATUS:
+        Serial.print(F("CONFIG_STATUS"));
+        break;
+    case COLLECTOR_INFO:
+        Serial.print(F("COLLECTOR_INFO"));
+        break;
+    case COLLECTOR_ASSIGN:
+        Serial.print(F("COLLECTOR_ASSIGN"));
         break;
     case UNKNOWN:
-        Serial.print("UNKNOWN");
+        Serial.print(F("UNKNOWN"));
         break;
     default:
-      Serial.print("UNDEFINED");
+      Serial.print(F("UNDEFINED"));
   }
-  // Serial.print(" debug=");
+  // Serial.print(F(" debug="));
   // Serial.print(payload.debugMessage);
-  Serial.print(" ");
-  Serial.print(" }");
+  Serial.print(F(" "));
+  Serial.print(F(" }"));
 }
 
 const void println(const Payload &payload) {
   print(payload);
-  Serial.println(" ");
+  Serial.println(F(" "));
+}
+
+/**
+ * One line per frame for tools/replay_traffic.py: the time, R (heard) or T
+ * (sent), and the raw bytes in hex.
+ */
+const void printFrame(char direction, const Payload &payload) {
+  Serial.print(F("@"));
+  Serial.print(millis());
+  Serial.print(F(" "));
+  Serial.print(direction);
+  Serial.print(F(" "));
+  const uint8_t *bytes = (const uint8_t *) &payload;
+  for (uint8_t i = 0; i < sizeof(Payload); i++) {
+    if (bytes[i] < 0x10) {
+      Serial.print(F("0"));
+    }
+    Serial.print(bytes[i], HEX);
+  }
+  Serial.println();
 }
 
 
@@ -0,0 +1,50 @@
+#include "PinChange.h"
+#include <avr/interrupt.h>
+#include "GatePins.h"
+#include "FastPin.h"
+
+volatile bool serialPinChanged = false;
+volatile bool gateCodePinChanged = false;
+volatile bool radioWoke = false;
+
+static_assert(GATE_CODE_PORT_D_MASK == (FastPin<BRANCH_PINS[0]>::mask | FastPin<BRANCH_PINS[1]>::mask
+        | FastPin<BRANCH_PINS[2]>::mask | FastPin<BRANCH_PINS[3]>::mask), "Branch pins moved off port D");
+static_assert(WIRELESS_IRQ_PIN < 8, "Radio IRQ moved off port D");
+
+static volatile uint8_t lastPortD = 0;
+
+ISR(PCINT2_vect) {
+    uint8_t now = PIND;
+    uint8_t changed = (now ^ lastPortD) & PCMSK2;
+    lastPortD = now;
+    if (changed & FastPin<SERIAL_RX_PIN>::mask) {
+        serialPinChanged = true;
+    }
+    if (changed & GATE_CODE_PORT_D_MASK) {
+        gateCodePinChanged = true;
+    }
+    // Only the falling edge.  It goes back up when we read the frame.
+    if ((changed & FastPin<WIRELESS_IRQ_PIN>::mask) && !(now & FastPin<WIRELESS_IRQ_PIN>::mask)) {
+        radioWoke = true;
+    }
+}
+
+void enablePinChange(uint8_t portDMask) {
+    uint8_t oldSREG = SREG;
+    cli();
+    lastPortD = PIND;
+    PCMSK2 |= portDMask;
+    PCIFR = _BV(PCIE2);
+    PCICR |= _BV(PCIE2);
+    SREG = oldSREG;
+}
+
+void disablePinChange(uint8_t portDMask) {
+    uint8_t oldSREG = SREG;
+    cli();
+    PCMSK2 &= ~portDMask;
+    if (PCMSK2 == 0) {
+        PCICR &= ~_BV(PCIE2);
+    }
+    SREG = oldSREG;
+}
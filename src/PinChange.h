@@ -0,0 +1,26 @@
+#ifndef pin_change_h
+#define pin_change_h
+
+#include <Arduino.h>
+
+/**
+ * Port D has serial RX and the radio IRQ (both woken on by PowerManager) and
+ * the gate code switches, and they share one pin change interrupt.  The
+ * handler works out which changed and sets the matching flag.  Whoever reads
+ * a flag clears it.
+ */
+extern volatile bool serialPinChanged;
+extern volatile bool gateCodePinChanged;
+/**
+ * The radio pulled its IRQ line low.  A pin change is the only way it can
+ * wake us: INT0 only wakes from power down on a low level, not an edge.
+ */
+extern volatile bool radioWoke;
+
+/**
+ * Turns the pin change interrupt on for the given port D pins.
+ */
+void enablePinChange(uint8_t portDMask);
+void disablePinChange(uint8_t portDMask);
+
+#endif
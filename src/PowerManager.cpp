@@ -0,0 +1,90 @@
+#include "PowerManager.h"
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include <avr/interrupt.h>
+#include "Clock.h"
+#include "PinChange.h"
+#include "FastPin.h"
+#include "Watchdog.h"
+
+ISR(WDT_vect) {
+    // Only here to wake us.
+}
+
+void PowerManager::setup() {
+    pinMode(WIRELESS_IRQ_PIN, INPUT_PULLUP);
+}
+
+bool PowerManager::consoleActive() {
+    if (Serial.available() > 0) {
+        lastConsoleWakeTime = millis();
+    }
+    return lastConsoleWakeTime != VALUE_UNSET && (lastConsoleWakeTime + CONSOLE_AWAKE_MS) > millis();
+}
+
+void PowerManager::sleep() {
+    Serial.flush();
+    radioWoke = false;
+    serialPinChanged = false;
+
+    uint8_t adcsra = ADCSRA;
+    ADCSRA &= ~_BV(ADEN);
+    // Watchdog as an interrupt only, every 16ms.
+    cli();
+    wdt_reset();
+    MCUSR &= ~_BV(WDRF);
+    WDTCSR = _BV(WDCE) | _BV(WDE);
+    WDTCSR = _BV(WDIE);
+    sei();
+    // A change on RX means someone is typing.  The radio IRQ wakes us through
+    // the same pin change interrupt.
+    enablePinChange(FastPin<SERIAL_RX_PIN>::mask | FastPin<WIRELESS_IRQ_PIN>::mask);
+
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    unsigned long slept = 0;
+    while (slept < IDLE_MAX_SLEEP_MS) {
+        cli();
+        // The IRQ may have gone low before the pin change was on, and it
+        // stays low until we read the frame.
+        if (radioWoke || serialPinChanged || !FastPin<WIRELESS_IRQ_PIN>::read()) {
+            sei();
+            break;
+        }
+        sleep_enable();
+        sleep_bod_disable();
+        // sei() lets one more instruction run first, so an interrupt can't
+        // sneak in between the check above and going to sleep.
+        sei();
+        sleep_cpu();
+        sleep_disable();
+        // We can't tell how far into the tick an interrupt came, so call it half.
+        slept += radioWoke || serialPinChanged ? WATCHDOG_TICK_MS / 2 : WATCHDOG_TICK_MS;
+    }
+
+    disablePinChange(FastPin<SERIAL_RX_PIN>::mask | FastPin<WIRELESS_IRQ_PIN>::mask);
+    // Back to resetting us if we hang.
+    watchdog.start();
+    ADCSRA = adcsra;
+    // Timer0 stops in power down, so add the time we slept ourselves.
+    advanceMillis(slept);
+    asleepMs += slept;
+    if (serialPinChanged) {
+        lastConsoleWakeTime = millis();
+    }
+}
+
+void PowerManager::report() {
+    unsigned long now = millis();
+    if (now == 0) {
+        return;
+    }
+    unsigned long awakePercent = (now - asleepMs) * 100 / now;
+    unsigned long mcuUA = (MCU_ACTIVE_UA * awakePercent + MCU_SLEEP_UA * (100 - awakePercent)) / 100;
+    Serial.print(F("Awake "));
+    Serial.print(awakePercent);
+    Serial.print(F("% of the time.  Estimated current: "));
+    Serial.print((mcuUA + RADIO_RX_UA) / 1000.0);
+    Serial.print(F("mA ("));
+    Serial.print((MCU_ACTIVE_UA + RADIO_RX_UA) / 1000.0);
+    Serial.println(F("mA always awake)"));
+}
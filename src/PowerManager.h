@@ -0,0 +1,54 @@
+#ifndef power_manager_h
+#define power_manager_h
+
+#include <Arduino.h>
+#include "Constants.h"
+#include "GatePins.h"
+
+/**
+ * The longest we sleep before going around loop() again, so timers like the
+ * branch gate close delay and the lease heartbeat are at most this late.
+ */
+const unsigned long IDLE_MAX_SLEEP_MS = 1000;
+
+/**
+ * The watchdog wakes us this often while asleep so we can keep millis()
+ * roughly right (it stops with the clock).  It runs within about 10%.
+ */
+const unsigned long WATCHDOG_TICK_MS = 16;
+
+/**
+ * The UART can't wake us, so the first character only wakes us up.  After
+ * that we stay awake this long so the rest of the line gets through.
+ */
+const unsigned long CONSOLE_AWAKE_MS = 30000;
+
+/**
+ * Rough supply current of each part, for estimating battery life.  The
+ * radio has to stay in RX to hear RUNNING, so it draws the same either way.
+ */
+const unsigned long MCU_ACTIVE_UA = 12000;
+const unsigned long MCU_SLEEP_UA = 10;
+const unsigned long RADIO_RX_UA = 13500;
+
+/**
+ * Puts the MCU in power down between events on battery powered nodes.  We
+ * wake on the radio IRQ (only RX_DR is unmasked), on serial input, or on a
+ * watchdog tick.
+ */
+class PowerManager {
+    public:
+        void setup();
+        /**
+         * Call when there is nothing to do.  Returns after something happens
+         * or IDLE_MAX_SLEEP_MS.
+         */
+        void sleep();
+        bool consoleActive();
+        void report();
+    private:
+        unsigned long asleepMs = 0;
+        unsigned long lastConsoleWakeTime = VALUE_UNSET;
+};
+
+#endif
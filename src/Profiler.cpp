@@ -0,0 +1,162 @@
+#include "Profiler.h"
+
+Profiler profiler;
+
+#if defined(__AVR__)
+extern char *__brkval;
+extern char __heap_start;
+
+const uint8_t STACK_PAINT = 0xA5;
+
+/**
+ * Runs before main(), once the stack pointer is set up and before anything
+ * is on the stack.  Everything from the end of the static data up to the
+ * stack gets a pattern, and neverUsedMemory() counts how much of it is still
+ * there.  Nothing uses the heap, so the stack is the only thing that eats
+ * into it.
+ */
+void paintStack() __attribute__((naked, used, section(".init3")));
+void paintStack() {
+    uint8_t *p = (uint8_t *) &__heap_start;
+    while (p < (uint8_t *) SP) {
+        *p++ = STACK_PAINT;
+    }
+}
+#endif
+
+const char PROBE_NAMES[PROBE_COUNT][16] PROGMEM = {
+    "loop",
+    "getMessage",
+    "processCommand",
+    "broadcast",
+    "currentAmps",
+    "currentGateCode",
+};
+
+const char COUNTER_NAMES[COUNTER_COUNT][16] PROGMEM = {
+    "servoAttaches",
+    "servoReseats",
+    "servoAttachedMs",
+};
+
+void Profiler::record(Probe probe, unsigned long micros) {
+    ProbeStats &probeStats = stats[probe];
+    probeStats.count++;
+    probeStats.totalMicros += micros;
+    if (micros > probeStats.maxMicros) {
+        probeStats.maxMicros = micros;
+    }
+}
+
+void Profiler::onLoop() {
+    if (!memoryWarned && (lastMemoryCheckTime + MEMORY_CHECK_INTERVAL_MS) < millis()) {
+        lastMemoryCheckTime = millis();
+        unsigned int neverUsed = neverUsedMemory();
+        if (neverUsed < MIN_FREE_SRAM) {
+            memoryWarned = true;
+            Serial.print(F("Stack came within "));
+            Serial.print(neverUsed);
+            Serial.println(F(" bytes of the static data"));
+        }
+    }
+    if (!PROFILE_HOT_PATHS) {
+        return;
+    }
+    int free = freeMemory();
+    if (free < minFreeMemory) {
+        minFreeMemory = free;
+    }
+    if ((lastReportTime + PROFILE_REPORT_INTERVAL_MS) < millis()) {
+        lastReportTime = millis();
+        report();
+        reset();
+    }
+}
+
+void Profiler::report() {
+    Serial.println(F("Profile: probe count avgNs maxUs"));
+    for (int i = 0; i < PROBE_COUNT; i++) {
+        if (stats[i].count == 0) {
+            continue;
+        }
+        Serial.print(F("  "));
+        Serial.print((const __FlashStringHelper *) PROBE_NAMES[i]);
+        Serial.print(F(" "));
+        Serial.print(stats[i].count);
+        Serial.print(F(" "));
+        // micros() only has 4us resolution, so this is an average over many calls.
+        Serial.print((unsigned long) ((stats[i].totalMicros * 1000.0) / stats[i].count));
+        Serial.print(F(" "));
+        Serial.println(stats[i].maxMicros);
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        Serial.print(F("  "));
+        Serial.print((const __FlashStringHelper *) COUNTER_NAMES[i]);
+        Serial.print(F(" "));
+        Serial.println(counters[i]);
+    }
+    if (millis() > lastResetTime) {
+        // How much of this period the servos were powered, in percent.
+        Serial.print(F("  servoDuty "));
+        Serial.println(counters[COUNTER_SERVO_ATTACHED_MS] * 100 / (millis() - lastResetTime));
+    }
+    Serial.print(F("  freeMemory now="));
+    Serial.print(freeMemory());
+    Serial.print(F(" min="));
+    Serial.print(minFreeMemory);
+    Serial.print(F(" neverUsed="));
+    Serial.print(neverUsedMemory());
+    Serial.print(F(" stackPeak="));
+    Serial.print(stackPeak());
+    Serial.print(F(" margin="));
+    Serial.println(MIN_FREE_SRAM);
+}
+
+void Profiler::reset() {
+    for (int i = 0; i < PROBE_COUNT; i++) {
+        stats[i] = ProbeStats();
+    }
+    for (int i = 0; i < COUNTER_COUNT; i++) {
+        counters[i] = 0;
+    }
+    lastResetTime = millis();
+}
+
+#if defined(__AVR__)
+int Profiler::freeMemory() {
+    char top;
+    if (__brkval == 0) {
+        return &top - &__heap_start;
+    }
+    return &top - __brkval;
+}
+
+unsigned int Profiler::neverUsedMemory() {
+    const uint8_t *p = (const uint8_t *) &__heap_start;
+    unsigned int count = 0;
+    while (p + count < (const uint8_t *) SP && p[count] == STACK_PAINT) {
+        count++;
+    }
+    return count;
+}
+
+unsigned int Profiler::stackPeak() {
+    // Everything from the static data to the end of SRAM that has been written.
+    return (RAMEND + 1) - (unsigned int) &__heap_start - neverUsedMemory();
+}
+#else
+/**
+ * Off the device (the native tests) there is no SRAM to run short of.
+ */
+int Profiler::freeMemory() {
+    return INT_MAX;
+}
+
+unsigned int Profiler::neverUsedMemory() {
+    return UINT_MAX;
+}
+
+unsigned int Profiler::stackPeak() {
+    return 0;
+}
+#endif
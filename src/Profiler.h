@@ -0,0 +1,97 @@
+#ifndef profiler_h
+#define profiler_h
+
+#include <Arduino.h>
+#include <limits.h>
+#include "Constants.h"
+
+const unsigned long PROFILE_REPORT_INTERVAL_MS = 60000;
+
+/**
+ * How often we check that the stack has left MIN_FREE_SRAM untouched.
+ */
+const unsigned long MEMORY_CHECK_INTERVAL_MS = 60000;
+
+enum Probe {
+    PROBE_LOOP,
+    PROBE_GET_MESSAGE,
+    PROBE_PROCESS_COMMAND,
+    PROBE_BROADCAST,
+    PROBE_CURRENT,
+    PROBE_GATE_CODE,
+    PROBE_COUNT
+};
+
+/**
+ * Things we count rather than time.
+ */
+enum Counter {
+    COUNTER_SERVO_ATTACHES,
+    COUNTER_SERVO_RESEATS,
+    COUNTER_SERVO_ATTACHED_MS,
+    COUNTER_COUNT
+};
+
+struct ProbeStats {
+    unsigned long count = 0;
+    unsigned long totalMicros = 0;
+    unsigned long maxMicros = 0;
+};
+
+/**
+ * Times the hot paths on the device itself so we can see regressions before
+ * a build goes out to the shop.  Does nothing unless PROFILE_HOT_PATHS is on.
+ */
+class Profiler {
+    public:
+        void record(Probe probe, unsigned long micros);
+        void count(Counter counter, unsigned long amount = 1) { counters[counter] += amount; }
+        void onLoop();
+        void report();
+        void reset();
+        /**
+         * Free SRAM between the top of the heap and the stack.
+         */
+        static int freeMemory();
+        /**
+         * SRAM above the static data that nothing has written since boot, so
+         * the least there has ever been free (see paintStack()).
+         */
+        static unsigned int neverUsedMemory();
+        /**
+         * The most stack used since boot, for checking STACK_RESERVE.
+         */
+        static unsigned int stackPeak();
+    private:
+        ProbeStats stats[PROBE_COUNT];
+        unsigned long counters[COUNTER_COUNT] = {0};
+        unsigned long lastResetTime = 0;
+        int minFreeMemory = INT_MAX;
+        unsigned long lastReportTime = 0;
+        unsigned long lastMemoryCheckTime = 0;
+        bool memoryWarned = false;
+};
+
+extern Profiler profiler;
+
+/**
+ * Records the time from construction to the end of the enclosing scope.
+ */
+class ScopedProbe {
+    public:
+        ScopedProbe(Probe probe) : probe(probe) {
+            if (PROFILE_HOT_PATHS) {
+                startMicros = micros();
+            }
+        }
+        ~ScopedProbe() {
+            if (PROFILE_HOT_PATHS) {
+                profiler.record(probe, micros() - startMicros);
+            }
+        }
+    private:
+        const Probe probe;
+        unsigned long startMicros = 0;
+};
+
+#endif
@@ -1,20 +1,125 @@
 #include "RadioController.h"
 #include <limits.h>
 #include "Log.h"
+#include "Profiler.h"
+#include "Latency.h"
+#include "EepromLayout.h"
+#include "Config.h"
+#include "Faults.h"
+#include <EEPROM.h>
 
 const bool LOG_OUTGOING_ACKS = true;
 
-void RadioController::setup() {
+void RadioController::setup(bool blockUntilStarted) {
+    channel = config.get().channel;
     replyToAcks = mode == DUST_COLLECTOR;
+    this->blockUntilStarted = blockUntilStarted;
+    loadChannel();
     configureRadio();
 }
 
+void RadioController::loadChannel() {
+    uint8_t saved[4];
+    for (uint8_t i = 0; i < 4; i++) {
+        saved[i] = EEPROM.read(EEPROM_CHANNEL_ADDRESS + i);
+    }
+    // Each value is followed by its inverse so a blank EEPROM doesn't look valid.
+    if (saved[0] <= MAX_CHANNEL && saved[1] == (uint8_t) ~saved[0]
+            && saved[2] <= RF24_250KBPS && saved[3] == (uint8_t) ~saved[2]) {
+        channel = saved[0];
+        dataRate = (rf24_datarate_e) saved[2];
+    }
+    Serial.print(F("Using channel: "));
+    Serial.print(channel);
+    Serial.print(F(" data rate: "));
+    Serial.println(dataRate);
+}
+
+void RadioController::setChannel(uint8_t channel, rf24_datarate_e dataRate, bool save) {
+    if (channel > MAX_CHANNEL || dataRate > RF24_250KBPS) {
+        return;
+    }
+    if (this->channel != channel || this->dataRate != dataRate) {
+        Serial.print(F("Switching to channel: "));
+        Serial.print(channel);
+        Serial.print(F(" data rate: "));
+        Serial.println(dataRate);
+        this->channel = channel;
+        this->dataRate = dataRate;
+        radio.stopListening();
+        radio.setChannel(channel);
+        radio.setDataRate(dataRate);
+        radio.startListening();
+    }
+    if (save) {
+        EEPROM.update(EEPROM_CHANNEL_ADDRESS, channel);
+        EEPROM.update(EEPROM_CHANNEL_ADDRESS + 1, ~channel);
+        EEPROM.update(EEPROM_CHANNEL_ADDRESS + 2, dataRate);
+        EEPROM.update(EEPROM_CHANNEL_ADDRESS + 3, ~dataRate);
+    }
+}
+
+void RadioController::setPALevel(uint8_t paLevel) {
+    if (paLevel > RF24_PA_MAX || this->paLevel == paLevel) {
+        return;
+    }
+    Serial.print(F("Setting PA level: "));
+    Serial.println(paLevel);
+    this->paLevel = paLevel;
+    radio.setPALevel(paLevel);
+}
+
+uint8_t RadioController::sampleChannel(uint8_t otherChannel, uint8_t samples) {
+    uint8_t busy = 0;
+    radio.stopListening();
+    radio.setChannel(otherChannel);
+    for (uint8_t i = 0; i < samples; i++) {
+        radio.startListening();
+        delayMicroseconds(RPD_DWELL_US);
+        radio.stopListening();
+        if (radio.testRPD()) {
+            busy++;
+        }
+    }
+    radio.setChannel(channel);
+    radio.startListening();
+    return busy;
+}
+
 void RadioController::onLoop() {
+    if (radio.failureDetected && !blockUntilStarted
+        && (lastStartAttemptTime + RADIO_START_RETRY_DELAY_MS) > millis()) {
+        // Still waiting to retry starting the radio.
+        return;
+    }
     if (radioFailed()) {
-        Serial.println("Radio failure detected.");
+        Serial.println(F("Radio failure detected."));
         radio.failureDetected = true;
         configureRadio();
     }
+    if (FAULT_INJECTION && !radio.failureDetected) {
+        faults->onRadioHealthy();
+    }
+    if (CSMA && !radio.failureDetected) {
+        sendPending();
+    }
+}
+
+void RadioController::injectRadioFault(bool brownOut) {
+    if (!FAULT_INJECTION) {
+        return;
+    }
+    if (brownOut) {
+        Serial.println(F("Fault: radio brown out"));
+        radio.setPALevel(RF24_PA_MAX);
+        radio.setDataRate(RF24_2MBPS);
+        radio.setCRCLength(RF24_CRC_8);
+        radio.powerDown();
+    } else {
+        Serial.println(F("Fault: radio PA level register changed"));
+        radio.setPALevel(paLevel == RF24_PA_MIN ? RF24_PA_LOW : RF24_PA_MIN);
+    }
+    faults->onRadioFault();
 }
 
 void RadioController::configureRadio() {
@@ -23,21 +128,33 @@ void RadioController::configureRadio() {
   // while (!radio.begin()) {
     statusController.setRadioInFailure(true);
     Serial.print(millis() / 1000);
-    Serial.println(" Waiting for radio to start");
+    Serial.println(F(" Waiting for radio to start"));
     // radio.printDetails();
+    if (!blockUntilStarted) {
+      radio.failureDetected = true;
+      lastStartAttemptTime = millis();
+      return;
+    }
     delay(500);
   }
-  radio.setPALevel(RADIO_POWER_LEVEL);
-  radio.setChannel(CHANNEL);
+  radio.setPALevel(paLevel);
+  radio.setChannel(channel);
   radio.setAutoAck(false);
 
-  if (!radio.setDataRate(RADIO_DATA_RATE)) {
-    Serial.println("Could not set the data rate");
+  if (!radio.setDataRate(dataRate)) {
+    Serial.println(F("Could not set the data rate"));
     statusController.setRadioInFailure(true);
     radio.failureDetected = true;
     return;
   }
   radio.setPayloadSize(payloadSize);
+  if (LOW_POWER_IDLE) {
+    // Only pull the IRQ line for received frames.  That's what wakes us.
+    radio.maskIRQ(true, true, false);
+  }
+  if (CSMA) {
+    radio.setRetries(random(MIN_RETRANSMIT_DELAY, MAX_RETRANSMIT_DELAY + 1), RETRANSMIT_COUNT);
+  }
   
   radio.setCRCLength(CRC_LENGTH);
   // radio.flush_rx();
@@ -48,7 +165,8 @@ void RadioController::configureRadio() {
     radio.openReadingPipe(ACK_PIPE, ackAddress);
   }
 
-  if (USE_CHIP_ACK) {
+  // A listener that ACKed would make frames the collector missed look delivered.
+  if (USE_CHIP_ACK && Role::transmits) {
     radio.setAutoAck(true);
     // radio.enableDynamicAck();
     // radio.enableDynamicPayloads();
@@ -70,28 +188,28 @@ void RadioController::configureRadio() {
 
   radio.startListening();
   statusController.setRadioInFailure(false);
-  // Serial.println("------------ After Configure -----------");
+  // Serial.println(F("------------ After Configure -----------"));
   // radio.printPrettyDetails();
-  // Serial.println("----------------------------------------");
+  // Serial.println(F("----------------------------------------"));
 }
 
 bool RadioController::radioFailed() {
   if (radio.failureDetected 
-      || radio.getDataRate() != RADIO_DATA_RATE 
-      || radio.getPALevel() != RADIO_POWER_LEVEL
+      || radio.getDataRate() != dataRate 
+      || radio.getPALevel() != paLevel
       || radio.getCRCLength() != CRC_LENGTH) {
         if (radio.failureDetected) {
-          Serial.print("Failure from internal boolean.   ");
-        } else if (radio.getDataRate() != RADIO_DATA_RATE) {
-          Serial.print("Failure from data rate change.   ");
-        } else if (radio.getPALevel() != RADIO_POWER_LEVEL) {
-          Serial.print("Failure from power level.   ");
+          Serial.print(F("Failure from internal boolean.   "));
+        } else if (radio.getDataRate() != dataRate) {
+          Serial.print(F("Failure from data rate change.   "));
+        } else if (radio.getPALevel() != paLevel) {
+          Serial.print(F("Failure from power level.   "));
         } else {
-          Serial.print("Failure from unknown.   ");
+          Serial.print(F("Failure from unknown.   "));
         }
-    // Serial.println("-------------- After Failure -----------");
+    // Serial.println(F("-------------- After Failure -----------"));
     // radio.printPrettyDetails();
-    // Serial.println("----------------------------------------");
+    // Serial.println(F("----------------------------------------"));
     radio.failureDetected = true;
     statusController.setRadioInFailure(true);
     return true;
@@ -107,33 +225,102 @@ unsigned long RadioController::getNextMessageId() {
     return messageId;
 }
 
-bool RadioController::getMessage(Payload &received) {
-    uint8_t incomingPipe;
-    if (radio.available(&incomingPipe)) {
+void RadioController::inject(const Payload &payload) {
+    injected = payload;
+    hasInjected = true;
+}
+
+bool RadioController::readFrame(Payload &received) {
+    bool released = false;
+    if (FAULT_INJECTION && hasDelayed) {
+        if (delayedUntil > millis()) {
+            return false;
+        }
+        received = delayed;
+        hasDelayed = false;
+        released = true;
+    } else if (TRAFFIC_REPLAY) {
+        if (!hasInjected) {
+            return false;
+        }
+        received = injected;
+        hasInjected = false;
+    } else {
+        uint8_t incomingPipe;
+        if (!radio.available(&incomingPipe)) {
+            return false;
+        }
+        if (mode == GATEWAY && radio.rxFifoFull()) {
+            rxOverflows++;
+        }
         radio.read(&received, (dynamicPayloadsEnabled) ? radio.getDynamicPayloadSize() : payloadSize);
+    }
+    if (FAULT_INJECTION && !released && !injectReceiveFaults(received)) {
+        return false;
+    }
+    if (RECORD_TRAFFIC || TRAFFIC_REPLAY) {
+        printFrame('R', received);
+    }
+    if (frameListener != NULL) {
+        frameListener(received);
+    }
+    return true;
+}
 
+bool RadioController::injectReceiveFaults(Payload &received) {
+    if (faults->roll(FAULT_DROP_RX)) {
+        Serial.println(F("Fault: dropped incoming frame"));
+        return false;
+    }
+    if (faults->roll(FAULT_CORRUPT_RX)) {
+        Serial.println(F("Fault: corrupted incoming frame"));
+        faults->flipBit(&received, sizeof(received));
+    }
+    if (faults->get(FAULT_DELAY_RX) > 0) {
+        delayed = received;
+        hasDelayed = true;
+        delayedUntil = millis() + faults->get(FAULT_DELAY_RX);
+        return false;
+    }
+    return true;
+}
+
+bool RadioController::getMessage(Payload &received) {
+    ScopedProbe probe(PROBE_GET_MESSAGE);
+    if (readFrame(received)) {
         if (received.messageId == 0 || received.command == UNKNOWN) {
             // Received a blank message.  Just ignore.
-            Serial.println("Received blank message");
+            Serial.println(F("Received blank message"));
             return false;
         }
         
-        Serial.print(millis() / 1000.0);
-        Serial.print(" Received: ");
-        println(received);
+        if (LOG_FRAMES) {
+            Serial.print(millis() / 1000.0);
+            Serial.print(F(" Received: "));
+            println(received);
+        }
         maybeAck(received);
+        linkStats.recordReceived(received.id, received.messageId);
+        // The gateway never talks, so hearing any leased node is as good as
+        // hearing the collector: we're on the network's channel.
+        if (received.id == DUST_COLLECTOR_ADDRESS || (mode == GATEWAY && received.id != ADDRESS_UNSET)) {
+            lastCollectorContactTime = millis();
+        }
 
-        unsigned long myId = ids.getID();
-        if (received.id == myId && myId != VALUE_UNSET) {
-            Serial.println("Received id was same as my own id.  Ignoring.");
+        uint8_t myAddress = ids.getAddress();
+        if (received.id == myAddress && myAddress != ADDRESS_UNSET) {
+            Serial.println(F("Received id was same as my own id.  Ignoring."));
             return false;
         }
-        if (received.toId != VALUE_UNSET && received.toId != ids.getID()) {
-            Serial.print("Message was directed to another id: ");
-            printId(received.id);
-            Serial.print(" vs my id: ");
-            printId(myId);
-            Serial.println(" Ignoring command");
+        bool isMyLease = received.command == WELCOME && received.data == ids.getID();
+        if (received.toId != ADDRESS_UNSET && received.toId != myAddress && !isMyLease) {
+            if (LOG_FRAMES) {
+                Serial.print(F("Message was directed to another id: "));
+                printId(received.toId);
+                Serial.print(F(" vs my id: "));
+                printId(myAddress);
+                Serial.println(F(" Ignoring command"));
+            }
             return false;
         }
         return true;
@@ -145,26 +332,117 @@ bool RadioController::broadcastCommand(Command command) {
     return broadcastCommand(command, false);
 }
 
-bool RadioController::broadcastCommand(Command command, boolean ack) {
-    if (command == RUNNING) {
-      ids.populateId();
-    }
-
+bool RadioController::broadcastCommand(Command command, boolean ack, unsigned long data, LoadState load, uint8_t demand) {
     Payload sendPayload;
     sendPayload.messageId = getNextMessageId();
     sendPayload.command = command;
-    sendPayload.id = ids.getID();
+    sendPayload.id = ids.getAddress();
     sendPayload.gateCode = ids.currentGateCode();
     sendPayload.requestACK = ack;
+    sendPayload.data = data;
+    sendPayload.load = load;
+    sendPayload.demand = demand;
+    if (command == HELLO_WORLD || command == HEARTBEAT) {
+      sendPayload.data = ids.getID();
+    }
 
     return broadcastCommand(sendPayload);   
 }
 
+bool RadioController::sendTo(uint8_t toId, Command command, unsigned long data) {
+    Payload sendPayload;
+    sendPayload.messageId = getNextMessageId();
+    sendPayload.command = command;
+    sendPayload.id = ids.getAddress();
+    sendPayload.toId = toId;
+    sendPayload.gateCode = ids.currentGateCode();
+    sendPayload.data = data;
+
+    return broadcastCommand(sendPayload);
+}
+
 bool RadioController::broadcastCommand(Payload &payload) {
+  // ACKs answer a frame that just ended, so they go straight out.
+  if (!CSMA || TRAFFIC_REPLAY || payload.command == ACK || (pendingCount == 0 && channelClear())) {
+    return transmit(payload);
+  }
+  if (pendingCount >= CSMA_QUEUE_SIZE) {
+    Serial.println(F("Transmit queue full.  Dropping message"));
+    return false;
+  }
+  PendingFrame &frame = pending[(pendingHead + pendingCount) % CSMA_QUEUE_SIZE];
+  pendingCount++;
+  frame.payload = payload;
+  frame.attempts = 0;
+  backOff(frame);
+  return false;
+}
+
+bool RadioController::channelClear() {
+  // The received power detector only means something after 170us in RX, and
+  // only latches when we leave it.
+  radio.stopListening();
+  radio.startListening();
+  delayMicroseconds(RPD_DWELL_US);
+  radio.stopListening();
+  bool clear = !radio.testRPD();
+  radio.startListening();
+  return clear;
+}
+
+void RadioController::backOff(PendingFrame &frame) {
+  frame.attempts++;
+  unsigned long window = CSMA_SLOT_MS << min(frame.attempts, CSMA_MAX_BACKOFF_EXPONENT);
+  frame.nextAttemptTime = millis() + random(window) + 1;
+}
+
+void RadioController::sendPending() {
+  if (pendingCount == 0) {
+    return;
+  }
+  PendingFrame &frame = pending[pendingHead];
+  if (frame.nextAttemptTime > millis()) {
+    return;
+  }
+  if (frame.attempts < CSMA_MAX_ATTEMPTS && !channelClear()) {
+    backOff(frame);
+    return;
+  }
+  pendingHead = (pendingHead + 1) % CSMA_QUEUE_SIZE;
+  pendingCount--;
+  transmit(frame.payload);
+}
+
+bool RadioController::transmit(Payload &payload) {
+  ScopedProbe probe(PROBE_BROADCAST);
+  if (!Role::transmits) {
+    return false;
+  }
+  // Stamped as late as we can, since CSMA may have held the frame.
+  if (payload.command == BEACON) {
+    payload.data = millis();
+  } else if (payload.command == RUNNING && payload.data != VALUE_UNSET) {
+    payload.originAge = min(latency->collectorNow() - payload.data, (unsigned long) UINT16_MAX);
+  }
+  if (RECORD_TRAFFIC || TRAFFIC_REPLAY) {
+    printFrame('T', payload);
+  }
+  if (TRAFFIC_REPLAY) {
+    // Nothing goes on air while replaying, and everything gets through.
+    return true;
+  }
+  if (FAULT_INJECTION && faults->roll(FAULT_DROP_TX)) {
+    Serial.println(F("Fault: dropped outgoing frame"));
+    linkStats.recordSent(payload.toId, false, 0);
+    if (payload.requestACK) {
+      statusController.setTransmissionStatus(false);
+    }
+    return false;
+  }
   
-  if (payload.command != ACK || LOG_OUTGOING_ACKS) {
+  if (LOG_FRAMES && (payload.command != ACK || LOG_OUTGOING_ACKS)) {
     Serial.print(millis() / 1000.0);
-    Serial.print(" Broadcasting: ");
+    Serial.print(F(" Broadcasting: "));
     println(payload);
   }
 
@@ -176,12 +454,13 @@ bool RadioController::broadcastCommand(Payload &payload) {
     
     // received = radio.write(&payload, payloadSize, !requestAck);
     received = radio.write(&payload, payloadSize);
+    linkStats.recordSent(payload.toId, received, radio.getARC());
     // success = radio.txStandBy(1000) || success;
     if (requestAck) {
       if (received) {
-        Serial.println("Message sucessfully sent");
+        Serial.println(F("Message sucessfully sent"));
       } else {
-        Serial.println("Failed to send message");
+        Serial.println(F("Failed to send message"));
       }
       statusController.setTransmissionStatus(received);
     }
@@ -190,12 +469,12 @@ bool RadioController::broadcastCommand(Payload &payload) {
   } else {
     do {
       while (radioFailed() && payload.retryCount < BROADCAST_RETRIES) {
-        Serial.println("Radio failed while trying to send out message.");
+        Serial.println(F("Radio failed while trying to send out message."));
         payload.retryCount++;
         configureRadio();
       }
       if (payload.retryCount >= BROADCAST_RETRIES) {
-        Serial.println("Could not configure radio.  Dropping message");
+        Serial.println(F("Could not configure radio.  Dropping message"));
         return false;
       }
       radio.stopListening();
@@ -212,14 +491,15 @@ bool RadioController::broadcastCommand(Payload &payload) {
         received = waitForAckPayload(BROADCAST_RETRY_DELAY_MS);
       }
     } while (!received && payload.retryCount < BROADCAST_RETRIES);
+    linkStats.recordSent(payload.toId, received, min(255, payload.retryCount - 1));
 
     if (payload.requestACK) {
       if (received) {
-        Serial.print("Message sent sucessfully after ");
+        Serial.print(F("Message sent sucessfully after "));
         Serial.print(payload.retryCount - 1);
-        Serial.println(" retries");
+        Serial.println(F(" retries"));
       } else {
-        Serial.println("Message failed");
+        Serial.println(F("Message failed"));
       }
       statusController.setTransmissionStatus(received);
     }
@@ -232,7 +512,7 @@ void RadioController::maybeAck(const Payload &received) {
   if (!USE_CHIP_ACK && replyToAcks && received.requestACK) {
     Payload ackPayload;
     ackPayload.messageId = getNextMessageId();
-    ackPayload.id = ids.getID();
+    ackPayload.id = ids.getAddress();
     ackPayload.toId = received.id;
     ackPayload.command = ACK;
     broadcastCommand(ackPayload);
@@ -245,15 +525,15 @@ bool RadioController::waitForAckPayload(unsigned long maxWait) {
   uint8_t incomingPipe;
   while (millis() < endWaitTime) {
     while (radioFailed() && millis() < endWaitTime) {
-      Serial.println("Radio failed while waitin for ACK.");
+      Serial.println(F("Radio failed while waitin for ACK."));
       configureRadio();
     }
     if (radio.available(&incomingPipe)) {
       radio.read(&received, (dynamicPayloadsEnabled) ? radio.getDynamicPayloadSize() : radio.getPayloadSize());
-      if (received.command == ACK && received.toId == ids.getID()) {
+      if (received.command == ACK && received.toId == ids.getAddress()) {
         return true;
       } else {
-        Serial.print("Receieved an unexpected message while waiting for ack: ");
+        Serial.print(F("Receieved an unexpected message while waiting for ack: "));
         println(received);
       }
     } else {
@@ -8,7 +8,12 @@
 #include "GatePins.h"
 #include "StatusController.h"
 #include "Ids.h"
+#include "LinkStats.h"
 
+/**
+ * What we start with.  LinkAdapter moves the PA level and, from the dust
+ * collector, the whole network's data rate from here.
+ */
 const rf24_datarate_e RADIO_DATA_RATE = RF24_1MBPS;
 const rf24_pa_dbm_e RADIO_POWER_LEVEL = RF24_PA_HIGH;
 const rf24_crclength_e CRC_LENGTH  = RF24_CRC_16;
@@ -20,32 +25,86 @@ const bool SEPARATE_PIPE_FOR_ACK = true;
 const unsigned long BROADCAST_RETRY_DELAY_MS = 100;
 const int BROADCAST_RETRIES = 100;
 
+/**
+ * When starting without blocking (warm start), this is how long we wait
+ * between attempts to bring up a radio that did not start.
+ */
+const unsigned long RADIO_START_RETRY_DELAY_MS = 500;
+
 const uint8_t myAddress =  0xDE;
 const uint8_t sendAddress = myAddress;
 const uint8_t ackAddress = 0xDF;
 
 // const uint8_t CHANNEL = 3;
+/**
+ * The channel we start on the first time.  After that the dust collector
+ * moves everyone to the quietest channel it finds (see ChannelManager), and
+ * each node remembers the last one in EEPROM.
+ */
 const uint8_t CHANNEL = 92;
+const uint8_t MAX_CHANNEL = 125;
+
+const bool AUTO_CHANNEL_SELECTION = true;
+
+/**
+ * How long to listen on a channel for each received power sample.  The chip
+ * needs at least 170us in RX before the reading means anything.
+ */
+const unsigned int RPD_DWELL_US = 200;
+
+/**
+ * Listen before talk.  Before sending we check the channel for a carrier.  If
+ * it's busy the frame waits in a small queue and we try again after a random
+ * backoff, up to CSMA_SLOT_MS << attempts, sent from onLoop().  After
+ * CSMA_MAX_ATTEMPTS we send anyway rather than drop it.  Each radio also picks
+ * its own auto retransmit delay, so two that do collide don't keep colliding.
+ */
+const bool CSMA = true;
+const unsigned long CSMA_SLOT_MS = 2;
+const uint8_t CSMA_MAX_BACKOFF_EXPONENT = 5;
+const uint8_t CSMA_MAX_ATTEMPTS = 6;
+/**
+ * Auto retransmit delay is in 250us steps (0 is 250us).
+ */
+const uint8_t MIN_RETRANSMIT_DELAY = 2;
+const uint8_t MAX_RETRANSMIT_DELAY = 10;
+const uint8_t RETRANSMIT_COUNT = 15;
 
 const uint8_t BROADCAST_PIPE = 1;
 const uint8_t ACK_PIPE = 2;
 
-enum Command {
+enum Command : int16_t {
     UNKNOWN,
-    RUNNING,
+    RUNNING, // data is when the current started, in the dust collector's clock (see Latency), or VALUE_UNSET.  load says if it is cutting
     NO_LONGER_RUNNING,
     ACK,
     HELLO_WORLD, // Debugging message sent out when a machine first comes online
-    WELCOME, // Response back from the HELLO_WORLD
+    WELCOME, // Response back from the HELLO_WORLD.  Carries the lease: toId is the address, data is the node's id
+    HEARTBEAT, // Sent by nodes now and then to renew their lease
+    BEACON, // Sent by the dust collector now and then so nodes know they can still hear it.  data is its millis()
+    CHANNEL_CHANGE, // From the dust collector.  data is (ms until the switch << 16) | (data rate << 8) | channel
+    CONFIG_CHUNK, // From the dust collector.  Part of the config block (see ConfigPush)
+    CONFIG_STATUS, // To the dust collector.  Which parts of a config block a node has
+    COLLECTOR_INFO, // From an aux collector to the dust collector.  data is its capacity, gateCode the branches it reaches
+    COLLECTOR_ASSIGN, // From the dust collector.  data is the addresses of the collectors that should run, a byte each
 };
 
-struct Payload {
-  unsigned long messageId = VALUE_UNSET;
-  unsigned long id = VALUE_UNSET;
-  unsigned long toId = VALUE_UNSET;
-  unsigned int gateCode = 0;
+/**
+ * Fixed width fields and no padding, so a frame is the same 21 bytes built
+ * for the ATmega328 or for the native tests (and tools/replay_traffic.py
+ * can unpack it).
+ */
+struct __attribute__((packed)) Payload {
+  uint32_t messageId = VALUE_UNSET;
+  /**
+   * Short addresses leased from the dust collector.  ADDRESS_UNSET in toId
+   * means the message is for everyone.
+   */
+  uint8_t id = ADDRESS_UNSET;
+  uint8_t toId = ADDRESS_UNSET;
+  uint16_t gateCode = 0;
   Command command = UNKNOWN;
-  boolean requestACK = false;
+  bool requestACK = false;
 
   /**
    * The number of retries for this message.  We pass this through to the
@@ -53,21 +112,103 @@ struct Payload {
    * message.  Otherwise the radio hardware might just ignore the message
    * automatically for us.
    */
-  unsigned int retryCount = 0;
+  uint16_t retryCount = 0;
+
+  /**
+   * Depends on the command.  For HELLO_WORLD, HEARTBEAT and WELCOME it's the
+   * long id of the node the lease is for.
+   */
+  uint32_t data = VALUE_UNSET;
+
+  /**
+   * For a RUNNING that carries an origin time, how long ago that was when
+   * the frame went out.
+   */
+  uint16_t originAge = 0;
+
+  /**
+   * For RUNNING, whether the machine is cutting or only spinning.
+   */
+  LoadState load = LOAD_UNKNOWN;
+
+  /**
+   * For RUNNING, the airflow the machine needs, in 10 CFM.
+   */
+  uint8_t demand = 0;
 };
 
 const int payloadSize = sizeof(Payload);
+static_assert(sizeof(Payload) <= 32, "Payload must fit in a single nRF24 frame");
+
+typedef void (*FrameListener)(const Payload &payload);
 
 class RadioController {
     public:
         RadioController(StatusController &statusController, Ids &ids) : statusController(statusController), ids(ids) {};
-        void setup();
+        /**
+         * When not blocking, setup() returns right away even if the radio did
+         * not come up, and onLoop() keeps retrying in the background.
+         */
+        void setup(bool blockUntilStarted);
         void onLoop();
         void configureRadio();
         bool radioFailed();
+        bool isReady() { return !radio.failureDetected; }
+        /**
+         * Nothing waiting to be read or sent, so it's ok to sleep.
+         */
+        bool isIdle() { return pendingCount == 0 && !hasInjected && !hasDelayed && !radio.available(); }
+        bool isSendQueueEmpty() const { return pendingCount == 0; }
+
+        uint8_t getChannel() const { return channel; }
+        rf24_datarate_e getDataRate() const { return dataRate; }
+        /**
+         * Moves to a new channel and data rate.  Only saved to EEPROM when
+         * asked, so a node scanning for the dust collector doesn't wear it out.
+         */
+        void setChannel(uint8_t channel, rf24_datarate_e dataRate, bool save);
+        /**
+         * Throws away what was heard but not read yet.
+         */
+        void discardReceived() { radio.flush_rx(); }
+        uint8_t getPALevel() const { return paLevel; }
+        void setPALevel(uint8_t paLevel);
+        LinkStats &getLinkStats() { return linkStats; }
+        /**
+         * Briefly listens on another channel and returns how many of the
+         * samples saw a carrier, then goes back to our own channel.
+         */
+        uint8_t sampleChannel(uint8_t otherChannel, uint8_t samples);
+        unsigned long getLastCollectorContactTime() const { return lastCollectorContactTime; }
+        /**
+         * These all return whether the frame went out (and was ACKed, when
+         * asked for).  With CSMA a frame that has to wait for a clear channel
+         * returns false, and is sent later from onLoop().
+         */
         bool broadcastCommand(Command command);
-        bool broadcastCommand(Command command, boolean ack);
+        bool broadcastCommand(Command command, boolean ack, unsigned long data = VALUE_UNSET, LoadState load = LOAD_UNKNOWN, uint8_t demand = 0);
+        bool sendTo(uint8_t toId, Command command, unsigned long data);
         bool getMessage(Payload &buff);
+        /**
+         * With TRAFFIC_REPLAY, the next frame getMessage() returns.
+         */
+        void inject(const Payload &payload);
+        /**
+         * With FAULT_INJECTION, knocks the radio over the way a brown out
+         * would (every register back to its power on value, powered down),
+         * or just changes one register under us.  Either way radioFailed()
+         * should notice and bring it back.
+         */
+        void injectRadioFault(bool brownOut);
+        /**
+         * Called with every frame heard, before any filtering.
+         */
+        void setFrameListener(FrameListener listener) { frameListener = listener; }
+        /**
+         * Times a read found the RX FIFO full (gateway only), so frames may
+         * have been dropped.
+         */
+        unsigned long getRxOverflows() const { return rxOverflows; }
 
         // void print(const Payload &payload);
         // void println(const Payload &payload);
@@ -77,13 +218,44 @@ class RadioController {
 
         RF24 radio = RF24(CE_PIN, CSN_PIN);
         unsigned long currentMessageId = 0;
+        uint8_t channel = CHANNEL;
+        rf24_datarate_e dataRate = RADIO_DATA_RATE;
+        uint8_t paLevel = RADIO_POWER_LEVEL;
+        LinkStats linkStats;
+        unsigned long lastCollectorContactTime = 0;
         
         boolean replyToAcks = false;
+        bool blockUntilStarted = true;
+        unsigned long lastStartAttemptTime = 0;
+
+        struct PendingFrame {
+            Payload payload;
+            uint8_t attempts;
+            unsigned long nextAttemptTime;
+        };
+        PendingFrame pending[CSMA_QUEUE_SIZE];
+        uint8_t pendingHead = 0;
+        uint8_t pendingCount = 0;
+        bool channelClear();
+        void backOff(PendingFrame &frame);
+        void sendPending();
+        bool transmit(Payload &payload);
+
+        Payload injected;
+        bool hasInjected = false;
+        bool readFrame(Payload &received);
+        Payload delayed;
+        bool hasDelayed = false;
+        unsigned long delayedUntil = 0;
+        bool injectReceiveFaults(Payload &received);
+        FrameListener frameListener = NULL;
+        unsigned long rxOverflows = 0;
         void maybeAck(const Payload &received);
         bool waitForAckPayload(unsigned long maxWait);
         bool broadcastCommand(Payload &payload);
         unsigned long getNextMessageId();
         bool dynamicPayloadsEnabled = false;
+        void loadChannel();
 };
 
 #endif
\ No newline at end of file
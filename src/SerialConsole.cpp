@@ -0,0 +1,57 @@
+#include "SerialConsole.h"
+
+void SerialConsole::onLoop() {
+    // Only handle what has already arrived.
+    int available = Serial.available();
+    while (available-- > 0) {
+        char c = Serial.read();
+        if (c == '\n' || c == '\r') {
+            if (overflowed) {
+                Serial.println(F("Command too long.  Ignoring"));
+            } else if (lineLength > 0) {
+                line[lineLength] = '\0';
+                execute();
+            }
+            lineLength = 0;
+            overflowed = false;
+        } else if (lineLength < CONSOLE_LINE_LENGTH) {
+            line[lineLength++] = c;
+        } else {
+            overflowed = true;
+        }
+    }
+}
+
+void SerialConsole::execute() {
+    char *argv[CONSOLE_MAX_ARGS];
+    uint8_t argc = 0;
+    char *word = strtok(line, " \t");
+    while (word != NULL && argc < CONSOLE_MAX_ARGS) {
+        argv[argc++] = word;
+        word = strtok(NULL, " \t");
+    }
+    if (argc == 0) {
+        return;
+    }
+
+    for (uint8_t i = 0; i < commandCount; i++) {
+        if (strcmp_P(argv[0], commands[i].name) == 0) {
+            ConsoleHandler handler = (ConsoleHandler) pgm_read_ptr(&commands[i].handler);
+            handler(argc, argv);
+            return;
+        }
+    }
+    Serial.print(F("Unknown command: "));
+    Serial.println(argv[0]);
+    printHelp();
+}
+
+void SerialConsole::printHelp() {
+    Serial.println(F("Commands:"));
+    for (uint8_t i = 0; i < commandCount; i++) {
+        Serial.print(F("  "));
+        Serial.print((const __FlashStringHelper *) commands[i].name);
+        Serial.print(F(" "));
+        Serial.println((const __FlashStringHelper *) commands[i].usage);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef serial_console_h
+#define serial_console_h
+
+#include <Arduino.h>
+#include "Capacity.h"
+
+/**
+ * argv[0] is the command name.  Arguments point into the console's line
+ * buffer and are only good until the handler returns.
+ */
+typedef void (*ConsoleHandler)(uint8_t argc, char **argv);
+
+const uint8_t CONSOLE_NAME_LENGTH = 10;
+const uint8_t CONSOLE_USAGE_LENGTH = 72;
+
+/**
+ * The table lives in PROGMEM, strings and all, so the help text costs no
+ * SRAM.
+ */
+struct ConsoleCommand {
+    char name[CONSOLE_NAME_LENGTH];
+    char usage[CONSOLE_USAGE_LENGTH];
+    ConsoleHandler handler;
+};
+
+/**
+ * Reads commands from Serial one byte at a time, so it never blocks the loop
+ * waiting for input.  A command is a line of space separated words, looked up
+ * by its first word in the PROGMEM table it was built with.
+ */
+class SerialConsole {
+    public:
+        SerialConsole(const ConsoleCommand *commands, uint8_t commandCount) : commands(commands), commandCount(commandCount) {};
+        void onLoop();
+        void printHelp();
+    private:
+        const ConsoleCommand *commands;
+        const uint8_t commandCount;
+
+        char line[CONSOLE_LINE_LENGTH + 1];
+        uint8_t lineLength = 0;
+        bool overflowed = false;
+
+        void execute();
+};
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef slot_h
+#define slot_h
+
+#include <Arduino.h>
+
+/**
+ * Static storage for a subsystem that only some roles have.  When present is
+ * false the object is never built and takes no SRAM, and get() is NULL, so
+ * the code using it keeps its NULL checks.  The constructor arguments are the
+ * object's collaborators, wired when the program starts rather than in
+ * setup(), so nothing ever comes from the heap.
+ */
+template <class T, bool present>
+class Slot {
+    public:
+        template <class... Args> Slot(Args &&... args) : object(args...) {}
+        T *get() { return &object; }
+    private:
+        T object;
+};
+
+template <class T>
+class Slot<T, false> {
+    public:
+        template <class... Args> Slot(Args &&...) {}
+        T *get() { return NULL; }
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "SpinDown.h"
+#include <EEPROM.h>
+#include <limits.h>
+#include "Config.h"
+#include "LeaseTable.h"
+
+void SpinDown::setup() {
+    if (EEPROM.read(EEPROM_SPIN_DOWN_ADDRESS) != SPIN_DOWN_LAYOUT) {
+        Serial.println(F("No learned spin down delays.  Starting over"));
+        for (unsigned int i = 0; i < MAX_NODES * SPIN_DOWN_BINS; i++) {
+            EEPROM.update(eepromAddress(FIRST_NODE_ADDRESS) + i, 0);
+        }
+        EEPROM.update(EEPROM_SPIN_DOWN_ADDRESS, SPIN_DOWN_LAYOUT);
+    }
+    uint8_t histogram[SPIN_DOWN_BINS];
+    for (uint8_t address = FIRST_NODE_ADDRESS; address < FIRST_NODE_ADDRESS + MAX_NODES; address++) {
+        readHistogram(address, histogram);
+        for (uint8_t bin = 0; bin < SPIN_DOWN_BINS; bin++) {
+            // Saturates rather than halving, since the machines' own counts
+            // are what gets saved.
+            shopHistogram[bin] = min(255, shopHistogram[bin] + histogram[bin]);
+        }
+    }
+    choose(ADDRESS_UNSET);
+}
+
+void SpinDown::onCutting(uint8_t address) {
+    unsigned long now = millis();
+    if (lastCuttingTime != VALUE_UNSET && (now - lastCuttingTime) >= SPIN_DOWN_MIN_GAP_MS && LeaseTable::isNodeAddress(lastMachine)) {
+        record(lastMachine, now - lastCuttingTime);
+    }
+    lastCuttingTime = now;
+    if (address != lastMachine) {
+        lastMachine = address;
+        choose(address);
+    }
+}
+
+uint8_t SpinDown::binFor(unsigned long gapMs) {
+    uint8_t bin = 0;
+    while (bin < SPIN_DOWN_BINS - 1 && gapMs > SPIN_DOWN_BIN_EDGES_S[bin] * 1000UL) {
+        bin++;
+    }
+    return bin;
+}
+
+unsigned int SpinDown::total(const uint8_t *histogram) {
+    unsigned int sum = 0;
+    for (uint8_t bin = 0; bin < SPIN_DOWN_BINS; bin++) {
+        sum += histogram[bin];
+    }
+    return sum;
+}
+
+void SpinDown::readHistogram(uint8_t address, uint8_t *histogram) const {
+    for (uint8_t bin = 0; bin < SPIN_DOWN_BINS; bin++) {
+        histogram[bin] = EEPROM.read(eepromAddress(address) + bin);
+    }
+}
+
+void SpinDown::record(uint8_t address, unsigned long gapMs) {
+    uint8_t histogram[SPIN_DOWN_BINS];
+    readHistogram(address, histogram);
+    uint8_t bin = binFor(gapMs);
+    if (total(histogram) >= SPIN_DOWN_WINDOW) {
+        for (uint8_t i = 0; i < SPIN_DOWN_BINS; i++) {
+            histogram[i] /= 2;
+        }
+    }
+    histogram[bin]++;
+    if (total(shopHistogram) >= SPIN_DOWN_WINDOW * 2) {
+        for (uint8_t i = 0; i < SPIN_DOWN_BINS; i++) {
+            shopHistogram[i] /= 2;
+        }
+    }
+    shopHistogram[bin]++;
+    // Only the bytes that changed get written.
+    for (uint8_t i = 0; i < SPIN_DOWN_BINS; i++) {
+        EEPROM.update(eepromAddress(address) + i, histogram[i]);
+    }
+    choose(address);
+}
+
+void SpinDown::choose(uint8_t address) {
+    const ConfigValues &values = config.get();
+    uint8_t histogram[SPIN_DOWN_BINS];
+    if (LeaseTable::isNodeAddress(address)) {
+        readHistogram(address, histogram);
+    }
+    if (!LeaseTable::isNodeAddress(address) || total(histogram) < SPIN_DOWN_MIN_SAMPLES) {
+        memcpy(histogram, shopHistogram, sizeof(histogram));
+    }
+    if (total(histogram) < SPIN_DOWN_MIN_SAMPLES) {
+        delayMs = values.collectorTurnOffDelayMs;
+    } else {
+        delayMs = bestDelay(histogram, values.spinDownMinS, values.spinDownMaxS);
+    }
+}
+
+unsigned long SpinDown::bestDelay(const uint8_t *histogram, unsigned int minS, unsigned int maxS) {
+    unsigned int bestS = minS;
+    unsigned long bestCost = ULONG_MAX;
+    // Try each bin edge in the limits, and the limits themselves.
+    for (uint8_t candidate = 0; candidate <= SPIN_DOWN_BINS; candidate++) {
+        unsigned int delayS;
+        if (candidate == SPIN_DOWN_BINS - 1) {
+            delayS = minS;
+        } else if (candidate == SPIN_DOWN_BINS) {
+            delayS = maxS;
+        } else {
+            delayS = constrain(SPIN_DOWN_BIN_EDGES_S[candidate], minS, maxS);
+        }
+        unsigned long cost = 0;
+        for (uint8_t bin = 0; bin < SPIN_DOWN_BINS; bin++) {
+            if (bin < SPIN_DOWN_BINS - 1 && SPIN_DOWN_BIN_GAPS_S[bin] <= delayS) {
+                // Idles through the gap.
+                cost += (unsigned long) histogram[bin] * SPIN_DOWN_BIN_GAPS_S[bin];
+            } else {
+                // Idles for the delay, then has to start again.
+                cost += (unsigned long) histogram[bin] * (delayS + SPIN_DOWN_RESTART_COST_S);
+            }
+        }
+        if (cost < bestCost) {
+            bestCost = cost;
+            bestS = delayS;
+        }
+    }
+    return bestS * 1000UL;
+}
+
+void SpinDown::report(uint8_t address) const {
+    uint8_t histogram[SPIN_DOWN_BINS];
+    if (LeaseTable::isNodeAddress(address)) {
+        readHistogram(address, histogram);
+        Serial.print(F("Gaps after "));
+        Serial.print(address);
+    } else {
+        memcpy(histogram, shopHistogram, sizeof(histogram));
+        Serial.print(F("Gaps in the shop"));
+    }
+    Serial.print(F(" (<=5s, 10s, 20s, 40s, 80s, 160s, 320s, longer):"));
+    for (uint8_t bin = 0; bin < SPIN_DOWN_BINS; bin++) {
+        Serial.print(F(" "));
+        Serial.print(histogram[bin]);
+    }
+    Serial.println();
+    Serial.print(F("Spin down delay: "));
+    Serial.print(delayMs / 1000);
+    Serial.print(F("s after the last cut on "));
+    Serial.println(lastMachine);
+}
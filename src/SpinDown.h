@@ -0,0 +1,84 @@
+#ifndef spin_down_h
+#define spin_down_h
+
+#include <Arduino.h>
+#include "Ids.h"
+#include "EepromLayout.h"
+
+/**
+ * Gaps between cuts are counted in these bins, by upper edge in seconds.  The
+ * last one is everything longer: somebody walked away.
+ */
+const uint8_t SPIN_DOWN_BINS = 8;
+const unsigned int SPIN_DOWN_BIN_EDGES_S[SPIN_DOWN_BINS - 1] = {5, 10, 20, 40, 80, 160, 320};
+/**
+ * What we charge a gap that falls in each bin, about the middle of it.
+ */
+const unsigned int SPIN_DOWN_BIN_GAPS_S[SPIN_DOWN_BINS - 1] = {4, 7, 14, 28, 57, 113, 226};
+
+/**
+ * Cuts closer together than this are one use.  Machines send RUNNING every
+ * second while they cut.
+ */
+const unsigned long SPIN_DOWN_MIN_GAP_MS = 3000;
+
+/**
+ * Stopping and starting the collector costs about as much as running it this
+ * long: the inrush, and wear on the motor, belts and contactor.
+ */
+const unsigned int SPIN_DOWN_RESTART_COST_S = 30;
+
+/**
+ * A machine needs this many gaps before its own histogram is trusted, else we
+ * go by the whole shop, else by the configured turn off delay.  Histograms are
+ * halved once they hold SPIN_DOWN_WINDOW gaps, so they follow how the shop is
+ * used now.
+ */
+const uint8_t SPIN_DOWN_MIN_SAMPLES = 8;
+const uint8_t SPIN_DOWN_WINDOW = 64;
+
+const uint8_t SPIN_DOWN_LAYOUT = 1;
+
+/**
+ * Kept by the dust collector.  Learns how long the shop goes between cuts
+ * after each machine is used, and picks the delay before stopping the
+ * collector that costs least on average: idling through a gap that ends
+ * before the delay, or the delay plus a restart for one that doesn't.
+ *
+ * There is no wall clock, so there is no time of day.  One histogram per
+ * machine lives in EEPROM, and only the shop-wide sum is kept in SRAM.
+ */
+class SpinDown {
+    public:
+        void setup();
+        /**
+         * A machine says it is cutting.
+         */
+        void onCutting(uint8_t address);
+        /**
+         * How long to keep running after the last cut.
+         */
+        unsigned long getDelay() const { return delayMs; }
+        /**
+         * Picks the delay again, after the limits in the config change.
+         */
+        void refresh() { choose(lastMachine); }
+        void report(uint8_t address) const;
+    private:
+        uint8_t shopHistogram[SPIN_DOWN_BINS] = {0};
+        unsigned long lastCuttingTime = VALUE_UNSET;
+        uint8_t lastMachine = ADDRESS_UNSET;
+        unsigned long delayMs = 0;
+
+        void record(uint8_t address, unsigned long gapMs);
+        void readHistogram(uint8_t address, uint8_t *histogram) const;
+        void choose(uint8_t address);
+        static uint8_t binFor(unsigned long gapMs);
+        static unsigned int total(const uint8_t *histogram);
+        static unsigned long bestDelay(const uint8_t *histogram, unsigned int minS, unsigned int maxS);
+        static int eepromAddress(uint8_t address) { return EEPROM_SPIN_DOWN_ADDRESS + 1 + (address - FIRST_NODE_ADDRESS) * SPIN_DOWN_BINS; }
+};
+
+extern SpinDown *const spinDown;
+
+#endif
@@ -1,18 +1,12 @@
 #include "StatusController.h"
 #include <Arduino.h>
 #include "GatePins.h"
+#include "Telemetry.h"
 
 void StatusController::setup() {
-    pinMode(RED_LED, OUTPUT);
-    pinMode(BLUE_LED, OUTPUT);
-    pinMode(GREEN_LED, OUTPUT);
-
-    digitalWrite(RED_LED, LOW);
-    digitalWrite(BLUE_LED, LOW);
-    digitalWrite(GREEN_LED, HIGH);
-
-    radioFailureBlinker.setup();
-    calibrationBlinker.setup();
+    redLed.setup(false);
+    blueLed.setup(false);
+    greenLed.setup(true);
 }
 
 void StatusController::onLoop() {
@@ -20,21 +14,12 @@ void StatusController::onLoop() {
     calibrationBlinker.onLoop();
 
     if (!radioFailureBlinker.isEnabled()) {
-        if (lastFailedTranmissionTime + FAILED_TRANSMISSION_LIGHT_ON_TIME_MS < millis()) {
-            digitalWrite(RED_LED, LOW);
-        } else {
-            digitalWrite(RED_LED, HIGH);
-        }
+        redLed.set(lastFailedTranmissionTime + FAILED_TRANSMISSION_LIGHT_ON_TIME_MS >= millis());
     }
     if (!calibrationBlinker.isEnabled()) {
-        digitalWrite(BLUE_LED, gateStatus ? HIGH : LOW);
-    }
-
-    if ((SYSTEM_ACTIVE_MS + lastActiveTime) > millis()) {
-        digitalWrite(GREEN_LED, HIGH);
-    } else {
-        digitalWrite(GREEN_LED, LOW);
+        blueLed.set(gateStatus);
     }
+    greenLed.set((SYSTEM_ACTIVE_MS + lastActiveTime) > millis());
 }
 
 void StatusController::onSystemActive() {
@@ -47,10 +32,13 @@ void StatusController::setRadioInFailure(bool inFailure) {
 
 void StatusController::setTransmissionStatus(bool success) {
     if (!success) {
+        if (telemetry != NULL) {
+            telemetry->recordTransmissionFailure();
+        }
         lastFailedTranmissionTime = millis();
-        digitalWrite(RED_LED, HIGH);
+        redLed.set(true);
     } else {
-        digitalWrite(RED_LED, LOW);
+        redLed.set(false);
         lastFailedTranmissionTime = 0;
     }
 }
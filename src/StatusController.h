@@ -13,7 +13,7 @@ const unsigned long SYSTEM_ACTIVE_MS = 30L * 60L * 1000L;
 
 class StatusController {
     public:
-        StatusController() : radioFailureBlinker(RED_LED, RADIO_FAILURE_BLINK_MS), calibrationBlinker(BLUE_LED, CALIBRATION_BLINK_MS) {};
+        StatusController() : radioFailureBlinker(redLed, RADIO_FAILURE_BLINK_MS), calibrationBlinker(blueLed, CALIBRATION_BLINK_MS) {};
         void setup();
         void onLoop();
         void onSystemActive();
@@ -25,8 +25,11 @@ class StatusController {
         unsigned long lastActiveTime = 0;
         unsigned long lastFailedTranmissionTime = 0;
         bool gateStatus = false;
-        Blinker radioFailureBlinker;
-        Blinker calibrationBlinker;
+        Led<RED_LED> redLed;
+        Led<BLUE_LED> blueLed;
+        Led<GREEN_LED> greenLed;
+        Blinker<RED_LED> radioFailureBlinker;
+        Blinker<BLUE_LED> calibrationBlinker;
 };
 
 #endif
\ No newline at end of file
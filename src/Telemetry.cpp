@@ -0,0 +1,177 @@
+#include "Telemetry.h"
+#include <EEPROM.h>
+#include <util/crc16.h>
+#include "EepromLayout.h"
+#include "LeaseTable.h"
+
+static_assert(FIRST_NODE_ADDRESS + MAX_NODES - 1 <= EVENT_ADDRESS_MASK, "Node addresses don't fit in an event");
+
+void Telemetry::setup() {
+    TelemetryCheckpoint saved;
+    EEPROM.get(EEPROM_TELEMETRY_ADDRESS, saved);
+    if (saved.version == TELEMETRY_VERSION && saved.checksum == checksum(saved)
+            && saved.head < TELEMETRY_BUFFER_SIZE && saved.length <= TELEMETRY_BUFFER_SIZE) {
+        for (unsigned int i = 0; i < TELEMETRY_BUFFER_SIZE; i++) {
+            buffer[i] = EEPROM.read(EEPROM_TELEMETRY_ADDRESS + sizeof(TelemetryCheckpoint) + i);
+        }
+        head = saved.head;
+        length = saved.length;
+        baseSeconds = saved.baseSeconds;
+        Serial.print(F("Restored telemetry: "));
+        Serial.print(length);
+        Serial.println(F(" bytes"));
+    }
+    record(EVENT_BOOT);
+}
+
+void Telemetry::onLoop() {
+    if (dirty && (lastCheckpointTime + TELEMETRY_CHECKPOINT_INTERVAL_MS) < millis()) {
+        checkpoint();
+    }
+}
+
+void Telemetry::recordMachine(uint8_t address, bool running) {
+    if (!LeaseTable::isNodeAddress(address)) {
+        return;
+    }
+    uint8_t index = address - FIRST_NODE_ADDRESS;
+    uint8_t bit = 1 << (index % 8);
+    bool wasRunning = machinesRunning[index / 8] & bit;
+    if (wasRunning == running) {
+        return;
+    }
+    if (running) {
+        machinesRunning[index / 8] |= bit;
+        record(EVENT_MACHINE_ON | address);
+    } else {
+        machinesRunning[index / 8] &= ~bit;
+        record(EVENT_MACHINE_OFF | address);
+    }
+}
+
+void Telemetry::recordCollector(bool on) {
+    if (collectorOn == on) {
+        return;
+    }
+    collectorOn = on;
+    if (!on) {
+        // Anything we didn't hear stop has stopped by now.
+        for (uint8_t index = 0; index < MAX_NODES; index++) {
+            recordMachine(FIRST_NODE_ADDRESS + index, false);
+        }
+    }
+    record(on ? EVENT_COLLECTOR_ON : EVENT_COLLECTOR_OFF);
+    if (!on && dirty) {
+        // A quiet moment, so a good time to save.
+        checkpoint();
+    }
+}
+
+void Telemetry::recordTransmissionFailure() {
+    record(EVENT_TRANSMISSION_FAILURE);
+}
+
+void Telemetry::record(uint8_t event) {
+    unsigned long now = millis() / 1000;
+    unsigned long delta = now - lastEventSeconds;
+    lastEventSeconds = now;
+
+    uint8_t encoded[6];
+    uint8_t encodedLength = 0;
+    do {
+        uint8_t value = delta & 0x7F;
+        delta >>= 7;
+        if (delta != 0) {
+            value |= 0x80;
+        }
+        encoded[encodedLength++] = value;
+    } while (delta != 0);
+    encoded[encodedLength++] = event;
+
+    while (length + encodedLength > TELEMETRY_BUFFER_SIZE) {
+        dropOldest();
+    }
+    for (uint8_t i = 0; i < encodedLength; i++) {
+        push(encoded[i]);
+    }
+    dirty = true;
+}
+
+void Telemetry::push(uint8_t value) {
+    buffer[(head + length) % TELEMETRY_BUFFER_SIZE] = value;
+    length++;
+}
+
+uint8_t Telemetry::pop() {
+    uint8_t value = buffer[head];
+    head = (head + 1) % TELEMETRY_BUFFER_SIZE;
+    length--;
+    return value;
+}
+
+void Telemetry::dropOldest() {
+    unsigned long delta = 0;
+    uint8_t shift = 0;
+    uint8_t value;
+    do {
+        value = pop();
+        delta |= (unsigned long) (value & 0x7F) << shift;
+        shift += 7;
+    } while (value & 0x80);
+    uint8_t event = pop();
+    baseSeconds = event == EVENT_BOOT ? delta : baseSeconds + delta;
+}
+
+uint8_t Telemetry::checksum(const TelemetryCheckpoint &checkpoint) {
+    const uint8_t *bytes = (const uint8_t *) &checkpoint;
+    uint8_t crc = 0;
+    // Skip the version and the checksum itself.
+    for (unsigned int i = 2; i < sizeof(TelemetryCheckpoint); i++) {
+        crc = _crc8_ccitt_update(crc, bytes[i]);
+    }
+    return crc;
+}
+
+void Telemetry::checkpoint() {
+    // The buffer is mirrored at the same positions, so EEPROM.update only
+    // writes the bytes that are new since the last checkpoint.
+    for (unsigned int i = 0; i < length; i++) {
+        unsigned int index = (head + i) % TELEMETRY_BUFFER_SIZE;
+        EEPROM.update(EEPROM_TELEMETRY_ADDRESS + sizeof(TelemetryCheckpoint) + index, buffer[index]);
+    }
+    TelemetryCheckpoint saved;
+    saved.head = head;
+    saved.length = length;
+    saved.baseSeconds = baseSeconds;
+    saved.checksum = checksum(saved);
+    EEPROM.put(EEPROM_TELEMETRY_ADDRESS, saved);
+    dirty = false;
+    lastCheckpointTime = millis();
+}
+
+static void writeLong(unsigned long value, uint8_t &crc) {
+    for (uint8_t i = 0; i < 4; i++) {
+        uint8_t b = value >> (8 * i);
+        crc = _crc8_ccitt_update(crc, b);
+        Serial.write(b);
+    }
+}
+
+void Telemetry::dump() {
+    uint8_t crc = 0;
+    Serial.write((const uint8_t *) "BGT", 3);
+    Serial.write(TELEMETRY_VERSION);
+    writeLong(millis() / 1000, crc);
+    writeLong(baseSeconds, crc);
+    uint8_t lengthBytes[2] = {(uint8_t) (length & 0xFF), (uint8_t) (length >> 8)};
+    for (uint8_t i = 0; i < 2; i++) {
+        crc = _crc8_ccitt_update(crc, lengthBytes[i]);
+        Serial.write(lengthBytes[i]);
+    }
+    for (unsigned int i = 0; i < length; i++) {
+        uint8_t value = buffer[(head + i) % TELEMETRY_BUFFER_SIZE];
+        crc = _crc8_ccitt_update(crc, value);
+        Serial.write(value);
+    }
+    Serial.write(crc);
+}
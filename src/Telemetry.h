@@ -0,0 +1,87 @@
+#ifndef telemetry_h
+#define telemetry_h
+
+#include <Arduino.h>
+#include "Ids.h"
+
+const unsigned long TELEMETRY_CHECKPOINT_INTERVAL_MS = 15L * 60L * 1000L;
+const uint8_t TELEMETRY_VERSION = 1;
+
+/**
+ * Each event is stored as the seconds since the previous event (a varint,
+ * 7 bits per byte) followed by one of these bytes.  Most events take 2 bytes,
+ * so the buffer holds a few days of normal use.
+ */
+const uint8_t EVENT_MACHINE_ON = 0x00; // | address
+const uint8_t EVENT_MACHINE_OFF = 0x40; // | address
+const uint8_t EVENT_COLLECTOR_OFF = 0x80;
+const uint8_t EVENT_COLLECTOR_ON = 0x81;
+const uint8_t EVENT_TRANSMISSION_FAILURE = 0xC0;
+const uint8_t EVENT_BOOT = 0xFF; // The clock restarts; the delta is the time since boot
+const uint8_t EVENT_ADDRESS_MASK = 0x3F;
+
+/**
+ * Saved in EEPROM ahead of the mirrored buffer.  Fixed width and packed so it
+ * is the same 10 bytes on the host as on the device.
+ */
+struct __attribute__((packed)) TelemetryCheckpoint {
+    uint8_t version = TELEMETRY_VERSION;
+    uint8_t checksum = 0;
+    uint16_t head = 0;
+    uint16_t length = 0;
+    uint32_t baseSeconds = 0;
+};
+
+/**
+ * Usage history kept by the dust collector: machines turning on and off, the
+ * collector starting and stopping, and failed transmissions.  Kept in a ring
+ * in SRAM that is mirrored byte for byte into EEPROM now and then, so only
+ * the new bytes get written.
+ *
+ * Dump format (all little endian):
+ *   "BGT" version nowSeconds(4) baseSeconds(4) length(2) events... crc8
+ * where baseSeconds is the clock before the first event.
+ */
+class Telemetry {
+    public:
+        /**
+         * Restores the last checkpoint and records that we booted.
+         */
+        void setup();
+        void onLoop();
+        void recordMachine(uint8_t address, bool running);
+        void recordCollector(bool on);
+        void recordTransmissionFailure();
+        /**
+         * Writes the binary dump to Serial.  Asked for with the "dump" console
+         * command.
+         */
+        void dump();
+        void checkpoint();
+    private:
+        uint8_t buffer[TELEMETRY_BUFFER_SIZE];
+        unsigned int head = 0;
+        unsigned int length = 0;
+        unsigned long baseSeconds = 0;
+        unsigned long lastEventSeconds = 0;
+
+        // A bit for each leased address, from FIRST_NODE_ADDRESS.
+        uint8_t machinesRunning[(MAX_NODES + 7) / 8] = {0};
+        bool collectorOn = false;
+
+        bool dirty = false;
+        unsigned long lastCheckpointTime = 0;
+
+        void record(uint8_t event);
+        void push(uint8_t value);
+        uint8_t pop();
+        void dropOldest();
+        uint8_t checksum(const TelemetryCheckpoint &checkpoint);
+};
+
+/**
+ * Only created on the dust collector.
+ */
+extern Telemetry *const telemetry;
+
+#endif
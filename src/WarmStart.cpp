@@ -0,0 +1,56 @@
+#include "WarmStart.h"
+#include <EEPROM.h>
+#include <util/crc16.h>
+#include "EepromLayout.h"
+
+uint8_t WarmStart::checksum(const WarmStartState &state) {
+    const uint8_t *bytes = (const uint8_t *) &state;
+    uint8_t crc = 0;
+    // Up to the checksum rather than the size, which has padding after it
+    // anywhere but avr-gcc.
+    for (unsigned int i = 0; i < offsetof(WarmStartState, checksum); i++) {
+        crc = _crc8_ccitt_update(crc, bytes[i]);
+    }
+    return crc;
+}
+
+bool WarmStart::load() {
+    WarmStartState saved;
+    EEPROM.get(EEPROM_WARM_START_ADDRESS, saved);
+    if (saved.version != WARM_START_VERSION || saved.checksum != checksum(saved)) {
+        Serial.println(F("No saved state found.  Doing a cold start"));
+        return false;
+    }
+    state = saved;
+    // Older builds saved it.
+    state.dustCollectorOn = false;
+    Serial.print(F("Restored saved state: openGates="));
+    Serial.print(state.openGates, BIN);
+    Serial.print(F(" open="));
+    Serial.print(state.openReading);
+    Serial.print(F(" closed="));
+    Serial.println(state.closedReading);
+    return true;
+}
+
+void WarmStart::update(uint8_t openGates, int openReading, int closedReading) {
+    if (state.openGates != openGates
+            || state.openReading != openReading
+            || state.closedReading != closedReading) {
+        state.openGates = openGates;
+        state.openReading = openReading;
+        state.closedReading = closedReading;
+        dirty = true;
+        lastChangeTime = millis();
+    } else if (dirty && (lastChangeTime + WARM_START_SAVE_DELAY_MS) < millis()) {
+        save();
+    }
+}
+
+void WarmStart::save() {
+    state.version = WARM_START_VERSION;
+    state.checksum = checksum(state);
+    // EEPROM.put only writes the bytes that actually changed.
+    EEPROM.put(EEPROM_WARM_START_ADDRESS, state);
+    dirty = false;
+}
@@ -0,0 +1,59 @@
+#ifndef warm_start_h
+#define warm_start_h
+
+#include <Arduino.h>
+
+/**
+ * Bump whenever WarmStartState changes so that an old saved state is
+ * ignored instead of being misread.
+ */
+const uint8_t WARM_START_VERSION = 1;
+
+/**
+ * How long the state has to stay unchanged before we write it out.  This
+ * keeps us from wearing out the EEPROM while someone is turning a
+ * calibration pot.
+ */
+const unsigned long WARM_START_SAVE_DELAY_MS = 2000;
+
+struct WarmStartState {
+    uint8_t version = WARM_START_VERSION;
+    /**
+     * A bit for each gate that was open.
+     */
+    uint8_t openGates = 0;
+    int openReading = 0;
+    int closedReading = 0;
+    /**
+     * Only kept in the watchdog's snapshot (see Watchdog), which is from a
+     * moment ago.  From EEPROM we can't tell how long the power was out, so
+     * the dust collector waits for the next RUNNING instead.
+     */
+    uint8_t dustCollectorOn = false;
+    uint8_t checksum = 0;
+};
+
+class WarmStart {
+    public:
+        /**
+         * Loads the last saved state of the gate from EEPROM.  Returns false
+         * if there is no valid state, in which case we should do a full cold
+         * start.
+         */
+        bool load();
+        void update(uint8_t openGates, int openReading, int closedReading);
+        const WarmStartState &getState() const { return state; }
+        /**
+         * Takes the state from somewhere fresher than EEPROM (see Watchdog).
+         */
+        void restore(const WarmStartState &saved) { state = saved; }
+    private:
+        WarmStartState state;
+        bool dirty = false;
+        unsigned long lastChangeTime = 0;
+
+        static uint8_t checksum(const WarmStartState &state);
+        void save();
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "Watchdog.h"
+#include <EEPROM.h>
+#include <util/crc16.h>
+#include "EepromLayout.h"
+
+Watchdog watchdog;
+
+/**
+ * Left alone by the C runtime, so they still hold what they did before the
+ * reset.
+ */
+RecoverySnapshot Watchdog::snapshot __attribute__((section(".noinit")));
+uint8_t Watchdog::checkIns __attribute__((section(".noinit")));
+uint8_t resetFlags __attribute__((section(".noinit")));
+
+const char CHECK_IN_NAMES[CHECK_IN_COUNT][9] PROGMEM = {
+    "network",
+    "role",
+    "radio",
+    "gate",
+    "console",
+    "messages",
+};
+
+const char RESET_CAUSE_NAMES[RESET_CAUSE_COUNT][10] PROGMEM = {
+    "power on",
+    "external",
+    "brown out",
+    "watchdog",
+};
+
+/**
+ * Runs before main().  After a watchdog reset the watchdog is still running
+ * at its shortest timeout, and would reset us again long before setup() got
+ * to it.  Optiboot clears MCUSR and hands it over in r2 instead.
+ */
+#if defined(__AVR__)
+void captureResetFlags() __attribute__((naked, used, section(".init3")));
+void captureResetFlags() {
+    uint8_t fromBootloader;
+    __asm__ __volatile__ ("mov %0, r2" : "=r" (fromBootloader));
+    resetFlags = MCUSR ? MCUSR : fromBootloader;
+    MCUSR = 0;
+    wdt_disable();
+}
+#endif
+
+uint8_t Watchdog::crcOf(const RecoverySnapshot &snapshot) {
+    const uint8_t *bytes = (const uint8_t *) &snapshot;
+    uint8_t crc = 0;
+    // Up to the crc rather than the size, which has padding after it
+    // anywhere but avr-gcc.
+    for (uint8_t i = 0; i < offsetof(RecoverySnapshot, crc); i++) {
+        crc = _crc8_ccitt_update(crc, bytes[i]);
+    }
+    return crc;
+}
+
+void Watchdog::setup() {
+    if (resetFlags & _BV(WDRF)) {
+        resetCause = RESET_WATCHDOG;
+    } else if (resetFlags & _BV(BORF)) {
+        resetCause = RESET_BROWN_OUT;
+    } else if (resetFlags & _BV(EXTRF)) {
+        resetCause = RESET_EXTERNAL;
+    } else {
+        resetCause = RESET_POWER_ON;
+    }
+    snapshotValid = resetCause == RESET_WATCHDOG && snapshot.layout == RECOVERY_LAYOUT && snapshot.crc == crcOf(snapshot);
+
+    if (EEPROM.read(EEPROM_RESETS_ADDRESS) != RECOVERY_LAYOUT) {
+        for (uint8_t i = 1; i < 2 * RESET_CAUSE_COUNT + 2; i++) {
+            EEPROM.update(EEPROM_RESETS_ADDRESS + i, 0);
+        }
+        EEPROM.update(EEPROM_RESETS_ADDRESS, RECOVERY_LAYOUT);
+    }
+    uint16_t count;
+    EEPROM.get(EEPROM_RESETS_ADDRESS + 1 + 2 * resetCause, count);
+    count++;
+    EEPROM.put(EEPROM_RESETS_ADDRESS + 1 + 2 * resetCause, count);
+    if (resetCause == RESET_WATCHDOG) {
+        // Who didn't check in, for the report.
+        EEPROM.update(EEPROM_RESETS_ADDRESS + 1 + 2 * RESET_CAUSE_COUNT, ~checkIns & ALL_CHECK_INS);
+        Serial.print(F("Watchdog reset.  "));
+        if (snapshotValid) {
+            Serial.println(F("Resuming"));
+        } else {
+            Serial.println(F("No state to resume"));
+        }
+    }
+    checkIns = 0;
+}
+
+void Watchdog::start() {
+    if (WATCHDOG) {
+        wdt_enable(WATCHDOG_TIMEOUT);
+    } else {
+        wdt_disable();
+    }
+}
+
+void Watchdog::onLoop() {
+    if (checkIns == ALL_CHECK_INS) {
+        wdt_reset();
+        checkIns = 0;
+    }
+}
+
+void Watchdog::save(const WarmStartState &state, const uint8_t *activeMachines) {
+    snapshot.layout = RECOVERY_LAYOUT;
+    snapshot.state = state;
+    memcpy(snapshot.activeMachines, activeMachines, sizeof(snapshot.activeMachines));
+    snapshot.crc = crcOf(snapshot);
+}
+
+void Watchdog::report() const {
+    Serial.print(F("Last reset: "));
+    Serial.print((const __FlashStringHelper *) RESET_CAUSE_NAMES[resetCause]);
+    Serial.print(F(".  Resets:"));
+    for (uint8_t i = 0; i < RESET_CAUSE_COUNT; i++) {
+        uint16_t count;
+        EEPROM.get(EEPROM_RESETS_ADDRESS + 1 + 2 * i, count);
+        Serial.print(F(" "));
+        Serial.print((const __FlashStringHelper *) RESET_CAUSE_NAMES[i]);
+        Serial.print(F("="));
+        Serial.print(count);
+    }
+    uint8_t missing = EEPROM.read(EEPROM_RESETS_ADDRESS + 1 + 2 * RESET_CAUSE_COUNT);
+    if (missing != 0) {
+        Serial.print(F(".  Last hang in:"));
+        for (uint8_t i = 0; i < CHECK_IN_COUNT; i++) {
+            if (missing & (1 << i)) {
+                Serial.print(F(" "));
+                Serial.print((const __FlashStringHelper *) CHECK_IN_NAMES[i]);
+            }
+        }
+    }
+    Serial.println();
+}
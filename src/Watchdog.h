@@ -0,0 +1,93 @@
+#ifndef watchdog_h
+#define watchdog_h
+
+#include <Arduino.h>
+#include <avr/wdt.h>
+#include "Constants.h"
+#include "Ids.h"
+#include "WarmStart.h"
+
+/**
+ * Resets the node if loop() doesn't come around for this long.  The longest
+ * honest loop is a full gate swing (180 steps of DELAY_BETWEEN_SERVO_STEPS_MS)
+ * plus a current reading, well under a second.
+ */
+const bool WATCHDOG = true;
+const uint8_t WATCHDOG_TIMEOUT = WDTO_4S;
+
+/**
+ * Every subsystem checks in once per loop, and the watchdog only gets reset
+ * when they all have.  After a watchdog reset, the ones missing say where it
+ * got stuck.
+ */
+enum CheckIn {
+    CHECK_IN_NETWORK,  // Lease, channel and link upkeep
+    CHECK_IN_ROLE,     // Current sensing, collector and branch timers
+    CHECK_IN_RADIO,
+    CHECK_IN_GATE,
+    CHECK_IN_CONSOLE,
+    CHECK_IN_MESSAGES,
+    CHECK_IN_COUNT
+};
+const uint8_t ALL_CHECK_INS = (1 << CHECK_IN_COUNT) - 1;
+
+enum ResetCause {
+    RESET_POWER_ON,
+    RESET_EXTERNAL,
+    RESET_BROWN_OUT,
+    RESET_WATCHDOG,
+    RESET_CAUSE_COUNT
+};
+
+/**
+ * What we need to pick up where we left off.  Kept in .noinit SRAM, which
+ * survives a reset but not a power cycle, so it is only trusted after a
+ * watchdog reset and with a good CRC.
+ */
+struct RecoverySnapshot {
+    uint8_t layout;
+    WarmStartState state;
+    uint8_t activeMachines[(MAX_NODES + 7) / 8];
+    uint8_t crc;
+};
+const uint8_t RECOVERY_LAYOUT = 1;
+
+/**
+ * The hardware watchdog.  Also counts why we reset, in EEPROM, and keeps the
+ * state snapshot that lets setup() skip straight to a warm start after a
+ * watchdog reset.
+ */
+class Watchdog {
+    public:
+        /**
+         * First thing in setup().
+         */
+        void setup();
+        /**
+         * Arms the watchdog.  Also after PowerManager has used it to wake up.
+         */
+        void start();
+        void checkIn(CheckIn checkIn) { checkIns |= 1 << checkIn; }
+        /**
+         * Last thing in loop().
+         */
+        void onLoop();
+        ResetCause getResetCause() const { return resetCause; }
+        /**
+         * The state from before a watchdog reset, or NULL.
+         */
+        const RecoverySnapshot *getSnapshot() const { return snapshotValid ? &snapshot : NULL; }
+        void save(const WarmStartState &state, const uint8_t *activeMachines);
+        void report() const;
+    private:
+        ResetCause resetCause = RESET_POWER_ON;
+        bool snapshotValid = false;
+        static uint8_t checkIns;
+        static RecoverySnapshot snapshot;
+
+        static uint8_t crcOf(const RecoverySnapshot &snapshot);
+};
+
+extern Watchdog watchdog;
+
+#endif
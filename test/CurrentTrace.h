@@ -0,0 +1,41 @@
+#ifndef current_trace_h
+#define current_trace_h
+
+#include <Arduino.h>
+#include <NativeBench.h>
+#include "Constants.h"
+
+/**
+ * A motor's current on the fake ADC, for the native tests.  The sensor sits
+ * at half supply and swings 66mV/A, the way CurrentDetector reads it.  The
+ * fundamental is set by its RMS amps, plus an optional third harmonic (an
+ * idle induction motor has plenty) and a few counts of noise.
+ */
+struct CurrentTrace {
+    double amps = 0;
+    uint8_t thirdHarmonicPercent = 0;
+    int noise = 2;
+};
+
+static CurrentTrace currentTrace;
+
+static int currentTraceReading(uint8_t pin) {
+    const double countsPerAmp = M_SQRT2 * 0.066 * 1023 / 5;
+    double phase = (benchNowMicros() % (1000000UL / MAINS_HZ)) * (2 * PI * MAINS_HZ / 1000000.0);
+    double amplitude = currentTrace.amps * countsPerAmp;
+    double reading = 512 + amplitude * sin(phase)
+        + amplitude * currentTrace.thirdHarmonicPercent / 100 * sin(3 * phase);
+    int noisy = (int) reading + random(-currentTrace.noise, currentTrace.noise + 1);
+    return constrain(noisy, 0, 1023);
+}
+
+/**
+ * Puts the trace on the current sensor pin.
+ */
+static void setCurrent(double amps, uint8_t thirdHarmonicPercent = 0) {
+    currentTrace.amps = amps;
+    currentTrace.thirdHarmonicPercent = thirdHarmonicPercent;
+    benchSetAnalogSource(currentTraceReading);
+}
+
+#endif
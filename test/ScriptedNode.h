@@ -0,0 +1,87 @@
+#ifndef scripted_node_h
+#define scripted_node_h
+
+#include <Arduino.h>
+#include <Air.h>
+#include <NativeBench.h>
+#include "RadioController.h"
+
+/**
+ * Another node on the fake air (see lib/NativeStubs/Air.h), for the native
+ * tests.  The firmware under test is built for a single role, so the other
+ * side of a scenario is scripted with these: they send frames the way
+ * RadioController does and keep whatever is sent to them.
+ */
+class ScriptedNode {
+    public:
+        ScriptedNode() : radio(0, 0) {}
+
+        /**
+         * Powers up listening on the broadcast pipe.  Without auto ACK we
+         * never ACK anything, like the gateway.
+         */
+        void begin(uint8_t channel, rf24_datarate_e dataRate, bool autoAck) {
+            radio.begin();
+            radio.setChannel(channel);
+            radio.setDataRate(dataRate);
+            radio.setCRCLength(CRC_LENGTH);
+            radio.setPayloadSize(payloadSize);
+            radio.setAutoAck(autoAck);
+            radio.setRetries(MIN_RETRANSMIT_DELAY, RETRANSMIT_COUNT);
+            radio.openReadingPipe(BROADCAST_PIPE, myAddress);
+            radio.startListening();
+        }
+
+        void moveTo(uint8_t channel) {
+            radio.stopListening();
+            radio.setChannel(channel);
+            radio.startListening();
+        }
+
+        uint8_t address = ADDRESS_UNSET;
+        uint32_t id = VALUE_UNSET;
+        RF24 radio;
+
+        bool send(Payload &payload) {
+            payload.messageId = ++lastMessageId;
+            payload.id = address;
+            radio.stopListening();
+            radio.openWritingPipe(sendAddress);
+            bool delivered = radio.write(&payload, payloadSize);
+            radio.startListening();
+            return delivered;
+        }
+
+        bool send(Command command, uint8_t toId = ADDRESS_UNSET, uint32_t data = VALUE_UNSET) {
+            Payload payload;
+            payload.command = command;
+            payload.toId = toId;
+            payload.data = data;
+            return send(payload);
+        }
+
+        /**
+         * The next frame heard, whoever it was for.
+         */
+        bool receive(Payload &payload) {
+            if (!radio.available()) {
+                return false;
+            }
+            radio.read(&payload, payloadSize);
+            return true;
+        }
+
+        /**
+         * Throws away what has been heard so far.
+         */
+        void drain() {
+            Payload ignored;
+            while (receive(ignored)) {
+            }
+        }
+
+    private:
+        uint32_t lastMessageId = 0;
+};
+
+#endif
@@ -0,0 +1,228 @@
+#include <Arduino.h>
+#include <NativeBench.h>
+#include <unity.h>
+#include <stdlib.h>
+#include <time.h>
+#include "RadioController.h"
+#include "CurrentDetector.h"
+#include "../ScriptedNode.h"
+
+/**
+ * What the firmware hot paths cost on the host, built for whichever role the
+ * environment picks (pio test -e native -f test_benchmark, or any other
+ * native_* environment).  Each prints its ns/op and how many heap
+ * allocations it made, which should always be none: everything on the
+ * device is allocated statically.
+ *
+ * The numbers are only good for comparing one build with another on the same
+ * machine.  Anything that waits on the clock (current estimation blocks for a
+ * mains cycle) spins through the fake micros() instead.
+ */
+
+void setup();
+void loop();
+void processCommand(const Payload &payload);
+extern RadioController radioController;
+extern Ids ids;
+
+const unsigned long FAST_ITERATIONS = 20000;
+const unsigned long SLOW_ITERATIONS = 500;
+
+static unsigned long allocations = 0;
+
+void *operator new(size_t size) {
+    allocations++;
+    return malloc(size);
+}
+
+void *operator new[](size_t size) {
+    allocations++;
+    return malloc(size);
+}
+
+void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t size) noexcept {
+    free(pointer);
+}
+
+void operator delete[](void *pointer, size_t size) noexcept {
+    free(pointer);
+}
+
+static unsigned long long nowNs() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+typedef void (*Step)();
+
+/**
+ * Times op, with prepare (not timed) before each run of it, then reports
+ * and checks it allocated nothing.
+ */
+static void measure(const char *name, Step prepare, Step op, unsigned long iterations) {
+    unsigned long long totalNs = 0;
+    unsigned long allocationsBefore = allocations;
+    for (unsigned long i = 0; i < iterations; i++) {
+        if (prepare != NULL) {
+            prepare();
+        }
+        unsigned long long start = nowNs();
+        op();
+        totalNs += nowNs() - start;
+        Serial.clearOutput();
+    }
+    unsigned long made = allocations - allocationsBefore;
+    char line[96];
+    snprintf(line, sizeof(line), "%s: %llu ns/op, %lu allocations", name, totalNs / iterations, made);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_EQUAL_UINT32_MESSAGE(0, made, name);
+}
+
+ScriptedNode peer;
+Payload frame;
+Payload received;
+unsigned long accepted = 0;
+unsigned long iteration = 0;
+volatile unsigned long sink = 0;
+
+static Payload running() {
+    Payload payload;
+    payload.command = RUNNING;
+    payload.load = LOAD_CUTTING;
+    payload.demand = 40;
+    return payload;
+}
+
+static void sendRunning() {
+    benchAdvanceMicros(1000);
+    Payload payload = running();
+    peer.send(payload);
+}
+
+static void getMessage() {
+    if (radioController.getMessage(received)) {
+        accepted++;
+    }
+}
+
+void test_get_message() {
+    accepted = 0;
+    measure("RadioController::getMessage", sendRunning, getMessage, FAST_ITERATIONS);
+    TEST_ASSERT_EQUAL_UINT32(FAST_ITERATIONS, accepted);
+}
+
+static void processRunning() {
+    processCommand(frame);
+}
+
+void test_process_command() {
+    frame = running();
+    frame.messageId = 1;
+    frame.id = peer.address;
+    measure("processCommand RUNNING", NULL, processRunning, FAST_ITERATIONS);
+    frame.command = HEARTBEAT;
+    frame.data = peer.id;
+    measure("processCommand HEARTBEAT", NULL, processRunning, FAST_ITERATIONS);
+    frame.command = NO_LONGER_RUNNING;
+    measure("processCommand NO_LONGER_RUNNING", NULL, processRunning, FAST_ITERATIONS);
+}
+
+uint8_t bytes[RF24_MAX_PAYLOAD];
+
+static void encode() {
+    Payload payload = running();
+    payload.messageId = ++iteration;
+    payload.id = peer.address;
+    payload.gateCode = 0x05;
+    memcpy(bytes, &payload, payloadSize);
+}
+
+static void decode() {
+    memcpy(&received, bytes, payloadSize);
+    sink += received.messageId != 0 && received.command != UNKNOWN;
+}
+
+void test_payload_encode_decode() {
+    measure("Payload encode", NULL, encode, FAST_ITERATIONS);
+    measure("Payload decode", NULL, decode, FAST_ITERATIONS);
+    TEST_ASSERT_EQUAL_UINT32(iteration, received.messageId);
+}
+
+/**
+ * 10A on a 66mV/A sensor, plus a bit of noise.
+ */
+static int runningCurrent(uint8_t pin) {
+    float phase = (benchNowMicros() % (1000000UL / MAINS_HZ)) * (2 * PI * MAINS_HZ / 1000000.0);
+    return 512 + (int) (191 * sin(phase)) + random(-3, 4);
+}
+
+CurrentDetector detector;
+
+static void estimateCurrent() {
+    detector.onLoop();
+}
+
+void test_current_estimation() {
+    benchSetAnalogSource(runningCurrent);
+    measure("CurrentDetector::onLoop", NULL, estimateCurrent, SLOW_ITERATIONS);
+    benchSetAnalogSource(NULL);
+    TEST_ASSERT_FLOAT_WITHIN(1.0, 10.0, detector.getAmps());
+}
+
+static void gateCode() {
+    sink += ids.currentGateCode();
+}
+
+void test_current_gate_code() {
+    measure("Ids::currentGateCode", NULL, gateCode, FAST_ITERATIONS);
+}
+
+/**
+ * A machine starting every so often, with the current to go with it.
+ */
+static void scriptLoop() {
+    iteration++;
+    benchAdvanceMicros(1000);
+    if (iteration % 20 == 0) {
+        Payload payload = running();
+        peer.send(payload);
+    }
+    benchSetAnalogSource((iteration / 200) % 2 == 0 ? runningCurrent : NULL);
+}
+
+void test_loop() {
+    iteration = 0;
+    measure("loop()", scriptLoop, loop, SLOW_ITERATIONS);
+    benchSetAnalogSource(NULL);
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+int main(int argc, char **argv) {
+    setup();
+    peer.address = FIRST_NODE_ADDRESS + 5;
+    peer.id = 0x12345678;
+    peer.begin(radioController.getChannel(), radioController.getDataRate(), false);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_get_message);
+    RUN_TEST(test_process_command);
+    RUN_TEST(test_payload_encode_decode);
+    RUN_TEST(test_current_estimation);
+    RUN_TEST(test_current_gate_code);
+    RUN_TEST(test_loop);
+    return UNITY_END();
+}
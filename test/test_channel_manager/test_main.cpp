@@ -0,0 +1,187 @@
+#include <Arduino.h>
+#include <Air.h>
+#include <EEPROM.h>
+#include <NativeBench.h>
+#include <unity.h>
+#include <limits.h>
+#include "RadioController.h"
+#include "ChannelManager.h"
+#include "EepromLayout.h"
+#include "LeaseTable.h"
+#include "PowerManager.h"
+#include "../ScriptedNode.h"
+
+/**
+ * ChannelManager on a band with interference.  Built as the dust collector,
+ * its survey has to move the network off a channel that Wi-Fi took over.
+ * Built as a node, it has to find the collector again after missing the
+ * announcement that it moved.
+ */
+
+void setup();
+void loop();
+extern RadioController radioController;
+
+const uint8_t QUIET_CHANNEL = FIRST_CANDIDATE_CHANNEL + 7 * CANDIDATE_CHANNEL_STEP;
+const uint8_t INTERFERENCE_PERCENT = 90;
+const unsigned long NEVER = ULONG_MAX;
+
+/**
+ * Plays the dust collector against a node, or a node listening to the
+ * real one.
+ */
+ScriptedNode peer;
+unsigned long lastBeaconTime = 0;
+
+typedef void (*Step)();
+
+/**
+ * Runs the firmware for up to ms, doing step every loop, until the radio is
+ * on channel (or, with on false, anywhere else).  Returns when that
+ * happened, or NEVER.
+ */
+static unsigned long runUntil(bool on, uint8_t channel, unsigned long ms, Step step) {
+    unsigned long end = millis() + ms;
+    while (millis() < end) {
+        benchAdvanceMicros(5000);
+        loop();
+        if (step != NULL) {
+            step();
+        }
+        Serial.clearOutput();
+        if ((radioController.getChannel() == channel) == on) {
+            return millis();
+        }
+    }
+    return NEVER;
+}
+
+static unsigned long runUntilOn(uint8_t channel, unsigned long ms, Step step) {
+    return runUntil(true, channel, ms, step);
+}
+
+static unsigned long runUntilOff(uint8_t channel, unsigned long ms, Step step) {
+    return runUntil(false, channel, ms, step);
+}
+
+static uint8_t savedChannel() {
+    return EEPROM.read(EEPROM_CHANNEL_ADDRESS);
+}
+
+void test_survey_moves_off_interference() {
+    air.noisePercent[CHANNEL] = INTERFERENCE_PERCENT;
+    // Some of the others are busy too, just less.
+    for (uint8_t i = 0; i < CANDIDATE_CHANNEL_COUNT; i++) {
+        uint8_t channel = FIRST_CANDIDATE_CHANNEL + i * CANDIDATE_CHANNEL_STEP;
+        if (channel != CHANNEL && i % 3 == 0) {
+            air.noisePercent[channel] = 30;
+        }
+    }
+    air.noisePercent[QUIET_CHANNEL] = 0;
+
+    // The first survey pass starts after one interval, and takes a step per channel.
+    unsigned long surveyDone = CHANNEL_SURVEY_INTERVAL_MS + CANDIDATE_CHANNEL_COUNT * CHANNEL_SURVEY_STEP_MS;
+    unsigned long moved = runUntilOff(CHANNEL, surveyDone + CHANNEL_SWITCH_DELAY_MS + 5000, NULL);
+    TEST_ASSERT_NOT_EQUAL(NEVER, moved);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(CHANNEL_SURVEY_INTERVAL_MS, moved);
+    uint8_t after = radioController.getChannel();
+    TEST_ASSERT_EQUAL_UINT8(0, air.noisePercent[after]);
+    TEST_ASSERT_EQUAL_UINT8(after, savedChannel());
+
+    // Nodes that followed hear the beacons on the new channel.
+    peer.moveTo(after);
+    peer.drain();
+    bool heardBeacon = false;
+    unsigned long end = millis() + BEACON_INTERVAL_MS + 5000;
+    while (millis() < end && !heardBeacon) {
+        runUntilOff(after, 100, NULL);
+        Payload payload;
+        while (peer.receive(payload)) {
+            heardBeacon = heardBeacon || (payload.command == BEACON && payload.id == DUST_COLLECTOR_ADDRESS);
+        }
+    }
+    TEST_ASSERT_TRUE(heardBeacon);
+    // And stays there through the next surveys.
+    TEST_ASSERT_EQUAL_UINT32(NEVER, runUntilOff(after, 2 * CHANNEL_SURVEY_INTERVAL_MS, NULL));
+}
+
+/**
+ * The collector beacons, and leases an address to anyone who says hello.
+ * The WELCOME goes out a little after the hello, as it does from
+ * LeaseTable, so it doesn't land on top of it.
+ */
+static void playCollector() {
+    if ((lastBeaconTime + BEACON_INTERVAL_MS) < millis()) {
+        lastBeaconTime = millis();
+        peer.send(BEACON, ADDRESS_UNSET, millis());
+    }
+    Payload payload;
+    while (peer.receive(payload)) {
+        if (payload.command == HELLO_WORLD || payload.command == HEARTBEAT) {
+            benchAdvanceMicros(WELCOME_SPACING_MS * 1000);
+            peer.send(WELCOME, FIRST_NODE_ADDRESS, payload.data);
+        }
+    }
+}
+
+void test_follows_announced_switch() {
+    uint8_t home = radioController.getChannel();
+    TEST_ASSERT_EQUAL_UINT32(NEVER, runUntilOff(home, 2 * BEACON_INTERVAL_MS, playCollector));
+    unsigned long announced = millis();
+    peer.send(CHANNEL_CHANGE, ADDRESS_UNSET,
+        (CHANNEL_SWITCH_DELAY_MS << 16) | ((unsigned long) radioController.getDataRate() << 8) | QUIET_CHANNEL);
+    unsigned long moved = runUntilOff(home, CHANNEL_SWITCH_DELAY_MS + 1000, playCollector);
+    TEST_ASSERT_NOT_EQUAL(NEVER, moved);
+    TEST_ASSERT_EQUAL_UINT8(QUIET_CHANNEL, radioController.getChannel());
+    // Counted from when it was heard, which can be most of a loop later: a
+    // machine's loop averages both pots and reads a mains cycle.  The stubs
+    // don't pull the radio IRQ, so a node that sleeps only hears it when it
+    // wakes on its own.
+    unsigned long slack = 1000 + (LOW_POWER_IDLE ? IDLE_MAX_SLEEP_MS : 0);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(announced + CHANNEL_SWITCH_DELAY_MS, moved);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(announced + CHANNEL_SWITCH_DELAY_MS + slack, moved);
+    TEST_ASSERT_EQUAL_UINT8(QUIET_CHANNEL, savedChannel());
+    peer.moveTo(QUIET_CHANNEL);
+}
+
+void test_rejoins_after_missed_announcement() {
+    uint8_t home = radioController.getChannel();
+    uint8_t away = home == QUIET_CHANNEL ? QUIET_CHANNEL + CANDIDATE_CHANNEL_STEP : QUIET_CHANNEL;
+    TEST_ASSERT_EQUAL_UINT32(NEVER, runUntilOff(home, 2 * BEACON_INTERVAL_MS, playCollector));
+
+    // The collector moves and the node never hears about it.
+    unsigned long moveTime = millis();
+    peer.moveTo(away);
+    // How long until it gives up on the collector, then a whole pass of
+    // every channel at every data rate.
+    unsigned long limit = COLLECTOR_CONTACT_TIMEOUT_MS + (unsigned long) CANDIDATE_CHANNEL_COUNT * DATA_RATE_COUNT * CHANNEL_SCAN_DWELL_MS;
+    unsigned long found = runUntilOn(away, limit + 5000, playCollector);
+    TEST_ASSERT_NOT_EQUAL(NEVER, found);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(moveTime + limit, found);
+
+    // Once it hears the collector it stops scanning and stays.
+    TEST_ASSERT_EQUAL_UINT32(NEVER, runUntilOff(away, 3 * BEACON_INTERVAL_MS, playCollector));
+    TEST_ASSERT_EQUAL_UINT8(away, savedChannel());
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+int main(int argc, char **argv) {
+    setup();
+    peer.begin(radioController.getChannel(), radioController.getDataRate(), false);
+
+    UNITY_BEGIN();
+    if (mode == DUST_COLLECTOR) {
+        peer.address = FIRST_NODE_ADDRESS + 5;
+        RUN_TEST(test_survey_moves_off_interference);
+    } else if (Role::transmits) {
+        peer.address = DUST_COLLECTOR_ADDRESS;
+        RUN_TEST(test_follows_announced_switch);
+        RUN_TEST(test_rejoins_after_missed_announcement);
+    }
+    return UNITY_END();
+}
@@ -0,0 +1,279 @@
+#include <Arduino.h>
+#include <Air.h>
+#include <NativeBench.h>
+#include <unity.h>
+#include <limits.h>
+#include "RadioController.h"
+#include "Config.h"
+#include "ConfigPush.h"
+#include "PowerManager.h"
+#include "../ScriptedNode.h"
+
+/**
+ * ConfigPush on a lossy band.  Built as the dust collector, a new version has
+ * to reach a shop's worth of nodes within CONFIG_MAX_ROUNDS.  Built as a
+ * node, a block it only got part of (or that fails its CRC) must never go
+ * live.
+ */
+
+void setup();
+void loop();
+void onConfigCommand(uint8_t argc, char **argv);
+extern RadioController radioController;
+
+const uint8_t NODES = 30;
+const uint8_t LOSS_PERCENT = 20;
+const uint32_t FIRST_NODE_ID = 1000;
+const unsigned long NEVER = ULONG_MAX;
+
+/**
+ * A node scripted to answer the collector the way ConfigPush does: it stages
+ * chunks, applies the block once it has all of one version and the CRC
+ * checks out, and answers each end of round after a random wait.
+ */
+struct ConfigNode {
+    ScriptedNode node;
+    ConfigValues current;
+    ConfigValues staged;
+    uint8_t stagedVersion = 0;
+    uint16_t stagedChunks = 0;
+    uint8_t replyVersion = 0;
+    unsigned long replyTime = VALUE_UNSET;
+    unsigned long nextHelloTime = VALUE_UNSET;
+    uint8_t badBlocks = 0;
+
+    uint16_t chunksOf(uint8_t version) const {
+        if (version == current.version) {
+            return CONFIG_ALL_CHUNKS;
+        }
+        return version == stagedVersion ? stagedChunks : 0;
+    }
+
+    void onChunk(const Payload &payload) {
+        uint8_t version = payload.data >> 24;
+        uint8_t index = (payload.data >> 16) & 0xFF;
+        if (index == CONFIG_END_OF_ROUND) {
+            replyVersion = version;
+            replyTime = millis() + random(CONFIG_REPLY_SPREAD_MS);
+            return;
+        }
+        if (version == current.version || index >= CONFIG_CHUNK_COUNT) {
+            return;
+        }
+        if (version != stagedVersion) {
+            stagedVersion = version;
+            stagedChunks = 0;
+        }
+        uint8_t *bytes = (uint8_t *) &staged;
+        for (uint8_t i = 0; i < CONFIG_CHUNK_BYTES && index * CONFIG_CHUNK_BYTES + i < CONFIG_SIZE; i++) {
+            bytes[index * CONFIG_CHUNK_BYTES + i] = payload.data >> (8 * i);
+        }
+        stagedChunks |= 1 << index;
+        if (stagedChunks == CONFIG_ALL_CHUNKS) {
+            if (staged.version == version && staged.crc == Config::crcOf(staged)) {
+                current = staged;
+            } else {
+                badBlocks++;
+            }
+            stagedChunks = 0;
+        }
+    }
+
+    /**
+     * Says hello until it has a lease, then handles whatever was heard.
+     */
+    void step() {
+        Payload payload;
+        while (node.receive(payload)) {
+            if (payload.id != DUST_COLLECTOR_ADDRESS) {
+                continue;
+            }
+            if (payload.command == WELCOME && payload.data == node.id) {
+                node.address = payload.toId;
+            } else if (payload.command == CONFIG_CHUNK) {
+                onChunk(payload);
+            }
+        }
+        if (node.address == ADDRESS_UNSET && nextHelloTime <= millis()) {
+            node.send(HELLO_WORLD, ADDRESS_UNSET, node.id);
+            nextHelloTime = millis() + LEASE_REQUEST_RETRY_MS + random(LEASE_REQUEST_RETRY_MS);
+        }
+        if (replyTime != VALUE_UNSET && replyTime <= millis()) {
+            replyTime = VALUE_UNSET;
+            node.send(CONFIG_STATUS, DUST_COLLECTOR_ADDRESS, ((unsigned long) replyVersion << 16) | chunksOf(replyVersion));
+        }
+    }
+};
+
+ConfigNode nodes[NODES];
+unsigned long endOfRounds = 0;
+
+static void countEndOfRounds(const uint8_t *frame, uint8_t length, uint8_t attempts, bool delivered) {
+    const Payload *payload = (const Payload *) frame;
+    if (payload->command == CONFIG_CHUNK && ((payload->data >> 16) & 0xFF) == CONFIG_END_OF_ROUND) {
+        endOfRounds++;
+    }
+}
+
+/**
+ * Runs the collector and every scripted node for up to ms, or until the
+ * collector prints text if there is one.  Returns when that happened, or
+ * NEVER.
+ */
+static unsigned long runCollectorUntil(const char *text, unsigned long ms) {
+    unsigned long end = millis() + ms;
+    while (millis() < end) {
+        benchAdvanceMicros(1000);
+        loop();
+        for (uint8_t i = 0; i < NODES; i++) {
+            nodes[i].step();
+        }
+        bool done = text != NULL && Serial.printed(text);
+        Serial.clearOutput();
+        if (done) {
+            return millis();
+        }
+    }
+    return NEVER;
+}
+
+static uint8_t countLeased() {
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < NODES; i++) {
+        count += nodes[i].node.address != ADDRESS_UNSET;
+    }
+    return count;
+}
+
+void test_push_reaches_every_node_under_loss() {
+    for (uint8_t i = 0; i < NODES; i++) {
+        nodes[i].node.id = FIRST_NODE_ID + i;
+        nodes[i].node.begin(radioController.getChannel(), radioController.getDataRate(), true);
+        nodes[i].nextHelloTime = millis() + random(HELLO_STAGGER_MS);
+    }
+    // Everyone joins, and is asked whether it has the config they all start with.
+    unsigned long end = millis() + 60000;
+    while (countLeased() < NODES && millis() < end) {
+        runCollectorUntil(NULL, 100);
+    }
+    TEST_ASSERT_EQUAL_UINT8(NODES, countLeased());
+    TEST_ASSERT_NOT_EQUAL(NEVER, runCollectorUntil(" is on every node", CONFIG_MAX_ROUNDS * CONFIG_ROUND_MS + 5000));
+
+    air.lossPercent = LOSS_PERCENT;
+    air.setObserver(countEndOfRounds);
+    char name[] = "on";
+    char value[] = "250";
+    char command[] = "config";
+    char *argv[] = {command, name, value};
+    onConfigCommand(3, argv);
+    TEST_ASSERT_EQUAL_UINT16(250, config.get().activateAboveCentiamps);
+
+    // Every round sends at most every chunk, then waits on the answers.
+    unsigned long roundMs = CONFIG_ROUND_MS + CONFIG_CHUNK_COUNT * 100;
+    unsigned long finished = runCollectorUntil(" is on every node", CONFIG_MAX_ROUNDS * roundMs);
+    TEST_ASSERT_NOT_EQUAL(NEVER, finished);
+    air.setObserver(NULL);
+    air.lossPercent = 0;
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(CONFIG_MAX_ROUNDS, endOfRounds);
+
+    for (uint8_t i = 0; i < NODES; i++) {
+        TEST_ASSERT_EQUAL_UINT8(0, nodes[i].badBlocks);
+        TEST_ASSERT_EQUAL_MEMORY(&config.get(), &nodes[i].current, CONFIG_SIZE);
+    }
+}
+
+/**
+ * Plays the dust collector against the node.
+ */
+ScriptedNode collector;
+
+/**
+ * Runs the firmware until it answers an end of round, and returns the
+ * chunks it says it has.
+ */
+static uint16_t endRound(uint8_t version) {
+    collector.send(CONFIG_CHUNK, ADDRESS_UNSET, ((unsigned long) version << 24) | ((unsigned long) CONFIG_END_OF_ROUND << 16));
+    // The stubs don't pull the radio IRQ, so a node that sleeps only hears
+    // it when it wakes on its own.
+    unsigned long end = millis() + CONFIG_REPLY_SPREAD_MS + 1000 + (LOW_POWER_IDLE ? IDLE_MAX_SLEEP_MS : 0);
+    while (millis() < end) {
+        benchAdvanceMicros(5000);
+        loop();
+        Serial.clearOutput();
+        Payload payload;
+        while (collector.receive(payload)) {
+            if (payload.command == CONFIG_STATUS && payload.toId == DUST_COLLECTOR_ADDRESS && (payload.data >> 16) == version) {
+                return payload.data & 0xFFFF;
+            }
+        }
+    }
+    TEST_FAIL_MESSAGE("No CONFIG_STATUS");
+    return 0;
+}
+
+/**
+ * Sends one chunk of block, with its bytes xor'ed with corrupt, and gives
+ * the firmware a loop to read it so its receive FIFO never overflows.
+ */
+static void sendChunk(const ConfigValues &block, uint8_t index, uint8_t corrupt = 0) {
+    const uint8_t *bytes = (const uint8_t *) &block;
+    unsigned long data = ((unsigned long) block.version << 24) | ((unsigned long) index << 16);
+    for (uint8_t i = 0; i < CONFIG_CHUNK_BYTES && index * CONFIG_CHUNK_BYTES + i < CONFIG_SIZE; i++) {
+        data |= (unsigned long) (bytes[index * CONFIG_CHUNK_BYTES + i] ^ corrupt) << (8 * i);
+    }
+    collector.send(CONFIG_CHUNK, ADDRESS_UNSET, data);
+    benchAdvanceMicros(5000);
+    loop();
+    Serial.clearOutput();
+}
+
+void test_partial_block_is_never_applied() {
+    ConfigValues before = config.get();
+    ConfigValues next = before;
+    next.version++;
+    next.activateAboveCentiamps += 50;
+    next.crc = Config::crcOf(next);
+
+    // Half of it, then the round ends.
+    uint16_t sent = 0;
+    for (uint8_t index = 0; index < CONFIG_CHUNK_COUNT / 2; index++) {
+        sendChunk(next, index);
+        sent |= 1 << index;
+    }
+    TEST_ASSERT_EQUAL_UINT16(sent, endRound(next.version));
+    TEST_ASSERT_EQUAL_MEMORY(&before, &config.get(), CONFIG_SIZE);
+
+    // The rest, but one of them garbled: every chunk is in and the CRC fails.
+    for (uint8_t index = CONFIG_CHUNK_COUNT / 2; index < CONFIG_CHUNK_COUNT; index++) {
+        sendChunk(next, index, index == CONFIG_CHUNK_COUNT - 2 ? 0x5A : 0);
+    }
+    TEST_ASSERT_EQUAL_MEMORY(&before, &config.get(), CONFIG_SIZE);
+    TEST_ASSERT_EQUAL_UINT16(0, endRound(next.version));
+
+    // Sent again whole, it goes live.
+    for (uint8_t index = 0; index < CONFIG_CHUNK_COUNT; index++) {
+        sendChunk(next, index);
+    }
+    TEST_ASSERT_EQUAL_MEMORY(&next, &config.get(), CONFIG_SIZE);
+    TEST_ASSERT_EQUAL_UINT16(CONFIG_ALL_CHUNKS, endRound(next.version));
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+int main(int argc, char **argv) {
+    setup();
+
+    UNITY_BEGIN();
+    if (mode == DUST_COLLECTOR) {
+        RUN_TEST(test_push_reaches_every_node_under_loss);
+    } else if (Role::transmits) {
+        collector.address = DUST_COLLECTOR_ADDRESS;
+        collector.begin(radioController.getChannel(), radioController.getDataRate(), true);
+        RUN_TEST(test_partial_block_is_never_applied);
+    }
+    return UNITY_END();
+}
@@ -0,0 +1,126 @@
+#include <Arduino.h>
+#include <Air.h>
+#include <NativeBench.h>
+#include <unity.h>
+#include "RadioController.h"
+#include "../ScriptedNode.h"
+
+/**
+ * How many auto retries each delivered frame costs when a group of nodes all
+ * have something to say at once, as when a machine starts and every branch
+ * gate answers.  Before CSMA every radio went straight on air with the RF24
+ * library's default auto retransmit delay, the same on all of them.  Now
+ * RadioController listens first, backs off, and each radio picks its own
+ * delay.
+ *
+ * The fake air runs the nodes one after another, so two of them never sense
+ * the channel in the same instant.  On the device a few frames still collide
+ * that way, so expect some retries where this shows next to none.
+ */
+
+const uint8_t NODES = 8;
+const unsigned long BURSTS = 200;
+const unsigned long BURST_INTERVAL_MS = 250;
+const unsigned long STEP_US = 100;
+
+struct Result {
+    unsigned long delivered;
+    unsigned long retries;
+};
+
+/**
+ * The old way, from nodes scripted to do what RadioController used to.
+ */
+static Result runWithoutCsma() {
+    air.reset();
+    ScriptedNode nodes[NODES];
+    for (uint8_t i = 0; i < NODES; i++) {
+        nodes[i].address = FIRST_NODE_ADDRESS + i;
+        nodes[i].begin(CHANNEL, RADIO_DATA_RATE, true);
+        // What the library's begin() leaves it at.
+        nodes[i].radio.setRetries(5, 15);
+    }
+    for (unsigned long burst = 0; burst < BURSTS; burst++) {
+        for (uint8_t i = 0; i < NODES; i++) {
+            nodes[i].send(HEARTBEAT);
+            nodes[i].drain();
+        }
+        benchAdvanceMicros(BURST_INTERVAL_MS * 1000);
+    }
+    Result result = {air.getDelivered(), air.getDeliveredRetries()};
+    return result;
+}
+
+StatusController nodeStatus;
+
+/**
+ * A node running the real RadioController, each with its own radio on the
+ * fake air.
+ */
+struct CsmaNode {
+    Ids ids;
+    RadioController radioController;
+    CsmaNode() : radioController(nodeStatus, ids) {}
+};
+
+CsmaNode csmaNodes[NODES];
+
+static Result runWithCsma() {
+    air.reset();
+    for (uint8_t i = 0; i < NODES; i++) {
+        csmaNodes[i].radioController.setup(true);
+    }
+    for (unsigned long burst = 0; burst < BURSTS; burst++) {
+        for (uint8_t i = 0; i < NODES; i++) {
+            csmaNodes[i].radioController.broadcastCommand(HEARTBEAT);
+        }
+        // Everyone goes around loop() until the queues are empty.
+        unsigned long end = millis() + BURST_INTERVAL_MS;
+        while (millis() < end) {
+            benchAdvanceMicros(STEP_US);
+            for (uint8_t i = 0; i < NODES; i++) {
+                csmaNodes[i].radioController.onLoop();
+                Payload ignored;
+                csmaNodes[i].radioController.getMessage(ignored);
+            }
+            Serial.clearOutput();
+        }
+    }
+    for (uint8_t i = 0; i < NODES; i++) {
+        TEST_ASSERT_TRUE(csmaNodes[i].radioController.isSendQueueEmpty());
+    }
+    Result result = {air.getDelivered(), air.getDeliveredRetries()};
+    return result;
+}
+
+void test_retries_per_delivered_frame() {
+    Result before = runWithoutCsma();
+    Result after = runWithCsma();
+
+    double retriesBefore = (double) before.retries / before.delivered;
+    double retriesAfter = (double) after.retries / after.delivered;
+    char line[96];
+    snprintf(line, sizeof(line), "before: %lu delivered, %.2f retries each", before.delivered, retriesBefore);
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line), "after: %lu delivered, %.2f retries each", after.delivered, retriesAfter);
+    TEST_MESSAGE(line);
+
+    // Everything that went out got through, and for far fewer retries.
+    TEST_ASSERT_EQUAL_UINT32(NODES * BURSTS, after.delivered);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(before.delivered, after.delivered);
+    TEST_ASSERT_TRUE(retriesAfter * 4 < retriesBefore);
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    if (Role::transmits) {
+        RUN_TEST(test_retries_per_delivered_frame);
+    }
+    return UNITY_END();
+}
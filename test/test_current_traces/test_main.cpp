@@ -0,0 +1,127 @@
+#include <Arduino.h>
+#include <NativeBench.h>
+#include <unity.h>
+#include <limits.h>
+#include "CurrentDetector.h"
+#include "../CurrentTrace.h"
+
+/**
+ * CurrentDetector against recorded-style current traces: a machine sitting
+ * idle, a small tool that only just clears the threshold, and a big motor
+ * with an inrush.  Checks the idle baseline, the on and off hold times, and
+ * that an inrush is trusted within a cycle or two.
+ */
+
+const unsigned long NEVER = ULONG_MAX;
+const double IDLE_AMPS = 0.3;
+
+CurrentDetector detector;
+
+/**
+ * Takes readings for ms, or until the detector says running is what it
+ * wants.  Returns when that happened, or NEVER.
+ */
+static unsigned long readFor(unsigned long ms, bool running) {
+    unsigned long end = millis() + ms;
+    while (millis() < end) {
+        detector.onLoop();
+        if (detector.isRunning() == running) {
+            return millis();
+        }
+    }
+    return NEVER;
+}
+
+static void settleIdle() {
+    setCurrent(IDLE_AMPS);
+    TEST_ASSERT_EQUAL_UINT32(NEVER, readFor(5000, true));
+}
+
+void test_idle_baseline() {
+    settleIdle();
+    TEST_ASSERT_FALSE(detector.isRunning());
+    TEST_ASSERT_FLOAT_WITHIN(0.2, IDLE_AMPS, detector.getIdleBaseline());
+}
+
+void test_idle_baseline_is_capped() {
+    // A wall wart left plugged in, just under what would turn us on.
+    setCurrent(MAX_IDLE_BASELINE + MIN_CURRENT_TO_ACTIVATE - 0.3);
+    TEST_ASSERT_EQUAL_UINT32(NEVER, readFor(10000, true));
+    TEST_ASSERT_FLOAT_WITHIN(0.01, MAX_IDLE_BASELINE, detector.getIdleBaseline());
+}
+
+void test_small_tool_hold_times() {
+    settleIdle();
+    double smallTool = IDLE_AMPS + MIN_CURRENT_TO_ACTIVATE + 0.5;
+
+    // A blip shorter than the on hold is ignored.
+    setCurrent(smallTool);
+    readFor(CURRENT_ON_HOLD_MS / 2, true);
+    TEST_ASSERT_FALSE(detector.isRunning());
+    settleIdle();
+
+    setCurrent(smallTool);
+    unsigned long start = millis();
+    unsigned long on = readFor(1000, true);
+    TEST_ASSERT_NOT_EQUAL(NEVER, on);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(start + CURRENT_ON_HOLD_MS, on);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(start + CURRENT_ON_HOLD_MS + 2 * CURRENT_WINDOW_MS, on);
+    TEST_ASSERT_UINT32_WITHIN(CURRENT_WINDOW_MS, start, detector.getOnsetTime());
+
+    setCurrent(IDLE_AMPS);
+    unsigned long stop = millis();
+    unsigned long off = readFor(2000, false);
+    TEST_ASSERT_NOT_EQUAL(NEVER, off);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(stop + CURRENT_OFF_HOLD_MS, off);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(stop + CURRENT_OFF_HOLD_MS + 2 * CURRENT_WINDOW_MS, off);
+}
+
+void test_small_tool_pause_keeps_running() {
+    settleIdle();
+    setCurrent(IDLE_AMPS + MIN_CURRENT_TO_ACTIVATE + 0.5);
+    TEST_ASSERT_NOT_EQUAL(NEVER, readFor(1000, true));
+    setCurrent(IDLE_AMPS);
+    TEST_ASSERT_EQUAL_UINT32(NEVER, readFor(CURRENT_OFF_HOLD_MS / 2, false));
+    setCurrent(IDLE_AMPS + MIN_CURRENT_TO_ACTIVATE + 0.5);
+    TEST_ASSERT_EQUAL_UINT32(NEVER, readFor(2000, false));
+}
+
+void test_big_tool_inrush() {
+    settleIdle();
+    // A few cycles of inrush, then the running current.
+    setCurrent(40);
+    unsigned long start = millis();
+    unsigned long on = readFor(3 * CURRENT_WINDOW_MS, true);
+    TEST_ASSERT_NOT_EQUAL(NEVER, on);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(start + 2 * CURRENT_WINDOW_MS, on);
+    TEST_ASSERT_UINT32_WITHIN(CURRENT_WINDOW_MS, start, detector.getOnsetTime());
+
+    setCurrent(12);
+    TEST_ASSERT_EQUAL_UINT32(NEVER, readFor(3000, false));
+    TEST_ASSERT_FLOAT_WITHIN(1.0, 12.0, detector.getAmps());
+
+    setCurrent(IDLE_AMPS);
+    unsigned long stop = millis();
+    unsigned long off = readFor(2000, false);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(stop + CURRENT_OFF_HOLD_MS, off);
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(stop + CURRENT_OFF_HOLD_MS + 2 * CURRENT_WINDOW_MS, off);
+}
+
+void setUp() {
+    benchReset();
+    detector = CurrentDetector();
+    detector.setup();
+}
+
+void tearDown() {
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_baseline);
+    RUN_TEST(test_idle_baseline_is_capped);
+    RUN_TEST(test_small_tool_hold_times);
+    RUN_TEST(test_small_tool_pause_keeps_running);
+    RUN_TEST(test_big_tool_inrush);
+    return UNITY_END();
+}
@@ -0,0 +1,135 @@
+#include <Arduino.h>
+#include <NativeBench.h>
+#include <unity.h>
+#include "RadioController.h"
+#include "Faults.h"
+#include "../ScriptedNode.h"
+#include "../CurrentTrace.h"
+
+/**
+ * tools/fault_soak.py, on the host: the firmware for whichever role the
+ * environment picks runs for a while under faults turned on and off through
+ * the console's "fault" command, with another node talking to it and the
+ * radio knocked over now and then.  Then everything is cleared and it
+ * checks what FaultInjector measured.
+ */
+
+void setup();
+void loop();
+void onFaultCommand(uint8_t argc, char **argv);
+extern RadioController radioController;
+
+const unsigned long SOAK_MS = 5UL * 60 * 1000;
+const unsigned long FAULT_INTERVAL_MS = 5000;
+const unsigned long SETTLE_MS = 30000;
+/**
+ * Same as fault_soak.py --recovery.
+ */
+const unsigned long RECOVERY_BUDGET_MS = 2000;
+
+struct FaultLevels {
+    const char *name;
+    uint8_t count;
+    unsigned int levels[4];
+};
+
+/**
+ * Levels to pick from for each fault, as in fault_soak.py.  0 turns it off.
+ */
+const FaultLevels LEVELS[] = {
+    {"droprx", 4, {0, 10, 30, 60}},
+    {"corruptrx", 3, {0, 5, 20}},
+    {"delayrx", 4, {0, 50, 200, 1000}},
+    {"droptx", 4, {0, 10, 30, 60}},
+    {"adcnoise", 4, {0, 2, 8, 30}},
+    {"servostall", 2, {0, 1}},
+};
+
+ScriptedNode peer;
+
+static void fault(const char *first, const char *second = NULL) {
+    char command[] = "fault";
+    char arguments[2][12];
+    char *argv[3] = {command, arguments[0], arguments[1]};
+    strncpy(arguments[0], first, sizeof(arguments[0]));
+    uint8_t argc = 2;
+    if (second != NULL) {
+        strncpy(arguments[1], second, sizeof(arguments[1]));
+        argc = 3;
+    }
+    onFaultCommand(argc, argv);
+}
+
+static void changeFault() {
+    if (random(100) < 20) {
+        fault("radio", random(2) ? "brownout" : "register");
+        return;
+    }
+    const FaultLevels &picked = LEVELS[random(sizeof(LEVELS) / sizeof(LEVELS[0]))];
+    char level[6];
+    snprintf(level, sizeof(level), "%u", picked.levels[random(picked.count)]);
+    fault(picked.name, level);
+}
+
+/**
+ * Runs the firmware for ms, with the peer starting and stopping a machine
+ * and, on a machine, the current to go with it.
+ */
+static void run(unsigned long ms, bool injecting) {
+    unsigned long end = millis() + ms;
+    unsigned long nextFault = millis();
+    unsigned long iteration = 0;
+    while (millis() < end) {
+        if (injecting && millis() >= nextFault) {
+            changeFault();
+            nextFault = millis() + FAULT_INTERVAL_MS;
+        }
+        iteration++;
+        bool machineOn = (millis() / 20000) % 2 == 0;
+        if (iteration % 50 == 0) {
+            Payload payload;
+            payload.command = machineOn ? RUNNING : NO_LONGER_RUNNING;
+            payload.load = LOAD_CUTTING;
+            payload.demand = 40;
+            peer.send(payload);
+        }
+        setCurrent(machineOn ? 10 : 0.3);
+        benchAdvanceMicros(1000);
+        loop();
+        peer.drain();
+        Serial.clearOutput();
+    }
+}
+
+void test_fault_soak() {
+    run(SOAK_MS, true);
+    fault("clear");
+    run(SETTLE_MS, false);
+
+    char line[96];
+    snprintf(line, sizeof(line), "radio recovered %u times, worst %lums; slowest loop %lums, %u over budget",
+        faults->getRecoveries(), faults->getWorstRecoveryMs(), faults->getWorstLoopMs(), faults->getLoopsOverBudget());
+    TEST_MESSAGE(line);
+    TEST_ASSERT_GREATER_THAN(0, faults->getRecoveries());
+    TEST_ASSERT_FALSE_MESSAGE(faults->isRecoveryPending(), "The radio never came back from the last fault");
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(RECOVERY_BUDGET_MS, faults->getWorstRecoveryMs());
+    TEST_ASSERT_EQUAL_UINT32(0, faults->getLoopsOverBudget());
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+int main(int argc, char **argv) {
+    randomSeed(49);
+    setup();
+    peer.address = FIRST_NODE_ADDRESS + 5;
+    peer.id = 0x12345678;
+    peer.begin(radioController.getChannel(), radioController.getDataRate(), false);
+
+    UNITY_BEGIN();
+    RUN_TEST(test_fault_soak);
+    return UNITY_END();
+}
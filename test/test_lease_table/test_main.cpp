@@ -0,0 +1,176 @@
+#include <Arduino.h>
+#include <Air.h>
+#include <NativeBench.h>
+#include <unity.h>
+#include "RadioController.h"
+#include "LeaseTable.h"
+#include "ConfigPush.h"
+#include "../ScriptedNode.h"
+
+/**
+ * Frames on air when the breaker comes back and a full shop of nodes powers
+ * up at once.  Before, every node that heard a HELLO_WORLD broadcast a
+ * WELCOME, so the first second held a frame for every pair of nodes.  Now
+ * only the dust collector (the firmware under test) answers, each node
+ * staggers its first hello, and the WELCOMEs are coalesced and paced by
+ * LeaseTable.
+ */
+
+void setup();
+void loop();
+extern RadioController radioController;
+
+const uint8_t NODES = MAX_NODES;
+const uint32_t FIRST_NODE_ID = 2000;
+const uint8_t OLD_CHANNEL = 10;
+const unsigned long STEP_US = 1000;
+
+/**
+ * A node powering up, scripted to do what the firmware on it does: say
+ * hello until it has a lease, and answer the collector's config round
+ * (which every join starts) with the version it already has.
+ */
+struct PowerUpNode {
+    ScriptedNode node;
+    unsigned long nextHelloTime = VALUE_UNSET;
+    unsigned long replyTime = VALUE_UNSET;
+    uint8_t replyVersion = 0;
+
+    void step() {
+        Payload payload;
+        while (node.receive(payload)) {
+            if (payload.id != DUST_COLLECTOR_ADDRESS) {
+                continue;
+            }
+            if (payload.command == WELCOME && payload.data == node.id) {
+                node.address = payload.toId;
+            } else if (payload.command == CONFIG_CHUNK && ((payload.data >> 16) & 0xFF) == CONFIG_END_OF_ROUND) {
+                replyVersion = payload.data >> 24;
+                replyTime = millis() + random(CONFIG_REPLY_SPREAD_MS);
+            }
+        }
+        if (node.address == ADDRESS_UNSET && nextHelloTime <= millis()) {
+            node.send(HELLO_WORLD, ADDRESS_UNSET, node.id);
+            nextHelloTime = millis() + LEASE_REQUEST_RETRY_MS + random(LEASE_REQUEST_RETRY_MS);
+        }
+        if (replyTime != VALUE_UNSET && replyTime <= millis()) {
+            replyTime = VALUE_UNSET;
+            node.send(CONFIG_STATUS, DUST_COLLECTOR_ADDRESS, ((unsigned long) replyVersion << 16) | CONFIG_ALL_CHUNKS);
+        }
+    }
+};
+
+PowerUpNode nodes[NODES];
+unsigned long hellos = 0;
+unsigned long welcomes = 0;
+
+static void countHandshake(const uint8_t *frame, uint8_t length, uint8_t attempts, bool delivered) {
+    const Payload *payload = (const Payload *) frame;
+    hellos += payload->command == HELLO_WORLD;
+    welcomes += payload->command == WELCOME;
+}
+
+/**
+ * The old way, from the same nodes scripted to do what processCommand used
+ * to, on a channel of their own.  Returns the frames in the first second.
+ */
+static unsigned long runOldHandshake() {
+    for (uint8_t i = 0; i < NODES; i++) {
+        nodes[i].node.moveTo(OLD_CHANNEL);
+    }
+    air.reset();
+    unsigned long end = millis() + 1000;
+    for (uint8_t i = 0; i < NODES; i++) {
+        nodes[i].node.send(HELLO_WORLD, ADDRESS_UNSET, nodes[i].node.id);
+    }
+    while (millis() < end) {
+        benchAdvanceMicros(STEP_US);
+        for (uint8_t i = 0; i < NODES; i++) {
+            Payload payload;
+            while (nodes[i].node.receive(payload)) {
+                if (payload.command == HELLO_WORLD) {
+                    nodes[i].node.send(WELCOME, ADDRESS_UNSET, payload.data);
+                }
+            }
+        }
+    }
+    for (uint8_t i = 0; i < NODES; i++) {
+        nodes[i].node.moveTo(radioController.getChannel());
+        nodes[i].node.drain();
+    }
+    return air.getTransmissions();
+}
+
+void test_frames_on_air_at_power_up() {
+    for (uint8_t i = 0; i < NODES; i++) {
+        nodes[i].node.id = FIRST_NODE_ID + i;
+        nodes[i].node.begin(radioController.getChannel(), radioController.getDataRate(), true);
+    }
+    unsigned long before = runOldHandshake();
+
+    air.reset();
+    air.setObserver(countHandshake);
+    unsigned long start = millis();
+    for (uint8_t i = 0; i < NODES; i++) {
+        nodes[i].nextHelloTime = start + random(HELLO_STAGGER_MS);
+    }
+    // Every second until the last node has its lease.
+    unsigned long busiest = 0;
+    unsigned long secondStart = start;
+    unsigned long framesAtSecondStart = 0;
+    uint8_t leased = 0;
+    unsigned long end = start + HELLO_STAGGER_MS + 4 * LEASE_REQUEST_RETRY_MS;
+    while (leased < NODES && millis() < end) {
+        benchAdvanceMicros(STEP_US);
+        loop();
+        Serial.clearOutput();
+        leased = 0;
+        for (uint8_t i = 0; i < NODES; i++) {
+            nodes[i].step();
+            leased += nodes[i].node.address != ADDRESS_UNSET;
+        }
+        if (millis() - secondStart >= 1000 || leased == NODES) {
+            busiest = max(busiest, air.getTransmissions() - framesAtSecondStart);
+            secondStart = millis();
+            framesAtSecondStart = air.getTransmissions();
+        }
+    }
+    unsigned long after = air.getTransmissions();
+    air.setObserver(NULL);
+
+    char line[96];
+    snprintf(line, sizeof(line), "before: %lu frames in the first second", before);
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line), "after: %lu frames in %lums, at most %lu in a second", after, millis() - start, busiest);
+    TEST_MESSAGE(line);
+    snprintf(line, sizeof(line), "after: %lu HELLO_WORLDs, %lu WELCOMEs", hellos, welcomes);
+    TEST_MESSAGE(line);
+
+    TEST_ASSERT_EQUAL_UINT8(NODES, leased);
+    // Each node has a different address.
+    for (uint8_t i = 0; i < NODES; i++) {
+        for (uint8_t j = i + 1; j < NODES; j++) {
+            TEST_ASSERT_NOT_EQUAL(nodes[i].node.address, nodes[j].node.address);
+        }
+    }
+    // One WELCOME a node.  The rest of the frames are beacons and the
+    // config round each join starts.
+    TEST_ASSERT_EQUAL_UINT32(NODES, welcomes);
+    TEST_ASSERT_TRUE(busiest * 4 < before);
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+int main(int argc, char **argv) {
+    setup();
+
+    UNITY_BEGIN();
+    if (mode == DUST_COLLECTOR) {
+        RUN_TEST(test_frames_on_air_at_power_up);
+    }
+    return UNITY_END();
+}
@@ -0,0 +1,129 @@
+#include <Arduino.h>
+#include <NativeBench.h>
+#include <unity.h>
+#include <limits.h>
+#include "CurrentDetector.h"
+#include "../CurrentTrace.h"
+
+/**
+ * LoadClassifier, through CurrentDetector, against a motor spinning free and
+ * the same motor cutting.  Spinning free the current is small and heavy in
+ * third harmonic, cutting it is bigger and closer to a sine.  Checks the
+ * settle time, both hold times, and that a pause between passes is not
+ * taken for idle.
+ */
+
+const unsigned long NEVER = ULONG_MAX;
+const double SPIN_AMPS = 4;
+const uint8_t SPIN_THIRD_HARMONIC = 40;
+const double CUTTING_AMPS = 9;
+const uint8_t CUTTING_THIRD_HARMONIC = 10;
+
+CurrentDetector detector;
+
+/**
+ * Takes readings for ms, or until the load is state.  Returns when that
+ * happened, or NEVER.
+ */
+static unsigned long readFor(unsigned long ms, LoadState state) {
+    unsigned long end = millis() + ms;
+    while (millis() < end) {
+        detector.onLoop();
+        if (detector.getLoad() == state) {
+            return millis();
+        }
+    }
+    return NEVER;
+}
+
+static void spin() {
+    setCurrent(SPIN_AMPS, SPIN_THIRD_HARMONIC);
+}
+
+static void cut() {
+    setCurrent(CUTTING_AMPS, CUTTING_THIRD_HARMONIC);
+}
+
+/**
+ * Starts the motor and waits for it to learn its spin level.
+ */
+static void startSpinning() {
+    setCurrent(0.3);
+    readFor(1000, LOAD_IDLE);
+    spin();
+    TEST_ASSERT_NOT_EQUAL(NEVER, readFor(LOAD_SETTLE_MS + 500, LOAD_IDLE));
+}
+
+void test_idle_spin_trace() {
+    setCurrent(0.3);
+    readFor(1000, LOAD_IDLE);
+    spin();
+    unsigned long start = millis();
+    unsigned long idle = readFor(LOAD_SETTLE_MS + 500, LOAD_IDLE);
+    TEST_ASSERT_NOT_EQUAL(NEVER, idle);
+    // Nothing is decided during the inrush and spin up.
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(start + LOAD_SETTLE_MS, idle);
+    // Counted from when CurrentDetector believes it is running.
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(start + CURRENT_ON_HOLD_MS + LOAD_SETTLE_MS + 3 * CURRENT_WINDOW_MS, idle);
+    // And it stays there.
+    TEST_ASSERT_EQUAL_UINT32(NEVER, readFor(10000, LOAD_CUTTING));
+    TEST_ASSERT_EQUAL(LOAD_IDLE, detector.getLoad());
+}
+
+void test_cutting_trace() {
+    startSpinning();
+    cut();
+    unsigned long start = millis();
+    unsigned long cutting = readFor(1000, LOAD_CUTTING);
+    TEST_ASSERT_NOT_EQUAL(NEVER, cutting);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(start + LOAD_CUTTING_HOLD_MS, cutting);
+    // A few cycles for the smoothing to get past the threshold, then the hold.
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(start + LOAD_CUTTING_HOLD_MS + 6 * CURRENT_WINDOW_MS, cutting);
+    TEST_ASSERT_EQUAL_UINT32(NEVER, readFor(5000, LOAD_IDLE));
+}
+
+void test_back_to_idle() {
+    startSpinning();
+    cut();
+    TEST_ASSERT_NOT_EQUAL(NEVER, readFor(1000, LOAD_CUTTING));
+    readFor(2000, LOAD_IDLE);
+
+    // Pulling the board back for another pass.
+    spin();
+    TEST_ASSERT_EQUAL_UINT32(NEVER, readFor(LOAD_IDLE_HOLD_MS * 2 / 3, LOAD_IDLE));
+    cut();
+    TEST_ASSERT_EQUAL_UINT32(NEVER, readFor(2000, LOAD_IDLE));
+
+    spin();
+    unsigned long start = millis();
+    unsigned long idle = readFor(LOAD_IDLE_HOLD_MS + 1000, LOAD_IDLE);
+    TEST_ASSERT_NOT_EQUAL(NEVER, idle);
+    TEST_ASSERT_GREATER_OR_EQUAL_UINT32(start + LOAD_IDLE_HOLD_MS, idle);
+    // The smoothing takes longer to come down than to go up.
+    TEST_ASSERT_LESS_OR_EQUAL_UINT32(start + LOAD_IDLE_HOLD_MS + 20 * CURRENT_WINDOW_MS, idle);
+}
+
+void test_stopping_forgets_the_load() {
+    startSpinning();
+    setCurrent(0.3);
+    TEST_ASSERT_NOT_EQUAL(NEVER, readFor(CURRENT_OFF_HOLD_MS + 100, LOAD_UNKNOWN));
+    TEST_ASSERT_FALSE(detector.isRunning());
+}
+
+void setUp() {
+    benchReset();
+    detector = CurrentDetector();
+    detector.setup();
+}
+
+void tearDown() {
+}
+
+int main(int argc, char **argv) {
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_spin_trace);
+    RUN_TEST(test_cutting_trace);
+    RUN_TEST(test_back_to_idle);
+    RUN_TEST(test_stopping_forgets_the_load);
+    return UNITY_END();
+}
@@ -0,0 +1,250 @@
+#include <Arduino.h>
+#include <unity.h>
+#include <stdio.h>
+#include <time.h>
+#include "RadioController.h"
+#include "GateController.h"
+#include "GatePins.h"
+#include "FastPin.h"
+#include "Clock.h"
+#include "Slot.h"
+
+/**
+ * Shop traffic replayed through the real firmware on virtual time, the way
+ * tools/replay_traffic.py does it with a bench board but without one.
+ * Built with TRAFFIC_REPLAY (the native_replay environments), so frames only
+ * come from RadioController::inject and nothing goes on air.
+ *
+ * A capture is what RECORD_TRAFFIC prints: "@<millis> R|T <payload hex>".
+ * Every R frame is fed to getMessage() and processCommand() at its time,
+ * with the clock moved by advanceMillis() in between, and the T frames the
+ * firmware sends have to match the ones in the capture (message ids and
+ * retry counts aside, as in the tool).
+ */
+
+void setup();
+void loop();
+extern RadioController radioController;
+extern bool dustCollectorOn;
+extern Slot<GateController, Role::hasGate> gateControllerSlot;
+
+/**
+ * How far the clock moves each time around loop() between frames.
+ */
+const unsigned long REPLAY_STEP_MS = 10;
+const unsigned long TAIL_MS = 30000;
+const uint8_t MAX_SENT = 64;
+
+/**
+ * The dust collector: a machine gets its lease, cuts for 12s and stops.
+ */
+const char *const COLLECTOR_CAPTURE[] = {
+    "@1500 R 010000000000000004000000007856341200000000",
+    "@1510 T 010000000100000009000000000000FF0000000000",
+    "@1570 T 020000000102000005000000007856341200000000",
+    "@2110 T 030000000100000009000000000000FF0000000000",
+    "@2710 T 040000000100000009000000000000FF0000000000",
+    "@3310 T 050000000100000009000000000000FF0000000000",
+    "@3910 T 060000000100000009000000000000FF0000000000",
+    "@4510 T 070000000100000009000000000000FF0000000000",
+    "@5110 T 080000000100000009000000000000FF0000000000",
+    "@5710 T 090000000100000009000000000000FF0000000000",
+    "@6310 T 0A0000000100000009000000000000FF0000000000",
+    "@6910 T 0B0000000100000009000000000000FF0000000000",
+    "@10000 R 020000000200010001000000000000000000000228",
+    "@10500 T 0C000000010000000C000000000100000000000000",
+    "@11000 R 030000000200010001000000000000000000000228",
+    "@12000 R 040000000200010001000000000000000000000228",
+    "@12510 T 0D000000010000000C000000000100000000000000",
+    "@13000 R 050000000200010001000000000000000000000228",
+    "@14000 R 060000000200010001000000000000000000000228",
+    "@14520 T 0E000000010000000C000000000100000000000000",
+    "@15000 R 070000000200010001000000000000000000000228",
+    "@16000 R 080000000200010001000000000000000000000228",
+    "@16530 T 0F000000010000000C000000000100000000000000",
+    "@17000 R 090000000200010001000000000000000000000228",
+    "@18000 R 0A0000000200010001000000000000000000000228",
+    "@18540 T 10000000010000000C000000000100000000000000",
+    "@19000 R 0B0000000200010001000000000000000000000228",
+    "@20000 R 0C0000000200010001000000000000000000000228",
+    "@20550 T 11000000010000000C000000000100000000000000",
+    "@21000 R 0D0000000200010001000000000000000000000228",
+    "@22000 R 0E0000000200010002000000000000000000000000",
+    "@22560 T 12000000010000000C000000000100000000000000",
+    "@24570 T 13000000010000000C000000000100000000000000",
+    "@26580 T 14000000010000000C000000000100000000000000",
+    "@28590 T 15000000010000000C000000000100000000000000",
+    "@30010 T 160000000100000007000000003A75000000000000",
+    "@30600 T 17000000010000000C000000000100000000000000",
+    "@31010 T 18000000010000000C000000000000000000000000",
+    "@33020 T 19000000010000000C000000000000000000000000",
+    "@35030 T 1A000000010000000C000000000000000000000000",
+    "@37040 T 1B000000010000000C000000000000000000000000",
+};
+
+/**
+ * A branch gate on branch 1: a machine on it runs and stops, then one on
+ * branch 4 starts.
+ */
+const char *const BRANCH_GATE_CAPTURE[] = {
+    "@1263 T 010000000000010004000000002120040000000000",
+    "@1300 R 060000000104000005000000002120040000000000",
+    "@1500 R 070000000100000007000000DC0500000000000000",
+    "@10000 R 010000000200010001000000000000000000000228",
+    "@10977 T 020000000400010006000000002120040000000000",
+    "@11000 R 020000000200010001000000000000000000000228",
+    "@12000 R 030000000200010001000000000000000000000228",
+    "@13000 R 040000000200010001000000000000000000000228",
+    "@14000 R 050000000200010001000000000000000000000228",
+    "@15000 R 060000000200010001000000000000000000000228",
+    "@16000 R 070000000200010001000000000000000000000228",
+    "@17000 R 080000000200010001000000000000000000000228",
+    "@18000 R 090000000200010001000000000000000000000228",
+    "@19000 R 0A0000000200010001000000000000000000000228",
+    "@20000 R 0B0000000200010001000000000000000000000228",
+    "@21000 R 0C0000000200010001000000000000000000000228",
+    "@22000 R 0D0000000200010002000000000000000000000000",
+    "@22500 R 0E0000000300040001000000000000000000000228",
+};
+
+struct Frame {
+    unsigned long ms;
+    char direction;
+    Payload payload;
+};
+
+/**
+ * Reads one capture line.  False for anything else the firmware printed.
+ */
+static bool parseFrame(const char *line, Frame &frame) {
+    char hex[2 * sizeof(Payload) + 1];
+    if (sscanf(line, "@%lu %c %42[0-9A-F]", &frame.ms, &frame.direction, hex) != 3
+            || strlen(hex) != 2 * sizeof(Payload) || (frame.direction != 'R' && frame.direction != 'T')) {
+        return false;
+    }
+    uint8_t *bytes = (uint8_t *) &frame.payload;
+    char digits[3] = {0};
+    for (uint8_t i = 0; i < sizeof(Payload); i++) {
+        digits[0] = hex[2 * i];
+        digits[1] = hex[2 * i + 1];
+        bytes[i] = strtoul(digits, NULL, 16);
+    }
+    return true;
+}
+
+/**
+ * What the firmware sent, and what it decided along the way.
+ */
+Frame sent[MAX_SENT];
+uint8_t sentCount = 0;
+bool collectorWasOn = false;
+bool gateWasOpen = false;
+
+static void runOnce() {
+    loop();
+    for (const char *line = strchr(Serial.output(), '@'); line != NULL; line = strchr(line + 1, '@')) {
+        Frame frame;
+        if (parseFrame(line, frame) && frame.direction == 'T' && sentCount < MAX_SENT) {
+            sent[sentCount++] = frame;
+        }
+    }
+    Serial.clearOutput();
+    collectorWasOn = collectorWasOn || dustCollectorOn;
+    if (Role::hasGate) {
+        gateWasOpen = gateWasOpen || gateControllerSlot.get()->isOpen();
+    }
+}
+
+static void runUntil(unsigned long ms) {
+    while (millis() < ms) {
+        advanceMillis(min(REPLAY_STEP_MS, ms - millis()));
+        runOnce();
+    }
+}
+
+/**
+ * Same frame, apart from what differs every time it is sent.
+ */
+static bool sameFrame(Payload expected, Payload actual) {
+    expected.messageId = actual.messageId = 0;
+    expected.retryCount = actual.retryCount = 0;
+    return memcmp(&expected, &actual, sizeof(Payload)) == 0;
+}
+
+static unsigned long long nowNs() {
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * Replays the capture, then TAIL_MS more for the timers it left running,
+ * and checks the firmware sent what the capture says it did.
+ */
+static void replay(const char *const *capture, uint8_t lines) {
+    Frame expected[MAX_SENT];
+    const char *expectedLines[MAX_SENT];
+    uint8_t expectedCount = 0;
+    unsigned long long start = nowNs();
+    unsigned long firstMs = millis();
+    for (uint8_t i = 0; i < lines; i++) {
+        Frame frame;
+        TEST_ASSERT_TRUE_MESSAGE(parseFrame(capture[i], frame), capture[i]);
+        if (frame.direction == 'T') {
+            expectedLines[expectedCount] = capture[i];
+            expected[expectedCount++] = frame;
+            continue;
+        }
+        runUntil(frame.ms);
+        radioController.inject(frame.payload);
+        runOnce();
+    }
+    runUntil(millis() + TAIL_MS);
+    unsigned long long wallMs = (nowNs() - start) / 1000000;
+
+    char line[96];
+    snprintf(line, sizeof(line), "%lums of traffic replayed in %llums", millis() - firstMs, wallMs);
+    TEST_MESSAGE(line);
+    TEST_ASSERT_TRUE(wallMs * 10 < millis() - firstMs);
+
+    TEST_ASSERT_EQUAL_UINT8(expectedCount, sentCount);
+    for (uint8_t i = 0; i < expectedCount; i++) {
+        TEST_ASSERT_TRUE_MESSAGE(sameFrame(expected[i].payload, sent[i].payload), expectedLines[i]);
+    }
+}
+
+void test_replay_collector_capture() {
+    replay(COLLECTOR_CAPTURE, sizeof(COLLECTOR_CAPTURE) / sizeof(COLLECTOR_CAPTURE[0]));
+    // It came on for the machine, and went off again once it stopped.
+    TEST_ASSERT_TRUE(collectorWasOn);
+    TEST_ASSERT_FALSE(dustCollectorOn);
+}
+
+void test_replay_branch_gate_capture() {
+    replay(BRANCH_GATE_CAPTURE, sizeof(BRANCH_GATE_CAPTURE) / sizeof(BRANCH_GATE_CAPTURE[0]));
+    // Opened for the machine on its branch, and closed after it stopped
+    // even though one on another branch is still running.
+    TEST_ASSERT_TRUE(gateWasOpen);
+    TEST_ASSERT_FALSE(gateControllerSlot.get()->isOpen());
+}
+
+void setUp() {
+}
+
+void tearDown() {
+}
+
+int main(int argc, char **argv) {
+    // Branch switch 1 is on.  The first pin is the high bit.
+    PIND &= ~FastPin<BRANCH_PINS[BRANCH_PINS_LENGTH - 1]>::mask;
+    setup();
+    Serial.clearOutput();
+
+    UNITY_BEGIN();
+    if (mode == DUST_COLLECTOR) {
+        RUN_TEST(test_replay_collector_capture);
+    } else if (mode == BRANCH_GATE) {
+        RUN_TEST(test_replay_branch_gate_capture);
+    }
+    return UNITY_END();
+}
@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""Decodes a telemetry dump from the dust collector.
+
+Either reads a dump saved to a file, or asks the collector for one over
+serial (needs pyserial):
+
+    decode_telemetry.py dump.bin
+    decode_telemetry.py /dev/ttyUSB0 --save dump.bin
+
+Prints the runtime of each machine and the collector's duty cycle.  See
+src/Telemetry.h for the format.
+"""
+
+import argparse
+import os
+import stat
+import struct
+import sys
+
+DUMP_REQUEST = b"\ndump\n"
+MAGIC = b"BGT"
+VERSION = 1
+
+EVENT_COLLECTOR_OFF = 0x80
+EVENT_COLLECTOR_ON = 0x81
+EVENT_TRANSMISSION_FAILURE = 0xC0
+EVENT_BOOT = 0xFF
+EVENT_ADDRESS_MASK = 0x3F
+
+
+def crc8_ccitt(data, crc=0):
+    for byte in data:
+        crc ^= byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+    return crc
+
+
+def read_from_serial(port, baud):
+    import serial
+
+    with serial.Serial(port, baud, timeout=3) as connection:
+        connection.reset_input_buffer()
+        connection.write(DUMP_REQUEST)
+        # Skip any log lines until we see the start of the dump.
+        window = b""
+        while window != MAGIC:
+            byte = connection.read(1)
+            if not byte:
+                sys.exit("Timed out waiting for the telemetry dump")
+            window = (window + byte)[-3:]
+        header = connection.read(11)
+        length = struct.unpack_from("<H", header, 9)[0]
+        return MAGIC + header + connection.read(length + 1)
+
+
+def parse(dump):
+    if dump[:3] != MAGIC or dump[3] != VERSION:
+        sys.exit("Not a version %d telemetry dump" % VERSION)
+    now, base, length = struct.unpack_from("<IIH", dump, 4)
+    events = dump[14:14 + length]
+    if crc8_ccitt(dump[4:14 + length]) != dump[14 + length]:
+        sys.exit("Telemetry dump failed its checksum")
+
+    decoded = []
+    time = base
+    i = 0
+    while i < len(events):
+        delta = 0
+        shift = 0
+        while True:
+            value = events[i]
+            i += 1
+            delta |= (value & 0x7F) << shift
+            shift += 7
+            if not value & 0x80:
+                break
+        event = events[i]
+        i += 1
+        time = delta if event == EVENT_BOOT else time + delta
+        decoded.append((time, event))
+    return now, base, decoded
+
+
+def summarize(now, base, events):
+    runtimes = {}
+    sessions = {}
+    running = {}
+    collector_on_since = None
+    collector_seconds = 0
+    observed_seconds = 0
+    failures = 0
+    boots = 0
+    segment_start = base
+    last_time = base
+
+    def close_segment(end):
+        nonlocal collector_on_since, collector_seconds, observed_seconds
+        for address, since in running.items():
+            runtimes[address] = runtimes.get(address, 0) + end - since
+        running.clear()
+        if collector_on_since is not None:
+            collector_seconds += end - collector_on_since
+            collector_on_since = None
+        observed_seconds += end - segment_start
+
+    for time, event in events:
+        if event == EVENT_BOOT:
+            # We don't know when the power went out, so end everything at the
+            # last thing we heard.
+            close_segment(last_time)
+            boots += 1
+            segment_start = time
+        elif event == EVENT_COLLECTOR_ON:
+            collector_on_since = time
+        elif event == EVENT_COLLECTOR_OFF:
+            if collector_on_since is not None:
+                collector_seconds += time - collector_on_since
+                collector_on_since = None
+        elif event == EVENT_TRANSMISSION_FAILURE:
+            failures += 1
+        elif event & 0xC0 == 0x00:
+            address = event & EVENT_ADDRESS_MASK
+            running.setdefault(address, time)
+            sessions[address] = sessions.get(address, 0) + 1
+        elif event & 0xC0 == 0x40:
+            address = event & EVENT_ADDRESS_MASK
+            if address in running:
+                runtimes[address] = runtimes.get(address, 0) + time - running.pop(address)
+        last_time = time
+    close_segment(now)
+
+    print("%d events over %s (%d reboots, %d failed transmissions)"
+          % (len(events), format_seconds(observed_seconds), boots, failures))
+    print("%-10s %8s %12s" % ("machine", "sessions", "runtime"))
+    for address in sorted(runtimes):
+        print("%-10d %8d %12s" % (address, sessions.get(address, 0), format_seconds(runtimes[address])))
+    duty = 100.0 * collector_seconds / observed_seconds if observed_seconds else 0
+    print("collector on for %s (%.1f%% duty cycle)" % (format_seconds(collector_seconds), duty))
+
+
+def format_seconds(seconds):
+    return "%dh%02dm%02ds" % (seconds // 3600, seconds // 60 % 60, seconds % 60)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("source", help="dump file or serial port of the dust collector")
+    parser.add_argument("--baud", type=int, default=9600)
+    parser.add_argument("--save", help="also write the raw dump to this file")
+    args = parser.parse_args()
+
+    if stat.S_ISCHR(os.stat(args.source).st_mode):
+        dump = read_from_serial(args.source, args.baud)
+    else:
+        with open(args.source, "rb") as f:
+            dump = f.read()
+    if args.save:
+        with open(args.save, "wb") as f:
+            f.write(dump)
+    summarize(*parse(dump))
+
+
+if __name__ == "__main__":
+    main()
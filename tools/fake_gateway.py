@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Pretends to be a gateway node on a pseudo-terminal.
+
+Writes synthetic gateway traffic (see src/Gateway.h) to a new pty, mixed
+with log text and corrupted frames, for trying gateway_daemon.py without a
+shop:
+
+    fake_gateway.py --rate 2000 --loss 0.02 &
+    gateway_daemon.py /dev/pts/N
+
+Prints the pty's path, then runs until killed.  With --count it writes that
+many frames as fast as it can, to a file if one is given, and stops.
+"""
+
+import argparse
+import os
+import random
+import struct
+import sys
+import time
+
+from gateway_daemon import RADIO_FRAME, STATUS, encode_frame
+from replay_traffic import COMMANDS, PAYLOAD_FORMAT
+
+
+class FakeShop:
+    def __init__(self, machines, loss, corrupt, seed):
+        self.random = random.Random(seed)
+        self.machines = machines
+        self.loss = loss
+        self.corrupt = corrupt
+        self.message_ids = {}
+        self.running = set()
+        self.millis = 0
+        self.forwarded = 0
+
+    def payload(self, node_id, command, data=0):
+        message_id = self.message_ids.get(node_id, 0) + 1
+        self.message_ids[node_id] = message_id
+        return struct.pack(PAYLOAD_FORMAT, message_id, node_id, 0, 1 << (node_id % 4),
+                           COMMANDS.index(command), command == "RUNNING", 0, data, 0,
+                           self.random.choice((1, 2)) if command == "RUNNING" else 0,
+                           40 if command == "RUNNING" else 0)
+
+    def next_bytes(self, interval_ms):
+        self.millis += interval_ms
+        node_id = self.random.randint(1, self.machines + 1)
+        if node_id == 1:
+            payload = self.payload(1, "BEACON", self.millis)
+        elif node_id in self.running:
+            if self.random.random() < 0.05:
+                self.running.discard(node_id)
+                payload = self.payload(node_id, "NO_LONGER_RUNNING")
+            else:
+                payload = self.payload(node_id, "RUNNING")
+        elif self.random.random() < 0.05:
+            self.running.add(node_id)
+            payload = self.payload(node_id, "RUNNING")
+        else:
+            payload = self.payload(node_id, "HEARTBEAT", node_id * 1000)
+        if self.random.random() < self.loss:
+            # The gateway never heard it.  Shows up as a message id gap.
+            return b""
+        frame = encode_frame(RADIO_FRAME, struct.pack("<IB", self.millis, 92) + payload)
+        self.forwarded += 1
+        if self.random.random() < self.corrupt:
+            frame = bytearray(frame)
+            frame[self.random.randrange(4, len(frame))] ^= 0xFF
+            frame = bytes(frame)
+        if self.random.random() < 0.01:
+            frame = b"Radio failure detected.\r\n" + frame
+        return frame
+
+    def status(self):
+        return encode_frame(STATUS, struct.pack("<IIIBB", self.millis, self.forwarded, 0, 92, 0))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--rate", type=float, default=200, help="frames per second")
+    parser.add_argument("--machines", type=int, default=20)
+    parser.add_argument("--loss", type=float, default=0.0, help="fraction of frames the gateway misses")
+    parser.add_argument("--corrupt", type=float, default=0.001, help="fraction of frames damaged on the wire")
+    parser.add_argument("--seed", type=int, default=1)
+    parser.add_argument("--count", type=int, help="write this many frames and stop")
+    parser.add_argument("--out", help="with --count, write to this file instead of a pty")
+    args = parser.parse_args()
+
+    shop = FakeShop(args.machines, args.loss, args.corrupt, args.seed)
+    interval_ms = max(1, int(1000 / args.rate))
+    if args.out:
+        with open(args.out, "wb") as out:
+            for i in range(args.count or 10000):
+                out.write(shop.next_bytes(interval_ms))
+                if i % 1000 == 0:
+                    out.write(shop.status())
+        return
+
+    master, slave = os.openpty()
+    print(os.ttyname(slave), flush=True)
+    written = 0
+    next_status = time.time() + 1
+    while args.count is None or written < args.count:
+        # Write in batches so high rates don't need a sleep per frame.
+        batch = b"".join(shop.next_bytes(interval_ms) for _ in range(max(1, int(args.rate / 100))))
+        os.write(master, batch)
+        written += max(1, int(args.rate / 100))
+        if time.time() >= next_status:
+            os.write(master, shop.status())
+            next_status += 1
+        if args.count is None:
+            time.sleep(0.01)
+    time.sleep(1)
+
+
+if __name__ == "__main__":
+    sys.exit(main())
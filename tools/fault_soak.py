@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Soaks a node on the bench under injected faults.
+
+Drives the console "fault" command of a board built with FAULT_INJECTION
+(see src/Faults.h): every few seconds it turns a random fault on or off, and
+now and then knocks the radio over.  At the end it clears everything, lets
+the node settle and checks what the board measured (needs pyserial):
+
+    fault_soak.py /dev/ttyUSB0 --minutes 30 --out soak.log
+
+Fails if the radio took longer than --recovery ms to come back after any
+radio fault, is still down, or any loop took longer than LOOP_BUDGET_MS.
+"""
+
+import argparse
+import random
+import re
+import sys
+import time
+
+# Levels to pick from for each fault.  0 turns it off.
+LEVELS = {
+    "droprx": (0, 10, 30, 60),
+    "corruptrx": (0, 5, 20),
+    "delayrx": (0, 50, 200, 1000),
+    "droptx": (0, 10, 30, 60),
+    "adcnoise": (0, 2, 8, 30),
+    "servostall": (0, 1),
+}
+
+RECOVERIES = re.compile(r"Radio recoveries: (\d+) last: (\d+)ms worst: (\d+)ms pending: (\d)")
+LOOP = re.compile(r"Loop worst: (\d+)ms over budget: (\d+)")
+
+
+def run(connection, args, log):
+    rng = random.Random(args.seed)
+    lines = []
+
+    def send(command):
+        connection.write(command.encode() + b"\n")
+        if log:
+            log.write("> %s\n" % command)
+
+    def drain(seconds):
+        end = time.time() + seconds
+        while time.time() < end:
+            line = connection.readline().decode("ascii", "replace").rstrip()
+            if line:
+                lines.append(line)
+                if log:
+                    log.write(line + "\n")
+
+    connection.reset_input_buffer()
+    send("fault clear")
+    drain(1)
+    if not any(line.startswith("Fault ") for line in lines):
+        sys.exit("No fault report (is the board built with FAULT_INJECTION?)")
+
+    end = time.time() + args.minutes * 60
+    while time.time() < end:
+        if rng.random() < 0.2:
+            send("fault radio %s" % rng.choice(("brownout", "register")))
+        else:
+            fault = rng.choice(sorted(LEVELS))
+            send("fault %s %d" % (fault, rng.choice(LEVELS[fault])))
+        drain(args.interval)
+
+    send("fault clear")
+    drain(args.settle)
+    del lines[:]
+    send("fault")
+    drain(2)
+    return lines
+
+
+def check(lines, recovery_budget_ms):
+    recoveries = loops = None
+    for line in lines:
+        recoveries = RECOVERIES.search(line) or recoveries
+        loops = LOOP.search(line) or loops
+    if not recoveries or not loops:
+        print("no fault report at the end of the soak")
+        return False
+    count, last, worst, pending = (int(value) for value in recoveries.groups())
+    worst_loop, over_budget = (int(value) for value in loops.groups())
+    print("radio recovered %d times, worst %dms" % (count, worst))
+    print("slowest loop %dms, %d over budget" % (worst_loop, over_budget))
+    ok = True
+    if pending:
+        print("FAIL: the radio never came back from the last fault")
+        ok = False
+    if worst > recovery_budget_ms:
+        print("FAIL: radio recovery took longer than %dms" % recovery_budget_ms)
+        ok = False
+    if over_budget:
+        print("FAIL: loops went over budget")
+        ok = False
+    return ok
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", help="serial port of a board built with FAULT_INJECTION")
+    parser.add_argument("--baud", type=int, default=9600)
+    parser.add_argument("--minutes", type=float, default=10)
+    parser.add_argument("--interval", type=float, default=5, help="seconds between fault changes")
+    parser.add_argument("--settle", type=float, default=30, help="seconds to run clean before checking")
+    parser.add_argument("--recovery", type=int, default=2000, help="ms the radio may take to come back")
+    parser.add_argument("--seed", type=int, help="same seed, same faults in the same order")
+    parser.add_argument("--out", help="write everything sent and printed to this file")
+    args = parser.parse_args()
+
+    import serial
+
+    log = open(args.out, "w") if args.out else None
+    with serial.Serial(args.port, args.baud, timeout=0.5) as connection:
+        # Opening the port resets most boards.
+        time.sleep(2)
+        lines = run(connection, args, log)
+    if log:
+        log.close()
+    if not check(lines, args.recovery):
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,305 @@
+#!/usr/bin/env python3
+"""Watches the whole network through a gateway node.
+
+Reads the framed stream from a board built with -DROLE_GATEWAY (see
+src/Gateway.h), keeps the live state of every node and rolling metrics, and
+serves them on a local HTTP port (needs pyserial for a real port):
+
+    gateway_daemon.py /dev/ttyUSB0
+    curl localhost:8088/metrics
+
+The port can also be a pseudo-terminal from fake_gateway.py, or a file with
+a saved stream.
+"""
+
+import argparse
+import json
+import os
+import stat
+import struct
+import sys
+import threading
+import time
+from collections import deque
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+from replay_traffic import COMMANDS, LOADS, PAYLOAD_FORMAT, PAYLOAD_SIZE
+
+SYNC = b"\xA5\x5A"
+RADIO_FRAME = 1
+STATUS = 2
+
+DUST_COLLECTOR_ADDRESS = 1
+# Matches DUST_COLLECTOR_TURN_OFF_DELAY in src/Constants.h.
+COLLECTOR_TURN_OFF_DELAY_MS = 10000
+# Message id gaps bigger than this are a reboot, not loss (as on the boards).
+MAX_MISSED_GAP = 32
+
+
+def make_crc_table():
+    table = []
+    for byte in range(256):
+        crc = byte
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x07) & 0xFF if crc & 0x80 else (crc << 1) & 0xFF
+        table.append(crc)
+    return table
+
+
+CRC_TABLE = make_crc_table()
+
+
+def crc8_ccitt(data):
+    """Same CRC as _crc8_ccitt_update on the boards, a byte at a time from a
+    table so a saturated channel doesn't outrun us."""
+    crc = 0
+    for byte in data:
+        crc = CRC_TABLE[crc ^ byte]
+    return crc
+
+
+def encode_frame(frame_type, body):
+    header = bytes([len(body) + 1, frame_type])
+    return SYNC + header + body + bytes([crc8_ccitt(header + body)])
+
+
+class FrameParser:
+    """Splits the serial stream into frames.  Anything between frames (log
+    text, or a frame with a bad CRC) is skipped and counted."""
+
+    def __init__(self):
+        self.buffer = bytearray()
+        self.skipped_bytes = 0
+        self.bad_frames = 0
+
+    def feed(self, data):
+        self.buffer += data
+        frames = []
+        start = 0
+        buffer = self.buffer
+        while True:
+            sync = buffer.find(SYNC, start)
+            if sync < 0:
+                # Keep a trailing 0xA5 in case the 0x5A is still on its way.
+                keep = len(buffer) - 1 if buffer.endswith(SYNC[:1]) else len(buffer)
+                self.skipped_bytes += keep - start
+                start = keep
+                break
+            self.skipped_bytes += sync - start
+            if sync + 3 > len(buffer):
+                start = sync
+                break
+            length = buffer[sync + 2]
+            end = sync + 3 + length + 1
+            if end > len(buffer):
+                start = sync
+                break
+            if length == 0 or crc8_ccitt(buffer[sync + 2:end - 1]) != buffer[end - 1]:
+                # Not really a frame.  Look for the next sync after this one.
+                self.bad_frames += 1
+                self.skipped_bytes += 1
+                start = sync + 1
+                continue
+            frames.append((buffer[sync + 3], bytes(buffer[sync + 4:end - 1])))
+            start = end
+        del self.buffer[:start]
+        return frames
+
+
+class Network:
+    """Live state of every node, and rolling metrics over the last window,
+    all on the gateway's clock."""
+
+    def __init__(self, window_ms):
+        self.window_ms = window_ms
+        self.lock = threading.Lock()
+        self.nodes = {}
+        self.frame_times = deque()
+        self.collector_on_since = None
+        self.collector_spans = deque()
+        self.last_running_time = None
+        self.gateway = {}
+        self.collectors_running = []
+        self.now = 0
+
+    def on_frame(self, frame_type, body):
+        with self.lock:
+            if frame_type == RADIO_FRAME and len(body) == 5 + PAYLOAD_SIZE:
+                now, channel = struct.unpack_from("<IB", body)
+                self.on_radio_frame(now, struct.unpack_from(PAYLOAD_FORMAT, body, 5))
+            elif frame_type == STATUS and len(body) == 14:
+                now, forwarded, overflows, channel, rate = struct.unpack("<IIIBB", body)
+                self.gateway = {"forwarded": forwarded, "rx_fifo_full": overflows,
+                                "channel": channel, "data_rate": rate}
+                self.advance(now)
+
+    def on_radio_frame(self, now, payload):
+        message_id, node_id, to_id, gate_code, command, ack, retries, data, origin_age, load, demand = payload
+        self.advance(now)
+        self.frame_times.append(now)
+        node = self.nodes.setdefault(node_id, {
+            "frames": 0, "missed": 0, "running": False, "load": None, "demand_cfm": None,
+            "last_message_id": None})
+        if node["last_message_id"] is not None:
+            gap = (message_id - node["last_message_id"] - 1) & 0xFFFFFFFF
+            if gap <= MAX_MISSED_GAP:
+                node["missed"] += gap
+        node["last_message_id"] = message_id
+        node["frames"] += 1
+        node["last_seen_ms"] = now
+        node["gate_code"] = gate_code
+        name = COMMANDS[command] if 0 <= command < len(COMMANDS) else str(command)
+        node["last_command"] = name
+        if name == "RUNNING":
+            node["running"] = True
+            node["load"] = LOADS[load] if load < len(LOADS) else load
+            self.last_running_time = now
+            if self.collector_on_since is None:
+                self.collector_on_since = now
+            node["demand_cfm"] = demand * 10
+        elif name == "NO_LONGER_RUNNING":
+            node["running"] = False
+        elif name == "COLLECTOR_ASSIGN" and node_id == DUST_COLLECTOR_ADDRESS:
+            self.collectors_running = [(data >> shift) & 0xFF for shift in (0, 8, 16, 24) if (data >> shift) & 0xFF]
+
+    def advance(self, now):
+        # The gateway's millis() starts over when it reboots.
+        if now < self.now:
+            self.frame_times.clear()
+            self.collector_spans.clear()
+            self.collector_on_since = None
+            self.last_running_time = None
+        self.now = now
+        if self.collector_on_since is not None and now - self.last_running_time > COLLECTOR_TURN_OFF_DELAY_MS:
+            # Nobody has said RUNNING for long enough that it turned off.
+            off = self.last_running_time + COLLECTOR_TURN_OFF_DELAY_MS
+            self.collector_spans.append((self.collector_on_since, off))
+            self.collector_on_since = None
+        start = now - self.window_ms
+        while self.frame_times and self.frame_times[0] < start:
+            self.frame_times.popleft()
+        while self.collector_spans and self.collector_spans[0][1] < start:
+            self.collector_spans.popleft()
+
+    def metrics(self):
+        with self.lock:
+            window_start = max(0, self.now - self.window_ms)
+            spans = list(self.collector_spans)
+            if self.collector_on_since is not None:
+                spans.append((self.collector_on_since, self.now))
+            on_ms = sum(max(0, end - max(start, window_start)) for start, end in spans)
+            elapsed = max(1, self.now - window_start)
+            nodes = {}
+            for node_id, node in sorted(self.nodes.items()):
+                heard = node["frames"] + node["missed"]
+                nodes[str(node_id)] = {
+                    "frames": node["frames"],
+                    "missed": node["missed"],
+                    "loss_percent": round(100.0 * node["missed"] / heard, 1) if heard else 0,
+                    "running": node["running"],
+                    "load": node["load"] if node["running"] else None,
+                    "demand_cfm": node["demand_cfm"] if node["running"] else None,
+                    "last_command": node["last_command"],
+                    "gate_code": node["gate_code"],
+                    "seconds_since_seen": round((self.now - node["last_seen_ms"]) / 1000.0, 1),
+                }
+            return {
+                "gateway_ms": self.now,
+                "window_seconds": self.window_ms / 1000.0,
+                "frames_per_second": round(len(self.frame_times) * 1000.0 / elapsed, 2),
+                "collector_on": self.collector_on_since is not None,
+                "collector_duty_percent": round(100.0 * on_ms / elapsed, 1),
+                "collectors_running": self.collectors_running,
+                "gateway": self.gateway,
+                "nodes": nodes,
+            }
+
+
+def open_stream(path, baud):
+    if not stat.S_ISCHR(os.stat(path).st_mode):
+        return open(path, "rb")
+    try:
+        import serial
+    except ImportError:
+        # Good enough for a pty, where the baud rate means nothing.
+        import tty
+
+        stream = open(path, "rb", buffering=0)
+        tty.setraw(stream.fileno())
+        return stream
+    return serial.Serial(path, baud, timeout=0.2)
+
+
+def read_forever(stream, parser, network, stats):
+    while True:
+        # Big reads, so we keep up with a saturated channel.
+        try:
+            data = stream.read(4096)
+        except OSError:
+            # The other end of a pty went away.
+            return
+        if not data:
+            if not hasattr(stream, "in_waiting"):
+                return
+            continue
+        stats["bytes"] += len(data)
+        for frame_type, body in parser.feed(data):
+            stats["frames"] += 1
+            network.on_frame(frame_type, body)
+
+
+def serve(address, network, parser, stats):
+    class Handler(BaseHTTPRequestHandler):
+        def do_GET(self):
+            if self.path not in ("/", "/metrics"):
+                self.send_error(404)
+                return
+            metrics = network.metrics()
+            metrics["host"] = dict(stats, skipped_bytes=parser.skipped_bytes, bad_frames=parser.bad_frames)
+            body = json.dumps(metrics, indent=2).encode()
+            self.send_response(200)
+            self.send_header("Content-Type", "application/json")
+            self.send_header("Content-Length", str(len(body)))
+            self.end_headers()
+            self.wfile.write(body)
+
+        def log_message(self, *args):
+            pass
+
+    host, port = address.rsplit(":", 1)
+    server = ThreadingHTTPServer((host, int(port)), Handler)
+    thread = threading.Thread(target=server.serve_forever, daemon=True)
+    thread.start()
+    return server
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("port", help="serial port of the gateway, a pty, or a saved stream")
+    parser.add_argument("--baud", type=int, default=500000)
+    parser.add_argument("--listen", default="127.0.0.1:8088", help="host:port to serve metrics on")
+    parser.add_argument("--window", type=int, default=60, help="seconds of history for the rolling metrics")
+    parser.add_argument("--once", action="store_true", help="read the stream to the end and print the metrics")
+    args = parser.parse_args()
+
+    frames = FrameParser()
+    network = Network(args.window * 1000)
+    stats = {"bytes": 0, "frames": 0, "started": time.time()}
+    stream = open_stream(args.port, args.baud)
+    if args.once:
+        read_forever(stream, frames, network, stats)
+        metrics = network.metrics()
+        metrics["host"] = dict(stats, skipped_bytes=frames.skipped_bytes, bad_frames=frames.bad_frames)
+        json.dump(metrics, sys.stdout, indent=2)
+        print()
+        return
+    serve(args.listen, network, frames, stats)
+    print("serving metrics on http://%s/metrics" % args.listen, file=sys.stderr)
+    try:
+        read_forever(stream, frames, network, stats)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
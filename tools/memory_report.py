@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""Prints where each role's SRAM goes and checks it against the margins.
+
+Reads the firmware ELF of each PlatformIO environment, after a build:
+
+    pio run
+    memory_report.py
+    memory_report.py .pio/build/machine/firmware.elf --top 30
+
+Everything is allocated statically (see src/Capacity.h), so the static data
+is the whole memory map: what's left is all the stack has.  Fails if any
+build leaves less than STACK_RESERVE + MIN_FREE_SRAM from src/Capacity.h.
+"""
+
+import argparse
+import glob
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+SRAM_SIZE = 2048
+SRAM_SECTIONS = (".data", ".bss", ".noinit")
+# nm types for symbols in SRAM: initialized and zeroed data.
+SRAM_TYPES = "dDbBvV"
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+CAPACITY_HEADER = os.path.join(HERE, "..", "src", "Capacity.h")
+PLATFORMIO_TOOLCHAIN = os.path.expanduser("~/.platformio/packages/toolchain-atmelavr/bin")
+
+
+def capacity(name):
+    with open(CAPACITY_HEADER) as f:
+        match = re.search(r"\b%s\s*=\s*(\d+)" % name, f.read())
+    if not match:
+        sys.exit("%s not found in %s" % (name, CAPACITY_HEADER))
+    return int(match.group(1))
+
+
+def tool(name):
+    path = shutil.which(name) or os.path.join(PLATFORMIO_TOOLCHAIN, name)
+    if not os.path.exists(path):
+        sys.exit("can't find %s (install the PlatformIO atmelavr platform)" % name)
+    return path
+
+
+def sections(elf):
+    output = subprocess.check_output([tool("avr-size"), "-A", elf], text=True)
+    sizes = {}
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) >= 2 and fields[0] in SRAM_SECTIONS:
+            sizes[fields[0]] = int(fields[1])
+    return sizes
+
+
+def symbols(elf):
+    output = subprocess.check_output([tool("avr-nm"), "-S", "-C", "--size-sort", "-r", elf], text=True)
+    found = []
+    for line in output.splitlines():
+        match = re.match(r"[0-9a-f]+ ([0-9a-f]+) (\w) (.+)", line)
+        if match and match.group(2) in SRAM_TYPES:
+            found.append((int(match.group(1), 16), match.group(3)))
+    return found
+
+
+def report(elf, top, needed):
+    env = os.path.basename(os.path.dirname(elf))
+    sizes = sections(elf)
+    used = sum(sizes.values())
+    left = SRAM_SIZE - used
+    print("%s: %d bytes static (%s), %d left for the stack" % (
+        env, used, " ".join("%s %d" % (name, sizes.get(name, 0)) for name in SRAM_SECTIONS), left))
+    for size, name in symbols(elf)[:top]:
+        print("  %5d  %s" % (size, name))
+    if left < needed:
+        print("  FAIL: needs %d for the stack and margin" % needed)
+        return False
+    return True
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("elf", nargs="*", help="firmware ELFs (default: every .pio/build/*/firmware.elf)")
+    parser.add_argument("--top", type=int, default=15, help="biggest symbols to list per build")
+    args = parser.parse_args()
+
+    elves = args.elf or sorted(glob.glob(os.path.join(HERE, "..", ".pio", "build", "*", "firmware.elf")))
+    if not elves:
+        sys.exit("no builds found; run pio run first")
+    needed = capacity("STACK_RESERVE") + capacity("MIN_FREE_SRAM")
+    ok = True
+    for elf in elves:
+        ok = report(elf, args.top, needed) and ok
+    if not ok:
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()
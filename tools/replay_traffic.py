@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""Replays captured radio traffic into a node on the bench.
+
+Takes a serial log from the shop, either RECORD_TRAFFIC lines
+("@<millis> R|T <hex>") or the normal "Received:"/"Broadcasting:" lines,
+and feeds every frame the node heard back into a board built with
+TRAFFIC_REPLAY and the same role (needs pyserial):
+
+    replay_traffic.py shop.log --list
+    replay_traffic.py shop.log /dev/ttyUSB0 --out replay.log
+
+The board's clock is moved forward between frames with "tick", so hours of
+traffic replay in minutes.  The frames are the same bytes that went through
+getMessage() and processCommand() in the shop.  Whatever the board sends
+back is compared with what it sent in the capture, ignoring message ids.
+test/test_replay does the same on the host, no board needed
+(pio test -e native_replay).
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+# Payload as laid out by avr-gcc.  See src/RadioController.h.
+PAYLOAD_FORMAT = "<IBBHhBHIHBB"
+PAYLOAD_SIZE = struct.calcsize(PAYLOAD_FORMAT)
+LOADS = ["unknown", "idle", "cutting"]
+COMMANDS = ["UNKNOWN", "RUNNING", "NO_LONGER_RUNNING", "ACK", "HELLO_WORLD",
+            "WELCOME", "HEARTBEAT", "BEACON", "CHANNEL_CHANGE", "CONFIG_CHUNK",
+            "CONFIG_STATUS", "COLLECTOR_INFO", "COLLECTOR_ASSIGN"]
+
+RECORD_LINE = re.compile(r"@(\d+) ([RT]) ([0-9A-Fa-f]+)\s*$")
+LOG_LINE = re.compile(r"([\d.]+) (Received|Broadcasting): Payload \{(.*)\}")
+FIELD = re.compile(r"(\w+)=(\S+)")
+
+
+def parse_capture(lines):
+    """Returns (ms, direction, payload bytes) for every frame in the log."""
+    frames = []
+    for line in lines:
+        match = RECORD_LINE.search(line)
+        if match:
+            payload = bytes.fromhex(match.group(3))
+            if len(payload) == PAYLOAD_SIZE:
+                frames.append((int(match.group(1)), match.group(2), payload))
+            continue
+        match = LOG_LINE.search(line)
+        if match:
+            fields = dict(FIELD.findall(match.group(3)))
+            direction = "R" if match.group(2) == "Received" else "T"
+            frames.append((int(float(match.group(1)) * 1000), direction, encode(fields)))
+    return frames
+
+
+def encode(fields):
+    def address(value):
+        return 0 if value == "UNSET" else int(value)
+
+    command = fields.get("command", "UNKNOWN")
+    return struct.pack(PAYLOAD_FORMAT,
+                       int(fields.get("messageId", 0)),
+                       address(fields.get("id", "UNSET")),
+                       address(fields.get("toId", "UNSET")),
+                       int(fields.get("gateCode", 0)),
+                       COMMANDS.index(command) if command in COMMANDS else 0,
+                       int(fields.get("requestACK", 0)),
+                       int(fields.get("retryCount", 0)),
+                       int(fields.get("data", 0)),
+                       int(fields.get("originAge", 0)),
+                       int(fields.get("load", 0)),
+                       int(fields.get("demand", 0)))
+
+
+def describe(payload):
+    message_id, from_id, to_id, gate_code, command, ack, retries, data, origin_age, load, demand = struct.unpack(PAYLOAD_FORMAT, payload)
+    name = COMMANDS[command] if 0 <= command < len(COMMANDS) else str(command)
+    if name == "RUNNING":
+        name += " (%s, %d CFM)" % (LOADS[load] if load < len(LOADS) else load, demand * 10)
+    return "%s id=%d toId=%d gateCode=%d data=%d" % (name, from_id, to_id, gate_code, data)
+
+
+def replay(frames, port, baud, out, tail_ms):
+    import serial
+
+    log = open(out, "w") if out else None
+    sent = []
+
+    def read_until(prefix, pattern):
+        while True:
+            line = connection.readline().decode("ascii", "replace").rstrip()
+            if not line:
+                sys.exit("Timed out waiting for the board (is it built with TRAFFIC_REPLAY?)")
+            if log:
+                log.write(line + "\n")
+            match = RECORD_LINE.search(line)
+            if match and match.group(2) == "T":
+                sent.append(bytes.fromhex(match.group(3)))
+            if line.startswith(prefix) and pattern in line:
+                return
+
+    with serial.Serial(port, baud, timeout=10) as connection:
+        connection.reset_input_buffer()
+        last_time = None
+        heard = [(time, payload) for time, direction, payload in frames if direction == "R"]
+        for time, payload in heard:
+            if last_time is not None and time > last_time:
+                connection.write(b"tick %d\n" % (time - last_time))
+                read_until("@", " tick")
+            last_time = time
+            connection.write(b"rx " + payload.hex().upper().encode() + b"\n")
+            read_until("@", " R ")
+        if tail_ms:
+            # Let the last timers (gate closing, collector turning off) run.
+            connection.write(b"tick %d\n" % tail_ms)
+            read_until("@", " tick")
+            connection.write(b"stats\n")
+            read_until("Address", "")
+    if log:
+        log.close()
+    return len(heard), sent
+
+
+def compare(expected, actual):
+    # describe() leaves out message ids and retries, which will differ.
+    expected = [describe(payload) for payload in expected]
+    actual = [describe(payload) for payload in actual]
+    matched = sum(1 for e, a in zip(expected, actual) if e == a)
+    print("%d of %d frames sent in the capture were sent again in the replay" % (matched, len(expected)))
+    for i, (e, a) in enumerate(zip(expected, actual)):
+        if e != a:
+            print("first difference at frame %d:\n  capture: %s\n  replay:  %s" % (i, e, a))
+            break
+    if len(expected) != len(actual):
+        print("capture sent %d frames, replay sent %d" % (len(expected), len(actual)))
+    return matched == len(expected) == len(actual)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("capture", help="serial log from the shop")
+    parser.add_argument("port", nargs="?", help="serial port of a board built with TRAFFIC_REPLAY")
+    parser.add_argument("--baud", type=int, default=9600)
+    parser.add_argument("--out", help="write everything the board prints to this file")
+    parser.add_argument("--tail", type=int, default=60000, help="ms to run on after the last frame")
+    parser.add_argument("--list", action="store_true", help="just print the frames in the capture")
+    args = parser.parse_args()
+
+    with open(args.capture, errors="replace") as f:
+        frames = parse_capture(f)
+    if args.list or not args.port:
+        for time, direction, payload in frames:
+            print("%10d %s %s" % (time, direction, describe(payload)))
+        return
+
+    count, sent = replay(frames, args.port, args.baud, args.out, args.tail)
+    print("replayed %d frames" % count)
+    expected = [payload for time, direction, payload in frames if direction == "T"]
+    if expected and not compare(expected, sent):
+        sys.exit(1)
+
+
+if __name__ == "__main__":
+    main()